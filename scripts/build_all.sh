@@ -13,6 +13,10 @@ BUILD_GET_RAW_FRAME=1
 BUILD_GET_RGB_DEMO=1
 BUILD_PYTHON_DEMOS=1
 BUILD_LIBPIXYUSB2=1
+BUILD_LIBLINEENGINE=1
+BUILD_LINE_REPLAY=1
+BUILD_LIBJPEGENC=1
+BUILD_JPEG_BENCH=1
 
 ##############################################################################################
 # SCRIPT START                                                                               #
@@ -113,6 +117,38 @@ if [ $BUILD_PAN_TILT_CPP_DEMO == 1 ]; then
   ./build_pan_tilt_demo.sh
 fi
 
+##############################################################################################
+# LIBLINEENGINE                                                                              #
+##############################################################################################
+
+if [ $BUILD_LIBLINEENGINE == 1 ]; then
+  ./build_liblineengine.sh
+fi
+
+##############################################################################################
+# LINE REPLAY                                                                                #
+##############################################################################################
+
+if [ $BUILD_LINE_REPLAY == 1 ]; then
+  ./build_line_replay.sh
+fi
+
+##############################################################################################
+# LIBJPEGENC                                                                                 #
+##############################################################################################
+
+if [ $BUILD_LIBJPEGENC == 1 ]; then
+  ./build_libjpegenc.sh
+fi
+
+##############################################################################################
+# JPEG BENCH                                                                                 #
+##############################################################################################
+
+if [ $BUILD_JPEG_BENCH == 1 ]; then
+  ./build_jpeg_bench.sh
+fi
+
 ##############################################################################################
 # BUILD RESULTS                                                                              #
 ##############################################################################################
@@ -242,6 +278,58 @@ if [ $BUILD_PYTHON_DEMOS == 1 ]; then
   echo ""
 fi
 
+if [ $BUILD_LIBLINEENGINE == 1 ]; then
+  WHITE_TEXT
+  printf "# liblineengine ................................................... "
+  if [ -f ../build/liblineengine/liblineengine.a ]; then
+    GREEN_TEXT
+    printf "SUCCESS "
+  else
+    RED_TEXT
+    printf "FAILURE "
+  fi
+  echo ""
+fi
+
+if [ $BUILD_LINE_REPLAY == 1 ]; then
+  WHITE_TEXT
+  printf "# line_replay ..................................................... "
+  if [ -f ../build/line_replay/line_replay ]; then
+    GREEN_TEXT
+    printf "SUCCESS "
+  else
+    RED_TEXT
+    printf "FAILURE "
+  fi
+  echo ""
+fi
+
+if [ $BUILD_LIBJPEGENC == 1 ]; then
+  WHITE_TEXT
+  printf "# libjpegenc ...................................................... "
+  if [ -f ../build/libjpegenc/libjpegenc.a ]; then
+    GREEN_TEXT
+    printf "SUCCESS "
+  else
+    RED_TEXT
+    printf "FAILURE "
+  fi
+  echo ""
+fi
+
+if [ $BUILD_JPEG_BENCH == 1 ]; then
+  WHITE_TEXT
+  printf "# jpeg_bench ...................................................... "
+  if [ -f ../build/jpeg_bench/jpeg_bench ]; then
+    GREEN_TEXT
+    printf "SUCCESS "
+  else
+    RED_TEXT
+    printf "FAILURE "
+  fi
+  echo ""
+fi
+
 WHITE_TEXT
 echo "########################################################################################"
 NORMAL_TEXT
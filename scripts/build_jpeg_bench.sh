@@ -0,0 +1,41 @@
+#!/bin/bash
+
+function WHITE_TEXT {
+  printf "\033[1;37m"
+}
+function NORMAL_TEXT {
+  printf "\033[0m"
+}
+function GREEN_TEXT {
+  printf "\033[1;32m"
+}
+function RED_TEXT {
+  printf "\033[1;31m"
+}
+
+WHITE_TEXT
+echo "########################################################################################"
+echo "# Building JPEG Bench...                                                               #"
+echo "########################################################################################"
+NORMAL_TEXT
+
+uname -a
+
+TARGET_BUILD_FOLDER=../build
+
+mkdir $TARGET_BUILD_FOLDER
+mkdir $TARGET_BUILD_FOLDER/jpeg_bench
+
+rm $TARGET_BUILD_FOLDER/jpeg_bench/jpeg_bench
+cd ../src/host/jpeg_bench
+make
+mv ./jpeg_bench ../../../build/jpeg_bench
+
+if [ -f ../../../build/jpeg_bench/jpeg_bench ]; then
+  GREEN_TEXT
+  printf "SUCCESS "
+else
+  RED_TEXT
+  printf "FAILURE "
+fi
+echo ""
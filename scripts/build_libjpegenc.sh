@@ -0,0 +1,43 @@
+#!/bin/bash
+
+function WHITE_TEXT {
+  printf "\033[1;37m"
+}
+function NORMAL_TEXT {
+  printf "\033[0m"
+}
+function GREEN_TEXT {
+  printf "\033[1;32m"
+}
+function RED_TEXT {
+  printf "\033[1;31m"
+}
+
+WHITE_TEXT
+echo "########################################################################################"
+echo "# Building libjpegenc...                                                               #"
+echo "########################################################################################"
+NORMAL_TEXT
+
+uname -a
+
+TARGET_BUILD_FOLDER=../build
+
+mkdir $TARGET_BUILD_FOLDER
+mkdir $TARGET_BUILD_FOLDER/libjpegenc
+
+echo "Starting build..."
+rm $TARGET_BUILD_FOLDER/libjpegenc/libjpegenc.a
+cd ../src/host/libjpegenc/src
+make
+mv ./lib/libjpegenc.a ../../../../build/libjpegenc
+
+if [ -f ../../../../build/libjpegenc/libjpegenc.a ]; then
+  GREEN_TEXT
+  printf "SUCCESS "
+else
+  RED_TEXT
+  printf "FAILURE "
+fi
+NORMAL_TEXT
+echo ""
@@ -0,0 +1,43 @@
+#!/bin/bash
+
+function WHITE_TEXT {
+  printf "\033[1;37m"
+}
+function NORMAL_TEXT {
+  printf "\033[0m"
+}
+function GREEN_TEXT {
+  printf "\033[1;32m"
+}
+function RED_TEXT {
+  printf "\033[1;31m"
+}
+
+WHITE_TEXT
+echo "########################################################################################"
+echo "# Building liblineengine...                                                            #"
+echo "########################################################################################"
+NORMAL_TEXT
+
+uname -a
+
+TARGET_BUILD_FOLDER=../build
+
+mkdir $TARGET_BUILD_FOLDER
+mkdir $TARGET_BUILD_FOLDER/liblineengine
+
+echo "Starting build..."
+rm $TARGET_BUILD_FOLDER/liblineengine/liblineengine.a
+cd ../src/host/liblineengine/src
+make
+mv ./lib/liblineengine.a ../../../../build/liblineengine
+
+if [ -f ../../../../build/liblineengine/liblineengine.a ]; then
+  GREEN_TEXT
+  printf "SUCCESS "
+else
+  RED_TEXT
+  printf "FAILURE "
+fi
+NORMAL_TEXT
+echo ""
@@ -57,7 +57,10 @@
 //#include <memory.h>
 #include <math.h>
 
-//#define INCLUDE_STATS
+#define INCLUDE_STATS
+
+// Fractional bits of the fixed-point centroid returned by SMoments::GetStatsFixed
+#define MOMENT_CENTROID_SHIFT  3
 
 // Uncomment this for verbose output for testing
 //#include <iostream.h>
@@ -75,6 +78,17 @@ struct SMomentStats {
     float minorDiameter;
 };
 
+// Integer version of SMomentStats, no floating point required
+struct SMomentStatsFixed {
+    int   area;
+    // centroid in units of 1/(1<<MOMENT_CENTROID_SHIFT) pixels
+    int   centroidX, centroidY;
+    // principal axis angle in degrees, -90 to 90.
+    // 0 points to the right (positive X), 90 points downward (positive Y)
+    // Only valid if SMoments::computeAxes is true, otherwise 0.
+    int   angle;
+};
+
 // Image size is 352x278
 // Full-screen blob area is 97856
 // Full-screen centroid is 176,139
@@ -112,6 +126,9 @@ struct SMoments {
     }
 #ifdef INCLUDE_STATS
     void GetStats(SMomentStats &stats) const;
+    // Same as GetStats, but in fixed point.  X coordinates are scaled by
+    // 1<<xShift first, for images whose columns are subsampled.
+    void GetStatsFixed(SMomentStatsFixed &stats, int xShift=0) const;
     bool operator==(const SMoments &rhs) const {
         if (area != rhs.area) return 0;
         if (sumX != rhs.sumX) return 0;
@@ -46,6 +46,9 @@ struct BlobA
     BlobA()
     {
         m_model = m_left = m_right = m_top = m_bottom = 0;
+		m_cx = m_cy = 0;
+		m_orientation = 0;
+		m_area = 0;
 		m_tracker = NULL;
     }
 
@@ -56,6 +59,11 @@ struct BlobA
         m_right = right;
         m_top = top;
         m_bottom = bottom;
+		// no moments, so use the center of the bounding box
+		m_cx = (left+right)<<(MOMENT_CENTROID_SHIFT-1);
+		m_cy = (top+bottom)<<(MOMENT_CENTROID_SHIFT-1);
+		m_orientation = 0;
+		m_area = 0;
 		m_tracker = NULL;
     }
 
@@ -65,6 +73,11 @@ struct BlobA
     uint16_t m_top;
     uint16_t m_bottom;
 	int16_t m_angle;
+	// area-weighted centroid in 1/(1<<MOMENT_CENTROID_SHIFT) pixels
+	uint16_t m_cx;
+	uint16_t m_cy;
+	int16_t m_orientation; // principal axis, degrees
+	uint32_t m_area; // pixel count
 	Tracker<BlobA> *m_tracker;
 };
 
@@ -87,7 +100,7 @@ public:
 	void sendDetectedPixels(bool send);
     uint16_t getBlock(uint8_t *buf, uint32_t buflen);
     BlobA *getMaxBlob(uint16_t signature=0, uint16_t *numBlobs=NULL);
-	int getBlobs(uint8_t sigmap, uint8_t n, uint8_t *buf, uint16_t len);
+	int getBlobs(uint8_t sigmap, uint8_t n, uint8_t *buf, uint16_t len, bool moments=false);
 	SimpleList<Tracker<BlobA> > *getBlobs();
     int runlengthAnalysis();
 	
@@ -103,6 +116,7 @@ public:
     Qqueue *m_qq;
 
 	static void convertBlob(BlobC *blobc, const BlobA &bloba);
+	static void convertBlob(BlobD *blobd, const BlobA &bloba);
 
 private:
     int handleSegment(uint8_t signature, uint16_t row, uint16_t startCol, uint16_t length);
@@ -111,6 +125,7 @@ private:
 	void endFrame();
     uint16_t combine(BlobA *blobs, uint16_t numBlobs);
     uint16_t combine2(BlobA *blobs, uint16_t numBlobs);
+	void mergeMoments(BlobA *blob0, const BlobA &blob1);
     uint16_t compress(BlobA *blobs, uint16_t numBlobs);
 	void shift();
 
@@ -153,6 +168,7 @@ private:
 
     uint32_t m_numQvals;
     uint32_t *m_qvals;
+    uint16_t m_decimation; // line decimation of the current frame, 1 is none
 
 	bool m_sendDetectedPixels;
 	
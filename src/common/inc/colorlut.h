@@ -32,6 +32,8 @@
 #define CL_DEFAULT_TOL                  0.80f
 #define CL_DEFAULT_CCGAIN               1.5f
 #define CL_MODEL_TYPE_COLORCODE         1
+#define CL_HIST_SHIFT                   7 // u/v histogram bin width is 1<<CL_HIST_SHIFT
+#define CL_HIST_SIZE                    (1<<(CL_LUT_ENTRY_SCALE+1-CL_HIST_SHIFT))
 
 
 struct RuntimeSignature
@@ -98,6 +100,7 @@ private:
 
     void calcRatios(IterPixel *ip, ColorSignature *sig, float ratios[]);
     void iterate(IterPixel *ip, ColorSignature *sig);
+    void search(IterPixel *ip, ColorSignature *sig);
     void getMean(const RectA &region ,const Frame8 &frame, UVPixel *mean);
 
     uint8_t *m_lut;
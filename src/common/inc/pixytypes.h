@@ -252,6 +252,19 @@ struct BlobC
 	uint8_t m_age;
 };
 
+// BlobC with the area-weighted centroid and principal axis angle computed from the blob's moments
+struct BlobD : public BlobC
+{
+    BlobD()
+    {
+        m_cx = m_cy = m_orientation = 0;
+    }
+
+    uint16_t m_cx; // centroid x, 1/8 pixel units
+    uint16_t m_cy; // centroid y, 1/8 pixel units
+    int16_t m_orientation; // principal axis angle, degrees (-90 to 90), same sense as m_angle
+};
+
 
 struct HuePixel
 {
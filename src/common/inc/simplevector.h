@@ -17,42 +17,63 @@
 #define SIMPLEVECTOR_H
 
 #include <new>
+#include <string.h>
+#if __cplusplus>=201103L
+#include <utility>
+#include <type_traits>
+#endif
 
 #define SPARE_CAPACITY   16
 
+// Vector that never throws.  Storage is raw memory, objects are constructed in place as they are
+// added, and capacity grows geometrically.  SimpleVector can also be given a fixed external buffer,
+// in which case it never allocates and push_back() fails when the buffer is full.
 template <typename Object> class SimpleVector
 {
 public:
 
     SimpleVector(int initSize = 0)
-        : m_size(0), m_capacity(initSize + SPARE_CAPACITY)
-    { m_objects = new Object[m_capacity]; }
+        : m_size(0), m_capacity(0), m_objects(NULL), m_external(false)
+    { resize(initSize + SPARE_CAPACITY); }
+
+    // fixed external buffer mode, memory is owned by the caller
+    SimpleVector(Object *buf, int capacity)
+        : m_size(0), m_capacity(capacity), m_objects(buf), m_external(true)
+    { }
 
     ~SimpleVector()
-    { delete [] m_objects; }
+    {
+        destroy(0);
+        if (!m_external)
+            ::operator delete(m_objects);
+    }
 
+    // set capacity, but never below the current size
     int resize(int newCapacity)
     {
         if(newCapacity < m_size)
             return 0;
+        if (m_external)
+            return newCapacity<=m_capacity ? 0 : -1;
 
-        Object *oldArray = m_objects;
-
-        m_objects = new (std::nothrow) Object[newCapacity];
-        if (m_objects==NULL)
-        {
-            m_objects = oldArray;
+        Object *newArray = (Object *)::operator new(newCapacity*sizeof(Object), std::nothrow);
+        if (newArray==NULL)
             return -1;
-        }
-        for(int k = 0; k<m_size; k++)
-            m_objects[k] = oldArray[k];
 
+        relocate(newArray, m_objects, m_size);
+        ::operator delete(m_objects);
+        m_objects = newArray;
         m_capacity = newCapacity;
-
-        delete [] oldArray;
         return 0;
     }
 
+    int reserve(int capacity)
+    {
+        if (capacity<=m_capacity)
+            return 0;
+        return resize(capacity);
+    }
+
     Object & operator[](int index)
     { return m_objects[index]; }
 
@@ -68,28 +89,101 @@ public:
     int capacity() const
     { return m_capacity; }
 
-	const Object *data()
+	const Object *data() const
 	{ return m_objects; }
 
     int push_back(const Object& x)
     {
-        if(m_size == m_capacity)
-            if (resize(m_capacity + SPARE_CAPACITY)<0)
-                return -1;
-        m_objects[m_size++] = x;
+        if (grow()<0)
+            return -1;
+        new (m_objects + m_size) Object(x);
+        m_size++;
+        return 0;
+    }
+
+#if __cplusplus>=201103L
+    int push_back(Object&& x)
+    {
+        if (grow()<0)
+            return -1;
+        new (m_objects + m_size) Object(std::move(x));
+        m_size++;
         return 0;
     }
 
+    // construct in place, returns NULL if we're out of memory
+    template <typename... Args> Object *emplace_back(Args&&... args)
+    {
+        if (grow()<0)
+            return NULL;
+        Object *object = new (m_objects + m_size) Object(std::forward<Args>(args)...);
+        m_size++;
+        return object;
+    }
+#else
+    Object *emplace_back()
+    {
+        if (grow()<0)
+            return NULL;
+        Object *object = new (m_objects + m_size) Object();
+        m_size++;
+        return object;
+    }
+#endif
+
     void pop_back()
-    { m_size--; }
+    { destroy(m_size-1); }
 
 	void clear()
-	{ m_size = 0; }
+	{ destroy(0); }
 
 private:
+    // not copyable
+    SimpleVector(const SimpleVector &);
+    SimpleVector &operator=(const SimpleVector &);
+
+    int grow()
+    {
+        if (m_size<m_capacity)
+            return 0;
+        // double capacity so filling the vector costs amortized O(1) copies per element
+        return resize(m_capacity<SPARE_CAPACITY ? SPARE_CAPACITY : m_capacity*2);
+    }
+
+    // destroy objects from index to the end
+    void destroy(int index)
+    {
+        while(m_size>index)
+            m_objects[--m_size].~Object();
+    }
+
+    static void relocate(Object *dest, Object *src, int n)
+    {
+#if __cplusplus>=201103L
+        if (std::is_trivially_copyable<Object>::value)
+        {
+            if (n)
+                memcpy((void *)dest, (const void *)src, n*sizeof(Object));
+            return;
+        }
+        for (int k=0; k<n; k++)
+        {
+            new (dest + k) Object(std::move(src[k]));
+            src[k].~Object();
+        }
+#else
+        for (int k=0; k<n; k++)
+        {
+            new (dest + k) Object(src[k]);
+            src[k].~Object();
+        }
+#endif
+    }
+
     int m_size;
     int m_capacity;
     Object *m_objects;
+    bool m_external;
 };
 
 #endif // SIMPLEVECTOR_H
@@ -86,6 +86,63 @@ void SMoments::GetStats(SMomentStats &stats) const {
     }
 }
 
+// atan2 in 1/16 degree units, -180*16 to 180*16.  Uses the approximation
+// atan(z) = 45z + 15.64z(1-z) degrees for 0<=z<=1 (max error about 0.25 degrees)
+static int atan2Fixed(long long y, long long x)
+{
+    long long ay= y<0 ? -y : y;
+    long long ax= x<0 ? -x : x;
+    long long num, den;
+    int z, a;
+
+    if (ax==0 && ay==0)
+        return 0;
+    if (ay<=ax) {
+        num= ay;
+        den= ax;
+    } else {
+        num= ax;
+        den= ay;
+    }
+    // keep num<<15 within 64 bits
+    while (den>=(1LL<<47)) {
+        num >>= 1;
+        den >>= 1;
+    }
+    z= (int)((num<<15)/den); // 0 to 1 in Q15
+    a= (45*16*z + 250*(z*(32768-z)>>15) + (1<<14))>>15;
+    if (ay>ax)
+        a= 90*16 - a;
+    if (x<0)
+        a= 180*16 - a;
+    return y<0 ? -a : a;
+}
+
+void SMoments::GetStatsFixed(SMomentStatsFixed &stats, int xShift) const {
+    stats.area= area;
+    stats.angle= 0;
+    if (area==0) {
+        stats.centroidX= stats.centroidY= 0;
+        return;
+    }
+    // sumX and sumY are well within 32 bits (see above), so there's room for the fraction bits
+    stats.centroidX= ((sumX<<(MOMENT_CENTROID_SHIFT+xShift)) + (area>>1))/area;
+    stats.centroidY= ((sumY<<MOMENT_CENTROID_SHIFT) + (area>>1))/area;
+
+    if (computeAxes) {
+        // Central moments scaled by area so we don't need to divide:
+        // area*sum((x-|x|)^2) = area*sumXX - sumX^2, etc.
+        long long sx= (long long)sumX<<xShift;
+        long long sy= sumY;
+        long long xx= ((long long)area*sumXX<<(2*xShift)) - sx*sx;
+        long long yy= (long long)area*sumYY - sy*sy;
+        long long xy= ((long long)area*sumXY<<xShift) - sx*sy;
+        int a= atan2Fixed(2*xy, xx-yy);
+        // half of the angle, rounded to the nearest degree
+        stats.angle= a<0 ? -((-a+16)>>5) : (a+16)>>5;
+    }
+}
+
 void SSegment::GetMomentsTest(SMoments &moments) const {
     moments.Reset();
     int y= row;
@@ -37,6 +37,7 @@ Blobs::Blobs(Qqueue *qq, uint8_t *lut) : m_clut(lut)
     m_maxCodedDist = MAX_CODED_DIST;
     m_mergeDist = MAX_MERGE_DIST;
 	m_qvals = NULL;
+	m_decimation = 1;
 
     m_ccMode = DISABLED;
 
@@ -51,6 +52,9 @@ Blobs::Blobs(Qqueue *qq, uint8_t *lut) : m_clut(lut)
 	m_blobTrackerIndex = 0;
 	setBlobFiltering(BL_BLOB_FILTERING);
 	setMaxBlobVelocity(BL_MAX_TRACKING_DIST);
+
+	// accumulate second moments for each blob as segments are added so we can report orientation
+	SMoments::computeAxes = true;
 	
     // reset blob assemblers
     for (i=0; i<CL_NUM_SIGNATURES; i++)
@@ -150,6 +154,7 @@ int Blobs::runlengthAnalysis()
     Qval qval;
 	register int32_t u, v, c;
 	int res=0, res2=0;
+	uint16_t i, step;
 
 	if (m_sendDetectedPixels)
 	{
@@ -161,6 +166,11 @@ int Blobs::runlengthAnalysis()
 
     m_numQvals = 0;
 
+	// the M0 may skip lines if we fall behind, so keep blobs connected across skipped lines
+	m_decimation = 1;
+	for (i=0; i<CL_NUM_SIGNATURES; i++)
+		m_assembler[i].maxRowDelta = 1;
+
 	setTimer(&timer);
 	
     while(1)
@@ -189,8 +199,17 @@ int Blobs::runlengthAnalysis()
                 res = handleSegment(segmentSig, row, segmentStartCol-1, segmentEndCol - segmentStartCol+1);
                 segmentSig = 0;
             }
-            row++;
-			addQval(0);
+			// m_y is the number of lines since the last line begin (0 from older M0 code means 1)
+			step = qval.m_y ? qval.m_y : 1;
+			if (step>m_decimation)
+			{
+				m_decimation = step;
+				for (i=0; i<CL_NUM_SIGNATURES; i++)
+					m_assembler[i].maxRowDelta = step;
+			}
+            row += step;
+			for (i=0; i<step; i++)
+				addQval(0);
 			if (icount++==5) // an interleave of every 5 lines or about every 175us seems good
 			{
 				g_chirpUsb->service();
@@ -267,6 +286,7 @@ int Blobs::blobify()
     BlobA *blobsStart;
     uint16_t numBlobsStart, invalid, invalid2;
     uint16_t left, top, right, bottom;
+    SMomentStatsFixed stats;
     //uint32_t timer, timer2=0;
 
 	if (runlengthAnalysis()<0)
@@ -292,8 +312,9 @@ int Blobs::blobify()
         for (k=0, blobsStart=m_blobs+m_numBlobs, numBlobsStart=m_numBlobs, blob=m_assembler[i].finishedBlobs;
              blob && m_numBlobs<m_maxBlobs && k<m_maxBlobsPerModel; blob=blob->next, k++)
         {
-            if ((colorCode && blob->GetArea()<MIN_COLOR_CODE_AREA) ||
-                (!colorCode && blob->GetArea()<(int)m_minArea))
+            // scale area by decimation, since we only saw some of the lines
+            if ((colorCode && blob->GetArea()*m_decimation<MIN_COLOR_CODE_AREA) ||
+                (!colorCode && blob->GetArea()*m_decimation<(int)m_minArea))
                 continue;
             blob->getBBox((short &)left, (short &)top, (short &)right, (short &)bottom);
             if (bottom-top<=1) // blobs that are 1 line tall
@@ -303,6 +324,12 @@ int Blobs::blobify()
             m_blobs[m_numBlobs].m_right = right<<1;
             m_blobs[m_numBlobs].m_top = top;
             m_blobs[m_numBlobs].m_bottom = bottom;
+            // columns are subsampled by 2, so scale x
+            blob->moments.GetStatsFixed(stats, 1);
+            m_blobs[m_numBlobs].m_cx = stats.centroidX;
+            m_blobs[m_numBlobs].m_cy = stats.centroidY;
+            m_blobs[m_numBlobs].m_orientation = -stats.angle; // positive y is up, like color code angle
+            m_blobs[m_numBlobs].m_area = stats.area;
             m_numBlobs++;
         }
         //setTimer(&timer);
@@ -499,11 +526,12 @@ int compAreaBlobC(const void *a, const void *b)
 }
 
 
-int Blobs::getBlobs(uint8_t sigmap, uint8_t n, uint8_t *buf, uint16_t len)
+int Blobs::getBlobs(uint8_t sigmap, uint8_t n, uint8_t *buf, uint16_t len, bool moments)
 {
 	BlobC *retBlobs;
+	BlobD *retBlobsD;
 	BlobA *blob;
-	uint16_t bi;
+	uint16_t bi, size;
 	uint8_t sigbit;
 	SimpleListNode<Tracker<BlobA> > *i;
 	
@@ -512,7 +540,9 @@ int Blobs::getBlobs(uint8_t sigmap, uint8_t n, uint8_t *buf, uint16_t len)
 		return -1;
 	
 	retBlobs = (BlobC *)buf;
-	len /= sizeof(BlobC);
+	retBlobsD = (BlobD *)buf;
+	size = moments ? sizeof(BlobD) : sizeof(BlobC);
+	len /= size;
 	for (i=m_blobTrackersList.m_first, bi=0; i!=NULL && bi<len; i=i->m_next)
 	{
 		blob = i->m_object.get();
@@ -521,24 +551,33 @@ int Blobs::getBlobs(uint8_t sigmap, uint8_t n, uint8_t *buf, uint16_t len)
 			sigbit = (1<<(blob->m_model-1));
 			if ((blob->m_model>CL_NUM_SIGNATURES && sigmap&0x80) || sigbit&sigmap)
 			{
-				convertBlob(&retBlobs[bi], *blob);
-				retBlobs[bi].m_index = i->m_object.m_index;
-				retBlobs[bi].m_age = i->m_object.m_age;
+				if (moments)
+				{
+					convertBlob(&retBlobsD[bi], *blob);
+					retBlobsD[bi].m_index = i->m_object.m_index;
+					retBlobsD[bi].m_age = i->m_object.m_age;
+				}
+				else
+				{
+					convertBlob(&retBlobs[bi], *blob);
+					retBlobs[bi].m_index = i->m_object.m_index;
+					retBlobs[bi].m_age = i->m_object.m_age;
+				}
 				bi++;
 			}
 		}
 	}
 
 	// sort blobs by area
-	qsort(retBlobs, bi, sizeof(BlobC), compAreaBlobC);
+	qsort(buf, bi, size, compAreaBlobC); // BlobD starts with a BlobC, so the same compare works
 	m_blobReadIndex = 1; // flag that we "gotBlobs"
 	
 	// note, we need to create a decently-long list so we can sort (above) and then return the n biggest
 	// entries which will be at the top of the list
 	if (n<bi)
-		return n*sizeof(BlobC);
+		return n*size;
 	else
-		return bi*sizeof(BlobC);		
+		return bi*size;		
 }
 
 SimpleList<Tracker<BlobA> > *Blobs::getBlobs()
@@ -744,12 +783,29 @@ uint16_t Blobs::combine2(BlobA *blobs, uint16_t numBlobs)
 
             invalid += merge(m1, left0, right0, top0, bottom0, left1, right1, top1, bottom1);
             invalid += merge(m1, top0, bottom0, left0, right0, top1, bottom1, left1, right1);
+            if (*m1==0) // merged
+                mergeMoments(&blobs[i], blobs[j]);
         }
     }
 
     return invalid;
 }
 
+void Blobs::mergeMoments(BlobA *blob0, const BlobA &blob1)
+{
+	uint32_t area;
+
+	area = blob0->m_area + blob1.m_area;
+	if (area==0)
+		return;
+	blob0->m_cx = (blob0->m_cx*blob0->m_area + blob1.m_cx*blob1.m_area + (area>>1))/area;
+	blob0->m_cy = (blob0->m_cy*blob0->m_area + blob1.m_cy*blob1.m_area + (area>>1))/area;
+	// we don't keep the second moments around, so take the orientation of the bigger blob
+	if (blob1.m_area>blob0->m_area)
+		blob0->m_orientation = blob1.m_orientation;
+	blob0->m_area = area;
+}
+
 int16_t Blobs::distance(BlobA *blob0, BlobA *blob1)
 {
     int16_t left0, right0, top0, bottom0;
@@ -1102,6 +1158,10 @@ void Blobs::processCC()
         codedBlob->m_right = blobs[right]->m_right;
         codedBlob->m_top = blobs[top]->m_top;
         codedBlob->m_bottom = blobs[bottom]->m_bottom;
+        // centroid of the color code is the area-weighted centroid of its swatches
+        codedBlob->m_area = 0;
+        for (k=0; k<j; k++)
+            mergeMoments(codedBlob, *blobs[k]);
 
 #if 1
         // is it more horizontal than vertical?
@@ -1145,6 +1205,7 @@ void Blobs::processCC()
             codedBlob->m_model = codedModel;
             codedBlob->m_angle = angle(blobs[j-1], blobs[0]);
         }
+        codedBlob->m_orientation = codedBlob->m_angle;
 #endif
         //DBG("cc %d %d %d %d %d", m_numCCBlobs, codedBlob->m_left, codedBlob->m_right, codedBlob->m_top, codedBlob->m_bottom);
         codedBlob++;
@@ -1366,4 +1427,10 @@ void Blobs::convertBlob(BlobC *blobc, const BlobA &bloba)
 	blobc->m_angle = bloba.m_angle;
 }
 
-
+void Blobs::convertBlob(BlobD *blobd, const BlobA &bloba)
+{
+	convertBlob((BlobC *)blobd, bloba);
+	blobd->m_cx = bloba.m_cx;
+	blobd->m_cy = bloba.m_cy;
+	blobd->m_orientation = bloba.m_orientation;
+}
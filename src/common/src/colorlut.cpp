@@ -16,6 +16,7 @@
 #include <stdlib.h>
 #include <math.h>
 #include <string.h>
+#include <new>
 #include "colorlut.h"
 #include "calc.h"
 
@@ -265,7 +266,91 @@ void ColorLUT::calcRatios(IterPixel *ip, ColorSignature *sig, float ratios[])
 }
 #endif
 
+static inline uint32_t histIndex(int32_t val)
+{
+    val = (val + (1<<CL_LUT_ENTRY_SCALE))>>CL_HIST_SHIFT;
+    if (val<0)
+        return 0;
+    if (val>=CL_HIST_SIZE)
+        return CL_HIST_SIZE-1;
+    return val;
+}
+
+static inline int32_t histBinMin(int32_t bin)
+{
+    return (bin<<CL_HIST_SHIFT) - (1<<CL_LUT_ENTRY_SCALE);
+}
+
+// find largest bound such that the number of values greater than the bound exceeds thresh.
+// Within the bin where the crossing happens, we assume values are evenly distributed.
+static int32_t histMinBound(const uint32_t *hist, uint32_t n, float thresh)
+{
+    int32_t bin;
+    uint32_t above;
+
+    for (bin=0, above=n; bin<CL_HIST_SIZE && above>thresh; above-=hist[bin], bin++)
+    {
+        if (above-hist[bin]<=thresh)
+            return histBinMin(bin) - 1 + (int32_t)((above - thresh)*(1<<CL_HIST_SHIFT)/hist[bin]);
+    }
+    return histBinMin(bin) - 1;
+}
+
+// find smallest bound such that the number of values less than the bound exceeds thresh.
+static int32_t histMaxBound(const uint32_t *hist, uint32_t n, float thresh)
+{
+    int32_t bin;
+    uint32_t below;
+
+    for (bin=CL_HIST_SIZE-1, below=n; bin>=0 && below>thresh; below-=hist[bin], bin--)
+    {
+        if (below-hist[bin]<=thresh)
+            return histBinMin(bin+1) - (int32_t)((below - thresh)*(1<<CL_HIST_SHIFT)/hist[bin]);
+    }
+    return histBinMin(bin+1);
+}
+
 void ColorLUT::iterate(IterPixel *ip, ColorSignature *sig)
+{
+    UVPixel uv;
+    uint32_t n, *uhist, *vhist;
+    float thresh;
+
+    // histograms are too big for the stack, so grab them from the heap
+    uhist = new (std::nothrow) uint32_t[CL_HIST_SIZE*2];
+    if (uhist==NULL)
+    {
+        search(ip, sig); // fall back to the (much slower) binary search
+        return;
+    }
+    vhist = uhist + CL_HIST_SIZE;
+    memset(uhist, 0, sizeof(uint32_t)*CL_HIST_SIZE*2);
+
+    // one pass through the pixels, then all four bounds come from cumulative histogram lookups
+    ip->reset();
+    for (n=0; ip->next(&uv); n++)
+    {
+        uhist[histIndex(uv.m_u)]++;
+        vhist[histIndex(uv.m_v)]++;
+    }
+
+    if (n==0)
+        sig->m_uMin = sig->m_uMax = sig->m_vMin = sig->m_vMax = 0;
+    else
+    {
+        thresh = m_ratio*n;
+        sig->m_uMin = histMinBound(uhist, n, thresh);
+        sig->m_uMax = histMaxBound(uhist, n, thresh);
+        sig->m_vMin = histMinBound(vhist, n, thresh);
+        sig->m_vMax = histMaxBound(vhist, n, thresh);
+    }
+    sig->m_uMean = (sig->m_uMin + sig->m_uMax)/2;
+    sig->m_vMean = (sig->m_vMin + sig->m_vMax)/2;
+
+    delete [] uhist;
+}
+
+void ColorLUT::search(IterPixel *ip, ColorSignature *sig)
 {
     int32_t scale;
     float ratios[4];
@@ -45,6 +45,7 @@
 #define CAM_LINE_SKIP 			    12
 #define CAM_PREBUF_LEN			    64
 #define CAM_FRAME_HEADER_LEN    36
+#define CAM_WINDOW_HEADER_LEN   52
 
 #define CAM_GRAB_M0R0           (CAM_RES0<<4 | CAM_MODE0)
 #define CAM_GRAB_M1R1           (CAM_RES1<<4 | CAM_MODE1)
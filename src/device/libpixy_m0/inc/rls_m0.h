@@ -19,6 +19,10 @@
 #include <stdint.h>
 
 #define MAX_NEW_QVALS_PER_LINE   ((CAM_RES2_WIDTH/3)+2)
+// When free space in the qqueue drops below this, only every other line is processed
+#define RLS_DECIMATE_THRESHOLD   (MAX_NEW_QVALS_PER_LINE*3)
+// Give up on the frame (queue overrun) if we would need to skip more lines than this in a row
+#define RLS_MAX_ROW_STEP         4
 
 int rls_init(void);
 int32_t getRLSFrame(uint32_t *m0Mem, uint32_t *lut);
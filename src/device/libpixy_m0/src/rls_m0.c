@@ -383,10 +383,14 @@ uint32_t rgData[] =
 
 int g_foo = 0;
 
+// The line begin qval (m_col==0) carries the number of lines since the previous line begin in m_y,
+// and the frame end qval carries the largest such step (the decimation factor) in m_y.  When the M4
+// falls behind, we skip lines instead of dropping the whole frame.
 int32_t getRLSFrame(uint32_t *m0Mem, uint32_t *lut)
 {
 	uint8_t *lut2 = (uint8_t *)*lut;
 	uint32_t line;
+	uint16_t step, qfree;
 	Qval *qvalStore;
 	uint32_t numQvals;
 	uint8_t *lineStore;
@@ -400,16 +404,29 @@ int32_t getRLSFrame(uint32_t *m0Mem, uint32_t *lut)
    	qvalStore =	(Qval *)*m0Mem;
 	lineStore = (uint8_t *)*m0Mem + MAX_NEW_QVALS_PER_LINE*sizeof(Qval);
 	skipLines(1);
-	for (line=0; line<CAM_RES2_HEIGHT; line++) 
+	for (line=0, step=1; line<CAM_RES2_HEIGHT; line++, step++) 
 	{
-		// not enough space--- return error
-		if (qq_free()<MAX_NEW_QVALS_PER_LINE)
+		qfree = qq_free();
+		// not enough space for this line, or queue is filling up and this is an odd line-- skip it
+		if (qfree<MAX_NEW_QVALS_PER_LINE || (qfree<RLS_DECIMATE_THRESHOLD && (line&1)))
 		{
-			frameEnd.m_col = 0xfffe;
-			qq_enqueue(&frameEnd);
-			//printf("*\n");
-			return -1;
+			// M4 is too far behind, return error
+			if (step>=RLS_MAX_ROW_STEP)
+			{
+				frameEnd.m_col = 0xfffe;
+				qq_enqueue(&frameEnd);
+				//printf("*\n");
+				return -1;
+			}
+			// each line is a pair of sensor lines (blue/green and red/green)
+			skipLine();
+			skipLine();
+			continue;
 		} 
+		lineBegin.m_y = step;
+		if (step>frameEnd.m_y)
+			frameEnd.m_y = step;
+		step = 0;
 		qq_enqueue(&lineBegin); 
 		lineProcessedRL0A((uint32_t *)&CAM_PORT, lineStore, CAM_RES2_WIDTH/2); 
 		numQvals = lineProcessedRL1A((uint32_t *)&CAM_PORT, qvalStore, lut2, lineStore, CAM_RES2_WIDTH/2, g_qqueue->data, g_qqueue->writeIndex, QQ_MEM_SIZE);
@@ -67,6 +67,7 @@ int32_t cam_setResolution(const uint16_t &xoffset, const uint16_t &yoffset, cons
 
 void cam_loadParams();
 int32_t cam_sendFrame(Chirp *chirp, uint16_t xWidth, uint16_t yWidth, uint8_t renderFlags=RENDER_FLAG_FLUSH, uint32_t fourcc=FOURCC('B','A','8','1'));
+int32_t cam_sendWindow(Chirp *chirp, uint16_t frameWidth, uint16_t frameHeight, const RectA &window, uint8_t renderFlags=RENDER_FLAG_FLUSH);
 
 extern CSccb *g_sccb;
 extern Frame8 g_rawFrame;
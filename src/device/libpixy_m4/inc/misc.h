@@ -22,6 +22,13 @@
 #define STR(s)           #s
 #define STRINGIFY(s)     STR(s)
 
+// DWT cycle counter, see timerInit()
+#define DEMCR                (*(volatile uint32_t *)0xE000EDFC)
+#define DEMCR_TRCENA         (1<<24)
+#define DWT_CTRL             (*(volatile uint32_t *)0xE0001000)
+#define DWT_CTRL_CYCCNTENA   (1<<0)
+#define DWT_CYCCNT           (*(volatile uint32_t *)0xE0001004)
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -35,6 +42,9 @@ void setTimer(uint32_t *timer);
 uint32_t getTimer(uint32_t timer);
 void setTimerMs(uint16_t *timer);
 uint16_t getTimerMs(uint16_t timer);
+// CPU clock cycles (CLKFREQ), wraps about every 21 seconds
+void setCycleTimer(uint32_t *timer);
+uint32_t getCycleTimer(uint32_t timer);
 void showError(uint8_t num, uint32_t color, const char *message);
 
 
@@ -2017,6 +2017,26 @@ int32_t cam_sendFrame(Chirp *chirp, uint16_t xWidth, uint16_t yWidth, uint8_t re
 	return 0;
 }
 
+// Send part of a frame (BA8W), e.g. a window around an object.  The window's pixels are at the 
+// start of the frame buffer, like a frame sent with cam_sendFrame(), and the header tells where 
+// the window is in a frame of frameWidth x frameHeight, so it can be shown in place. 
+int32_t cam_sendWindow(Chirp *chirp, uint16_t frameWidth, uint16_t frameHeight, const RectA &window, uint8_t renderFlags)
+{
+	int32_t len;
+
+	uint8_t *frame = (uint8_t *)SRAM1_LOC + CAM_PREBUF_LEN - CAM_WINDOW_HEADER_LEN;
+	// fill buffer contents manually for return data 
+	len = Chirp::serialize(chirp, frame, SRAM1_SIZE, HTYPE(FOURCC('B','A','8','W')), HINT8(renderFlags), UINT16(frameWidth), UINT16(frameHeight), 
+		UINT16(window.m_xOffset), UINT16(window.m_yOffset), UINT16(window.m_width), UINT16(window.m_height), UINTS8_NO_COPY(window.m_width*window.m_height), END);
+	if (len!=CAM_WINDOW_HEADER_LEN)
+		return -1;
+	
+	// tell chirp to use this buffer
+	chirp->useBuffer(frame, CAM_WINDOW_HEADER_LEN+window.m_width*window.m_height); 
+
+	return 0;
+}
+
 int32_t cam_setReg8(const uint16_t &reg, const uint8_t &value)
 {
   	g_sccb->Write8(reg, value);
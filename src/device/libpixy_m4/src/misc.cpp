@@ -101,6 +101,16 @@ uint16_t getTimerMs(uint16_t timer)
 	return result;
 }
 
+void setCycleTimer(uint32_t *timer)
+{
+	*timer = DWT_CYCCNT;
+}
+
+uint32_t getCycleTimer(uint32_t timer)
+{
+	return DWT_CYCCNT-timer;
+}
+
 void showError(uint8_t num, uint32_t color, const char *message)
 {
 	int i;
@@ -133,6 +133,11 @@ void timerInit(void)
 	LPC_TIMER2->IR = 0;
  	LPC_TIMER2->TCR = 1;
 	LPC_TIMER2->PR = CLKFREQ_US-1;
+
+	// DWT cycle counter, used for profiling
+	DEMCR |= DEMCR_TRCENA;
+	DWT_CYCCNT = 0;
+	DWT_CTRL |= DWT_CTRL_CYCCNTENA;
 }
 
 
@@ -21,6 +21,12 @@
 
 #define LUT_MEMORY          ((uint8_t *)SRAM1_LOC + SRAM1_SIZE - CL_LUT_SIZE)
 
+// "tracked region video" view, see ProgBlobs::sendRegion().  The largest region is a whole 
+// standard frame (CAM_RES2_WIDTH*CAM_RES2_HEIGHT), which is all the room there is for it.
+#define REGION_DEFAULT_PADDING   16
+#define REGION_DEFAULT_BYTES     16384
+#define REGION_MAX_BYTES         65728
+
 int cc_init(Chirp *chirp);
 int cc_open();
 int cc_close();
@@ -47,5 +53,9 @@ extern Qqueue *g_qqueue;
 extern Blobs *g_blobs;
 extern const uint32_t g_colors[];
 extern uint16_t g_ledBrightness;
+extern uint16_t g_regionPadding;
+extern uint8_t g_regionIndex;
+extern uint8_t g_regionRes;
+extern uint32_t g_regionBytes;
 
 #endif
@@ -126,6 +126,7 @@ int exec_progExit();
 void exec_progPacket(uint8_t type, const uint8_t *data, uint8_t len, bool checksum);
 int exec_progResolution(uint8_t type, bool checksum);
 int exec_changeProg(uint8_t type);
+bool exec_progHandlesType(uint8_t type);
 
 // Chirp functions
 uint32_t exec_running(Chirp *chirp=NULL);
@@ -20,7 +20,7 @@
 
 #define I2C_DEFAULT_SLAVE_ADDR    0x54
 #define I2C_TRANSMIT_BUF_SIZE     32
-#define I2C_RECEIVE_BUF_SIZE      64
+#define I2C_RECEIVE_BUF_SIZE      256 // room for a whole packet's data (SER_MAXLEN)
 
 class I2c : public Iserial
 {
@@ -24,32 +24,38 @@ extern __inline color RGB2Cr(const color r, const color g, const color b)
 	return (8421376 + 32767*r - 27438*g - 5329*b) >> 16;
 }
 
-// Application should provide this function for JPEG stream flushing
-void write_jpeg(const unsigned char buff[], const unsigned size);
-
-typedef struct huffman_s
+// Encoder context, all of the state of one encoding, see jpeg_init()
+typedef struct jpeg_s
 {
-	const unsigned char  (*haclen)[12];
-	const unsigned short (*hacbit)[12];
-	const unsigned char  *hdclen;
-	const unsigned short *hdcbit;
-	const unsigned char  *qtable;
-	short                dc;
+	unsigned char  qtable_0_lum[64];	// quantization tables, natural order, for the DQT header 
+	unsigned char  qtable_0_chrom[64];
+	unsigned char  qtable_lum[64];		// their reciprocals, zig-zag order
+	unsigned char  qtable_chrom[64];
+	short          dc[3];				// DC predictions, Y, Cb, Cr
+	unsigned short restart;				// restart interval (MCUs), 0 for none
+	uint32_t       bitbuf;				// bits, from the most significant one down
+	unsigned       bitfree;				// number of unused bits at the bottom of bitbuf, 1-32
+	unsigned char  *out;
+	uint32_t       outSize;
+	uint32_t       outIndex;
+	unsigned char  overflow;			// output didn't fit and was truncated
 }
-huffman_t;
-
-extern huffman_t huffman_ctx[3];
+jpeg_t;
 
-#define	HUFFMAN_CTX_Y	&huffman_ctx[0]
-#define	HUFFMAN_CTX_Cb	&huffman_ctx[1]
-#define	HUFFMAN_CTX_Cr	&huffman_ctx[2]
+#define	HUFFMAN_CTX_Y	0
+#define	HUFFMAN_CTX_Cb	1
+#define	HUFFMAN_CTX_Cr	2
 
-void huffman_start(short height, short width);
-void huffman_stop(void);
-void huffman_encode(huffman_t *const ctx, const short data[]);
-void setQuality(unsigned char quality);
+void jpeg_init(jpeg_t *ctx, unsigned char quality, unsigned short restart);
+void jpeg_setOutput(jpeg_t *ctx, unsigned char *out, uint32_t size);
+void huffman_start(jpeg_t *ctx, short height, short width);
+void huffman_reset(jpeg_t *ctx);
+void huffman_flush(jpeg_t *ctx);
+void huffman_stop(jpeg_t *ctx);
+void huffman_encode(jpeg_t *const ctx, const unsigned component, const short data[]);
 
 
 int jpeg_encode(const Frame8 *frame, uint8_t quality, uint8_t *out, uint32_t *size);
+int jpeg_encodeRows(jpeg_t *ctx, const Frame8 *frame, uint16_t y0, uint16_t y1);
 
 #endif//__JPEG_H__
@@ -0,0 +1,693 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+#ifndef _LINEENGINE_H
+#define _LINEENGINE_H
+
+#include <stdint.h>
+#include "pixytypes.h"
+#include "cameravals.h"
+#include "equeue.h"
+#include "simplelist.h"
+#include "tracker.h"
+
+#define LINE_EDGE_DIST_DEFAULT            4
+#define LINE_EDGE_THRESH_DEFAULT          35
+#define LINE_HTHRESH_RATIO	              3/5
+#define LINE_EXTRACTION_DIST_DEFAULT      13
+#define LINE_MAX_MERGE_DIST               6
+#define LINE_MIN_LENGTH                   10
+#define LINE_MIN_WIDTH                    0
+#define LINE_MAX_WIDTH                    100
+#define LINE_VSIZE			              (CAM_RES3_WIDTH/4)
+#define LINE_MAX_COMPARE                  5000
+
+#define LINE_NODE_FLAG_V                  EQ_NODE_FLAG_V
+
+#define LINE_GRID_WIDTH_REDUCTION         3
+#define LINE_GRID_HEIGHT_REDUCTION        1
+#define LINE_GRID_WIDTH                   (CAM_RES3_WIDTH>>LINE_GRID_WIDTH_REDUCTION)
+#define LINE_GRID_HEIGHT                  (CAM_RES3_HEIGHT>>LINE_GRID_HEIGHT_REDUCTION)
+
+#define LINE_GRID_INDEX(x, y)             (LINE_GRID_WIDTH*(y)+(x))
+#define LINE_GRID_INDEX_P(p)              LINE_GRID_INDEX(p.m_x, p.m_y)
+
+// The grid state is kept in bitmaps, 32 nodes per word, each row starting on a word boundary.  
+#define LINE_GRID_ROW_WORDS               ((LINE_GRID_WIDTH+31)>>5)
+#define LINE_GRID_MAP_WORDS               (LINE_GRID_ROW_WORDS*LINE_GRID_HEIGHT)
+#define LINE_GRID_WORD(x, y)              (LINE_GRID_ROW_WORDS*(y)+((x)>>5))
+#define LINE_GRID_BIT(x)                  ((uint32_t)1<<((x)&0x1f))
+#define LINE_GRID_TEST(map, x, y)         ((map)[LINE_GRID_WORD(x, y)]&LINE_GRID_BIT(x))
+#define LINE_GRID_SET(map, x, y)          ((map)[LINE_GRID_WORD(x, y)] |= LINE_GRID_BIT(x))
+#define LINE_GRID_CLEAR(map, x, y)        ((map)[LINE_GRID_WORD(x, y)] &= ~LINE_GRID_BIT(x))
+// line index of a node, 0 if the node isn't part of a line
+#define LINE_GRID_MAP_LINE(grid, label, x, y) (LINE_GRID_TEST(label, x, y) ? (grid)[LINE_GRID_INDEX(x, y)]&LINE_NODE_LINE_MASK : 0)
+#define LINE_GRID_LINE(x, y)              LINE_GRID_MAP_LINE(m_lineGrid, m_gridLabel, x, y) // LineEngine members only
+#define LINE_GRID_LINE_P(p)               LINE_GRID_LINE(p.m_x, p.m_y)
+#define LINE_GRID_OPEN(x, y)              LINE_GRID_TEST(m_gridOpen, x, y) // LineEngine members only
+
+// Line endpoints are sorted into cells of 8x8 grid nodes, so finding the endpoints near a point (nadir search, line 
+// tracking) only looks at the endpoints in the surrounding cells. 
+#define LINE_CELL_REDUCTION               3
+#define LINE_CELL_SIZE                    (1<<LINE_CELL_REDUCTION)
+#define LINE_CELLS_WIDTH                  ((LINE_GRID_WIDTH+LINE_CELL_SIZE-1)>>LINE_CELL_REDUCTION)
+#define LINE_CELLS_HEIGHT                 ((LINE_GRID_HEIGHT+LINE_CELL_SIZE-1)>>LINE_CELL_REDUCTION)
+#define LINE_CELL_X(x)                    ((x)<LINE_GRID_WIDTH ? (x)>>LINE_CELL_REDUCTION : LINE_CELLS_WIDTH-1)
+#define LINE_CELL_Y(y)                    ((y)<LINE_GRID_HEIGHT ? (y)>>LINE_CELL_REDUCTION : LINE_CELLS_HEIGHT-1)
+#define LINE_CELL(x, y)                   (LINE_CELLS_WIDTH*(y)+(x))
+#define LINE_CELL_P(p)                    LINE_CELL(LINE_CELL_X(p.m_x), LINE_CELL_Y(p.m_y))
+#define LINE_CELL_NONE                    0xffff
+
+
+#define LINE_NODE_LINE_MASK               0x03ff
+#define LINE_NODE_FLAG_HLINE              EQ_NODE_FLAG_HLINE
+#define LINE_NODE_FLAG_VLINE              EQ_NODE_FLAG_VLINE
+#define LINE_NODE_FLAG_1                  (LINE_NODE_FLAG_HLINE | LINE_NODE_FLAG_VLINE)
+#define LINE_NODE_FLAG_NULL               0x8000
+#define LINE_MAX_SEGMENTS                 0x100
+#define LINE_MAX_LINES                    0x80
+#define LINE_MAX_NADIRS                   0x100
+#define LINE_MAX_INTERSECTIONS            LINE_MAX_LINES
+#define LINE_MAX_LINE_TRACKERS            (LINE_MAX_LINES*2) // trackers linger while trailing
+#define LINE_MAX_BARCODE_TRACKERS         (LINE_MMC_VOTED_BARCODES*2)
+#define LINE_MAX_SEGMENT_POINTS           32
+#define LINE_MAX_INTERSECTION_LINES       8 // needs to be an even number
+#define LINE_MAX_FRAME_INTERSECTION_LINES 6 // needs to be an even numbe
+
+#define LINE_DEBUG_BENCHMARK              1  // not bit
+#define LINE_DEBUG_LAYERS                 2  // bit
+#define LINE_DEBUG_GRAPH_CHECK            4  // bit
+#define LINE_DEBUG_TRACKING               8 // bit
+#define LINE_DEBUG_PROFILE                16 // bit
+
+#define LINE_PROFILE_BUCKETS              64 // 4 per octave, from 2^8 to 2^24 cycles (1.25us to 82ms)
+#define LINE_PROFILE_MIN_OCTAVE           8
+#define LINE_PROFILE_STATS                5  // count, min, mean, p99, max
+
+#define LINE_MMC_BITS                     4
+#define LINE_MMC_MIN_EDGES                (4+LINE_MMC_BITS)
+#define LINE_MMC_MAX_EDGES                (2+(LINE_MMC_BITS*2))
+
+#define LINE_MMC_CANDIDATE_BARCODES       32
+#define LINE_MMC_VOTED_BARCODES           8
+#define LINE_MMC_VTSIZE                   8  // voting table size
+#define LINE_MMC_VBOUNDARY                0.25
+#define LINE_MMC_HBOUNDARY                0.1
+
+#define LINE_MIN_ACQUISITION_TAN_ANGLE    500
+#define LINE_MIN_ACQUISITION_LENGTH2      15*15
+
+// define 2 bits to describe which of the two points we are referring to on a line -- is it the upper-most point?
+// or the right-most point?
+#define LINE_HT_UP                        0x01
+#define LINE_HT_DOWN                      0x02
+#define LINE_HT_LEFT                      0x04
+#define LINE_HT_RIGHT                     0x08
+
+#define LINE_FILTERING_MULTIPLIER         16
+
+#define LINE_LINE_FILTERING				  1
+#define LINE_INTERSECTION_FILTERING       1
+#define LINE_BARCODE_FILTERING            1
+
+#define LINE_MIN_INTERSECTION_DETECT      (LINE_GRID_HEIGHT/4) 
+
+#define LINE_FR_VECTOR_LINES                 0x01
+#define LINE_FR_INTERSECTION                 0x02
+#define LINE_FR_BARCODE                      0x04
+
+#define LINE_FR_DELTA                        0x08 // FrameDelta, first section of a getDeltaFrame() response
+#define LINE_FR_REMOVED                      0x10 // FrameRemoved records
+#define LINE_FR_INDEXED_BARCODE              0x20 // FrameIndexedCode records, barcodes in delta responses
+
+#define LINE_FR_FLAG_INTERSECTION            0x04
+
+#define LINE_FR_DELTA_FULL                   0x01 // client should discard its features before applying
+
+// most features the client of getDeltaFrame() keeps, so both sides agree on what it has
+#define LINE_DELTA_MAX_LINES                 24
+#define LINE_DELTA_MAX_BARCODES              LINE_MAX_BARCODE_TRACKERS
+#define LINE_DELTA_MAX_INTERSECTIONS         4
+
+#define LINE_MODEMAP_TURN_DELAYED            0x01
+#define LINE_MODEMAP_MANUAL_SELECT_VECTOR    0x02
+#define LINE_MODEMAP_WHITE_LINE              0x80
+
+enum LineState
+{
+	LINE_STATE_ACQUIRING, 
+	LINE_STATE_TRACKING
+};
+
+// Candidates are added to clusters as they're detected, and each cluster tallies the votes for 
+// its values as they come in. 
+struct BarCodeCluster
+{
+    BarCodeCluster()
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        uint8_t i;
+
+        m_n = 0;
+        for (i=0; i<LINE_MMC_VTSIZE; i++)
+            m_votes[i] = 0;
+    }
+
+    void addCode(int16_t val)
+    {
+        uint8_t i;
+
+        if (m_n>=LINE_MMC_CANDIDATE_BARCODES)
+            return;
+        m_n++;
+        if (val<0)
+            return;
+        // find index or empty location
+        for (i=0; i<LINE_MMC_VTSIZE; i++)
+        {
+            if (m_votes[i]==0)
+            {
+                m_vals[i] = val;
+                break;
+            }
+            if (m_vals[i]==val)
+                break;
+        }
+        if (i<LINE_MMC_VTSIZE)
+            m_votes[i]++; // add vote
+    }
+
+    void updateWidth(uint16_t width)
+    {
+        m_width = (m_width*(m_n-1) + width)/m_n; // recursive averager
+    }
+
+    int16_t m_vals[LINE_MMC_VTSIZE];
+    uint8_t m_votes[LINE_MMC_VTSIZE];
+    uint8_t m_n;
+    Point16 m_p0;
+    Point16 m_p1;
+    uint16_t m_width;
+};
+
+struct BarCode
+{
+    BarCode()
+    {
+        m_n = 0;
+    }
+
+    Point16 m_p0;
+    uint16_t m_width;
+    int16_t m_val;
+    uint16_t m_edges[LINE_MMC_MAX_EDGES];
+    uint8_t m_n;
+};
+
+
+struct DecodedBarCode
+{
+    RectA m_outline;
+    int16_t m_val;
+	Tracker<DecodedBarCode> *m_tracker;
+};
+
+
+typedef uint16_t LineGridNode;
+
+struct Nadir
+{
+	Nadir()
+	{
+		m_n = 0;
+		m_dist = 0;
+	}
+	
+	void merge(const Nadir &n, const LineGridNode *grid, const uint32_t *label)
+	{
+		uint16_t xavg, yavg;
+		uint8_t i, j, li, lj;
+		
+		// look through list, make sure there are no duplicate lines
+		for (i=0; i<n.m_n; i++)
+		{
+			if (m_n>=LINE_MAX_INTERSECTION_LINES)
+				return;
+			li = LINE_GRID_MAP_LINE(grid, label, n.m_points[i].m_x, n.m_points[i].m_y);
+			for (j=0; j<m_n; j++)
+			{
+				lj = LINE_GRID_MAP_LINE(grid, label, m_points[j].m_x, m_points[j].m_y);
+				if (li==lj)
+					break;
+			}
+			if (j==m_n) // we reached end of list
+				m_points[m_n++] = n.m_points[i];
+		}
+		// average all points
+		for (i=xavg=yavg=0; i<m_n; i++)
+		{
+			xavg += m_points[i].m_x;
+			yavg += m_points[i].m_y;
+		}
+		
+		m_pavg.m_x = (xavg+(m_n>>1))/m_n;
+		m_pavg.m_y = (yavg+(m_n>>1))/m_n;
+		
+	}
+
+	Point m_points[LINE_MAX_INTERSECTION_LINES];
+	Point m_pavg;
+	uint8_t m_n;
+	uint16_t m_dist;
+	SimpleListNode<Nadir> *m_lineNext; // next nadir with the same first line, only used while finding nadirs
+};
+
+
+struct Intersection;
+
+struct Line2
+{
+	Line2()
+	{
+		m_i0 = m_i1 = NULL;
+		m_tracker = NULL;
+		m_index = 0;
+	}
+
+	uint16_t length2() const
+	{
+		int16_t diffx, diffy;
+		
+		diffx = m_p1.m_x - m_p0.m_x;
+		diffy = m_p1.m_y - m_p0.m_y;
+		
+		return diffx*diffx + diffy*diffy;
+	}
+
+	Point m_p0;
+	Point m_p1;
+	uint8_t m_index;
+	SimpleListNode<Intersection> *m_i0;
+	SimpleListNode<Intersection> *m_i1;
+	Tracker<Line2> *m_tracker;
+};
+
+
+struct Intersection
+{
+	Intersection()
+	{
+	}
+
+	Intersection(const Point &p)
+	{
+		m_p = p;
+	}
+	
+	bool addLine(SimpleListNode<Line2> *linen, SimpleListNode<Intersection> *intern, uint8_t pi)
+	{
+		uint8_t i;
+		
+		if (linen==NULL || intern==NULL || m_n>=LINE_MAX_INTERSECTION_LINES)
+			return false;
+		for (i=0; i<m_n; i++)
+		{
+			if (m_lines[i]==linen)
+				return false;
+		}
+		m_lines[m_n++] = linen;
+		if (pi==0)
+			linen->m_object.m_i0 = intern;
+		else
+			linen->m_object.m_i1 = intern;
+		return true;
+	}
+	
+	Point m_p; 
+	uint8_t m_n;
+	SimpleListNode<Line2> *m_lines[LINE_MAX_INTERSECTION_LINES];
+};
+
+struct FrameIntersectionLine
+{
+	uint8_t m_index;
+	uint8_t m_reserved;
+	int16_t m_angle;
+};
+
+struct FrameIntersection
+{
+	uint8_t m_x;
+	uint8_t m_y;
+	uint8_t m_n;
+	uint8_t m_reserved;
+	FrameIntersectionLine m_lines[LINE_MAX_FRAME_INTERSECTION_LINES];
+};
+
+struct FrameLine
+{
+	uint8_t m_x0;
+	uint8_t m_y0;
+	uint8_t m_x1;
+	uint8_t m_y1;
+	uint8_t m_index;
+	uint8_t m_flags;
+};
+
+struct FrameCode
+{
+	uint8_t m_x;
+	uint8_t m_y;
+	uint8_t m_flags;
+	uint8_t m_code;
+};
+
+struct FrameIndexedCode
+{
+	uint8_t m_x;
+	uint8_t m_y;
+	uint8_t m_flags;
+	uint8_t m_code;
+	uint8_t m_index;
+	uint8_t m_reserved;
+};
+
+struct FrameDelta
+{
+	uint16_t m_frame;
+	uint8_t m_flags;
+	uint8_t m_reserved;
+};
+
+struct FrameRemoved
+{
+	uint8_t m_type; // LINE_FR_VECTOR_LINES or LINE_FR_INDEXED_BARCODE
+	uint8_t m_index;
+};
+
+// processing stages of a frame, in order.  Each stage is bracketed by calls to the stage callback 
+// and its duration (in cycles) is recorded in m_stageCycles and m_profile. 
+enum LineStage
+{
+	LINE_STAGE_EDGES,            // edge lines -> grid and barcode candidates (addEdges)
+	LINE_STAGE_CODES,            // barcode clustering and voting
+	LINE_STAGE_BARCODE_TRACKING,
+	LINE_STAGE_SEGMENTS,         // line segment extraction from grid
+	LINE_STAGE_NADIRS,
+	LINE_STAGE_REDUCE_NADIRS,
+	LINE_STAGE_INTERSECTIONS,
+	LINE_STAGE_CLEAN,            // intersection cleanup and short line removal
+	LINE_STAGE_LINE_TRACKING,
+	LINE_STAGE_LINE_STATE,       // primary vector, intersection and turn handling
+	LINE_STAGES
+};
+
+#define LINE_STAGE_NAMES  "edges,codes,barcode tracking,segments,nadirs,reduce nadirs,intersections,clean,line tracking,line state"
+
+// Cycle statistics for one stage.  The histogram is log scale with 4 buckets per octave, so 
+// percentiles are accurate to about 20%, which is good enough to find where the time goes 
+// and costs no allocation. 
+struct LineStageProfile
+{
+	void reset();
+	void add(uint32_t cycles);
+	uint32_t mean() const;
+	uint32_t percentile(uint8_t pct) const;
+
+	uint32_t m_count;
+	uint32_t m_min;
+	uint32_t m_max;
+	uint64_t m_sum;
+	uint16_t m_hist[LINE_PROFILE_BUCKETS];
+};
+
+class LineEngine;
+
+// done is false before the stage runs and true after 
+typedef void (*LineStageCallback)(LineEngine *engine, uint8_t stage, bool done);
+
+struct LineParams
+{
+	LineParams()
+	{
+		m_edgeDist = LINE_EDGE_DIST_DEFAULT;
+		m_minLineWidth = LINE_MIN_WIDTH;
+		m_maxLineWidth = LINE_MAX_WIDTH;
+		m_extractionDist = LINE_EXTRACTION_DIST_DEFAULT;
+		m_maxMergeDist = LINE_MAX_MERGE_DIST;
+		m_minLineLength = LINE_MIN_LENGTH;
+		m_maxLineCompare = LINE_MAX_COMPARE;
+		m_whiteLine = 0;
+		m_lineFiltering = LINE_LINE_FILTERING;
+		m_intersectionFiltering = LINE_INTERSECTION_FILTERING;
+		m_barcodeFiltering = LINE_BARCODE_FILTERING;
+		m_defaultTurnAngle = 0;
+		m_delayedTurn = 0;
+		m_manualVectorSelect = 0;
+	}
+
+	uint16_t m_edgeDist; // must match the edge distance used to produce the edge stream
+	uint16_t m_minLineWidth;
+	uint16_t m_maxLineWidth;
+	uint16_t m_extractionDist;
+	uint16_t m_maxMergeDist;
+	uint16_t m_minLineLength;
+	uint32_t m_maxLineCompare;
+	uint8_t m_whiteLine;
+	uint8_t m_lineFiltering;
+	uint8_t m_intersectionFiltering;
+	uint8_t m_barcodeFiltering;
+	int16_t m_defaultTurnAngle;
+	uint8_t m_delayedTurn;
+	uint8_t m_manualVectorSelect;
+};
+
+// The line tracking algorithm.  It consumes an edge stream (lines of edges that begin with 
+// EQ_HSCAN_LINE_START or EQ_VSCAN_LINE_START, as produced by the M0) and produces lines, 
+// intersections and barcodes.  All state lives in the object, so there can be more than one 
+// engine, and the engine doesn't depend on the camera or Chirp, so it can run on the host 
+// against recorded edge streams. 
+class LineEngine
+{
+public:
+	// prebuf is the number of bytes reserved in front of the grid, line segment and barcode 
+	// buffers so they can be sent in place (e.g. CAM_PREBUF_LEN) 
+	LineEngine(uint16_t prebuf=0);
+	~LineEngine();
+
+	int open();
+	void close();
+	// call after changing m_params
+	void updateParams();
+	void setStageCallback(LineStageCallback callback);
+
+	// feed a frame one edge line at a time.  line[0] is the line code and line[len] must be 
+	// readable and >= EQ_HSCAN_LINE_START (the next line code or EQ_FRAME_END), as with 
+	// Equeue::readLine(). 
+	void beginFrame();
+	void addEdges(const uint16_t *line, uint32_t len);
+	int endFrame(bool error=false);
+	// process a whole frame from a contiguous edge stream ending with EQ_FRAME_END
+	int processFrame(const uint16_t *edges, uint32_t len, uint32_t *consumed=NULL);
+
+	int getPrimaryFrame(uint8_t typeMap, uint8_t *buf, uint16_t len);
+	int getAllFrame(uint8_t typeMap, uint8_t *buf, uint16_t len);
+	// Like getAllFrame(), but only the lines and barcodes that were added, removed or changed 
+	// (keyed by tracker index) and the intersections if they changed, relative to frame ack, 
+	// the number of the last delta response the client applied.  If ack isn't that frame 
+	// (e.g. 0 to ask for a resync) the response holds everything, flagged LINE_FR_DELTA_FULL.  
+	int getDeltaFrame(uint8_t typeMap, uint16_t ack, uint8_t *buf, uint16_t len);
+	void legoLineData(uint8_t *buf);
+	bool getPrimaryVector(Point *p0, Point *p1, uint8_t *n);
+
+	void setMode(int8_t modeMap);
+	void setNextTurnAngle(int16_t angle);
+	void setDefaultTurnAngle(int16_t angle);
+	void setVector(uint8_t index);
+	int reversePrimary();
+
+	void printPoolStats();
+	// expands the grid bitmaps into m_lineGrid (one LineGridNode per node) for debugging
+	void renderGrid();
+	void resetProfile();
+	// fills stats with LINE_PROFILE_STATS values per stage, in cycles
+	void getProfile(uint32_t *stats);
+
+	LineParams m_params;
+	uint8_t m_debug;
+	uint32_t m_stageCycles[LINE_STAGES]; // most recent frame
+	LineStageProfile m_profile[LINE_STAGES];
+
+	// frame data, read-only outside of the engine
+	LineGridNode *m_lineGrid; // line index of each node, only valid where m_gridLabel is set
+	uint8_t *m_lineGridMem;
+	uint32_t m_gridHLine[LINE_GRID_MAP_WORDS];
+	uint32_t m_gridVLine[LINE_GRID_MAP_WORDS];
+	uint32_t m_gridOpen[LINE_GRID_MAP_WORDS]; // line nodes not yet consumed by segment extraction
+	uint32_t m_gridLabel[LINE_GRID_MAP_WORDS]; // nodes with a line index
+	LineSeg *m_lineSegs;
+	uint8_t *m_lineSegsMem;
+	LineSegIndex m_lineSegIndex;
+	DecodedBarCode *m_votedBarcodes;
+	uint8_t *m_votedBarcodesMem;
+	uint8_t m_votedBarcodeIndex;
+
+	SimpleList<Line2> m_linesList;
+	SimpleList<Point> m_nodesList;
+	SimpleList<Nadir> m_nadirsList;
+	SimpleList<Intersection> m_intersectionsList;
+	SimpleList<Tracker<Line2> > m_lineTrackersList;
+	SimpleList<Tracker<DecodedBarCode> > m_barCodeTrackersList;
+
+private:
+	void beginStage(uint8_t stage);
+	void endStage(uint8_t stage);
+
+	int hLine(uint8_t row, const uint16_t *buf, uint32_t len);
+	int vLine(uint8_t row, uint8_t *vstate, const uint16_t *buf, uint32_t len);
+	void cleanGrid(Point ps[], uint8_t points);
+	int addline(const Point &p0, const Point &p1);
+	LineSegIndex finishGridNode(Point ps[], uint8_t points, LineSegIndex prevSeg, Point &p0);
+	bool ydirUp(Point &p, uint8_t &points, Point ps[]);
+	bool xdirLeft(Point &p, uint8_t &points, Point ps[]);
+	bool xdirRight(Point &p, uint8_t &points, Point ps[]);
+	void extractLineSegments(const Point &p);
+	void extractLineSegments();
+	void addNadir(const Point &p0, const Point &p1);
+	void search(const Point &p, uint8_t radius);
+	void findNadirs();
+	void reduceNadirs();
+	void addLine(SimpleListNode<Nadir> *nadirs, uint8_t li0, const Point &p01, SimpleListNode<Line2> *linen1);
+	bool breakLine(SimpleListNode<Nadir> *nadirs, uint8_t li, SimpleListNode<Intersection> *intern);
+	uint8_t removeLine(SimpleListNode<Line2> *linen, SimpleListNode<Intersection> *intern);
+	void removeLine(SimpleListNode<Line2> *linen);
+	void replaceLine(SimpleListNode<Line2> *linen, SimpleListNode<Line2> *linenx);
+	void formIntersections();
+	bool validIntersection(SimpleListNode<Intersection> *intern);
+	bool validLine(SimpleListNode<Line2> *linen);
+	bool checkGraph(int val, uint8_t suppress0=0, uint8_t suppress1=0, SimpleListNode<Intersection> *intern=NULL);
+	uint16_t removeShortLinesIntersections();
+	uint16_t removeRedundantLinesIntersections();
+	uint16_t simplifyIntersections();
+	void cleanIntersections();
+	void removeMinLines(uint16_t minLineLength);
+	int16_t voteCodes(BarCodeCluster *cluster);
+	void clusterCode(const BarCode *bc);
+	void clusterCodes();
+	void detectCodes(uint8_t row, const uint16_t *edges, uint32_t len);
+	void clearGrid(const RectB rect);
+	void clearGrid();
+	void buildGraph();
+	void setGridNode(uint32_t *map, uint8_t x, uint8_t y)
+	{
+		LINE_GRID_SET(map, x, y);
+		LINE_GRID_SET(m_gridOpen, x, y);
+	}
+	void setGridLine(const Point &p, uint16_t index)
+	{
+		m_lineGrid[LINE_GRID_INDEX_P(p)] = index;
+		LINE_GRID_SET(m_gridLabel, p.m_x, p.m_y);
+	}
+	uint32_t compareLines(const Line2 &line0, const Line2 &line1);
+	void indexTrackingLines();
+	Line2 *findTrackingLine(Tracker<Line2> *tracker, bool priority, uint32_t *min);
+	uint16_t handleLineTracking2();
+	void handleLineTracking();
+	uint16_t handleBarCodeTracking2();
+	void handleBarCodeTracking();
+	Line2 *findLine(uint8_t index);
+	Line2 *findTrackedLine(uint8_t index);
+	uint8_t trackedLinesWithPoint(const Point &p);
+	uint8_t updatePrimaryIntersection(SimpleListNode<Intersection> *intern);
+	void updatePrimaryPoint(const Line2 &primary);
+	int intersectionTurn();
+	void setPrimaryVector(uint8_t index);
+	void handleLineState();
+	void resetDelta();
+
+	uint16_t m_prebuf;
+	LineStageCallback m_stageCallback;
+	uint32_t m_stageTimer; // cycles
+	uint32_t m_frame;
+	int8_t m_row;
+	uint8_t m_vstate[LINE_VSIZE];
+
+	uint32_t m_minLineLength2; // squared
+	uint8_t m_pointsPerSeg;
+	float m_maxError;
+	uint8_t m_lineIndex;
+	SimpleListNode<Line2> **m_lines;
+	uint32_t m_maxSegTanAngle;
+	uint32_t m_maxEquivTanAngle;
+	uint32_t m_maxTrackingTanAngle;
+	uint16_t m_trackRadius; // grid nodes, the farthest an endpoint can move and still match (m_maxLineCompare)
+	// Endpoints by cell.  findNadirs() indexes m_nodesList (entry is the node's position) and line tracking 
+	// indexes m_linesList (entry>>1 is the line's position).  
+	uint16_t m_cells[LINE_CELLS_WIDTH*LINE_CELLS_HEIGHT]; // first entry in each cell
+	uint16_t m_cellNext[LINE_MAX_LINES*2]; // next entry in the same cell
+	Point m_nodePoints[LINE_MAX_LINES*2];
+	uint8_t m_nodeLines[LINE_MAX_LINES*2];
+	Line2 *m_trackLines[LINE_MAX_LINES];
+	SimpleListNode<Nadir> *m_nadirLines[LINE_MAX_LINES]; // nadirs by their first line, see Nadir::m_lineNext
+
+	// node pools, so the per-frame lists don't hit the heap
+	SimpleListPool<Line2> m_linesPool;
+	SimpleListPool<Point> m_nodesPool;
+	SimpleListPool<Nadir> m_nadirsPool;
+	SimpleListPool<Intersection> m_intersectionsPool;
+	SimpleListPool<Tracker<Line2> > m_lineTrackersPool;
+	SimpleListPool<Tracker<DecodedBarCode> > m_barCodeTrackersPool;
+
+	uint8_t m_barcodeIndex; // candidates this frame
+	BarCode m_barcode; // candidate being detected
+	BarCodeCluster m_barcodeClusters[LINE_MMC_VOTED_BARCODES];
+	uint8_t m_barcodeClusterIndex;
+	uint16_t m_maxCodeDist;
+	uint16_t m_minVotingThreshold;
+
+	Tracker<FrameIntersection> m_primaryIntersection;
+	bool m_newIntersection;
+
+	// what the client of getDeltaFrame() has as of m_deltaFrame
+	uint16_t m_deltaFrame;
+	uint8_t m_deltaTypeMap;
+	FrameLine m_deltaLines[LINE_DELTA_MAX_LINES];
+	uint8_t m_deltaLineCount;
+	FrameIndexedCode m_deltaCodes[LINE_DELTA_MAX_BARCODES];
+	uint8_t m_deltaCodeCount;
+	uint32_t m_deltaIntersectionHash;
+
+	uint8_t m_barCodeTrackerIndex;
+	uint8_t m_lineTrackerIndex;
+	uint8_t m_primaryLineIndex;
+	uint8_t m_primaryPointMap;
+	Point m_goalPoint;
+	Point m_primaryPoint;
+	bool m_primaryActive;
+
+	LineState m_lineState;
+
+	int16_t m_nextTurnAngle;
+	bool m_newTurnAngle;
+	bool m_manualVectorSelectActive;
+	uint8_t m_manualVectorSelectIndex;
+	bool m_reversePrimary;
+};
+
+#endif
@@ -17,6 +17,7 @@
 #define _PROGBLOBS_H
 
 #include "exec.h"
+#include "pixytypes.h"
 
 #define SYNC_SERVO                 0x00ff
 #define SYNC_CAM_BRIGHTNESS        0x00fe
@@ -27,6 +28,8 @@
 
 #define TYPE_REQUEST_GETBLOBS      0x20
 #define TYPE_RESPONSE_GETBLOBS     0x21
+#define TYPE_REQUEST_GETBLOBS_MOMENTS   0x22
+#define TYPE_RESPONSE_GETBLOBS_MOMENTS  0x23
 
 
 #define PROG_NAME_BLOBS            "color_connected_components"
@@ -83,11 +86,13 @@ private:
 	static void scaleLED(uint32_t r, uint32_t g, uint32_t b, uint32_t n);
 	static void ledPipe();
 	static void setSignature();
+	static bool getRegion(RectA *region);
+	static void sendRegion();
 
 
 	static uint8_t m_state;
 	static void handleRecv();
-	static void blobsAssemble(uint8_t sigmap, uint8_t n, bool checksum);
+	static void blobsAssemble(uint8_t sigmap, uint8_t n, bool checksum, bool moments=false);
 	static const char *m_views[];
 	static const ActionScriptlet m_actions[];
 
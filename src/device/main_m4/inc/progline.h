@@ -31,6 +31,7 @@
 
 #define GET_PRIMARY_FEATURES                     0x00
 #define GET_ALL_FEATURES                         0x01
+#define GET_ALL_FEATURES_DELTA                   0x02 // followed by the uint16 frame number the client last applied
 
 #define PROG_NAME_LINE               "line_tracking"
 
@@ -48,7 +49,7 @@ public:
 
 private:
 	static const char *m_views[];	
-	void sendLineData(uint8_t requestType, uint8_t typeMap, bool checksum);
+	void sendLineData(uint8_t requestType, uint8_t typeMap, uint16_t ack, bool checksum);
 };
 
 
@@ -24,9 +24,53 @@
 #define PROG_VIDEO_MAX_TYPE     0x7f
 
 #define TYPE_REQUEST_GETRGB   0x70
+#define TYPE_REQUEST_GETRGBS  0x72
+#define TYPE_RESPONSE_GETRGBS 0x73
 
 #define VIDEO_RGB_SIZE    2
 
+#define VIDEO_VIEW_RAW              0
+#define VIDEO_VIEW_TILES            1
+
+// "changed tiles" view, the frame is sent as 16x16 tiles, only the tiles that have changed
+#define VIDEO_TILE_SIZE             16
+#define VIDEO_TILE_COLS             ((CAM_RES2_WIDTH+VIDEO_TILE_SIZE-1)/VIDEO_TILE_SIZE)
+#define VIDEO_TILE_ROWS             ((CAM_RES2_HEIGHT+VIDEO_TILE_SIZE-1)/VIDEO_TILE_SIZE)
+#define VIDEO_TILES                 (VIDEO_TILE_COLS*VIDEO_TILE_ROWS)
+// the frame goes out a band (row of tiles) at a time, the packed tiles, then a map of the band
+#define VIDEO_TILE_BAND_MAP_LEN     ((VIDEO_TILE_COLS+7)/8)
+#define VIDEO_TILE_HEADER_LEN       40 // CAM_FRAME_HEADER_LEN plus the band's row (uint16)
+#define VIDEO_TILE_BAND_LEN         (VIDEO_TILE_HEADER_LEN+VIDEO_TILE_SIZE*CAM_RES2_WIDTH+VIDEO_TILE_BAND_MAP_LEN)
+// a tile's signature is the means of its 4x4 pixel cells
+#define VIDEO_TILE_CELL_SIZE        4
+#define VIDEO_TILE_CELLS            ((VIDEO_TILE_SIZE/VIDEO_TILE_CELL_SIZE)*(VIDEO_TILE_SIZE/VIDEO_TILE_CELL_SIZE))
+
+#define VIDEO_TILE_THRESH_DEFAULT   6
+#define VIDEO_TILE_KEYFRAME_DEFAULT 30
+
+// Batch RGB request: a flags byte, then x (uint16), y (uint16) and size (uint8) for each patch.
+// The response is r, g, b (bytes) for each patch, the average over x-size..x+size, y-size..y+size.
+#define VIDEO_RGBS_FLAG_SATURATE    0x01
+#define VIDEO_RGBS_PATCH_LEN        5
+#define VIDEO_RGBS_MAX              50 // (SER_MAXLEN-1)/VIDEO_RGBS_PATCH_LEN
+#define VIDEO_RGBS_REQUEST_LEN      (1+VIDEO_RGBS_MAX*VIDEO_RGBS_PATCH_LEN)
+// The serial interrupt only records a batch request, loop() answers it from the next frame while
+// the stream is paused.  Until then the client is told it's busy and asks again.
+#define VIDEO_RGBS_IDLE             0
+#define VIDEO_RGBS_PENDING          1 // recorded, waiting for loop()
+#define VIDEO_RGBS_ANSWERING        2 // loop() is working on it
+#define VIDEO_RGBS_READY            3 // the answer is in m_rgbsResult
+
+// Summed-area tables (one per channel) for the batch RGB request, sampled every VIDEO_SAT_CELL
+// pixels.  They cover the whole cells of a patch, the partial cells at its edges are summed from 
+// the pixels.  They're only built when the patches of a request add up to more pixels than the 
+// frame.  They're kept in the blob queue's memory, which the video program doesn't use. 
+#define VIDEO_SAT_CELL              8
+#define VIDEO_SAT_COLS              ((CAM_RES2_WIDTH+VIDEO_SAT_CELL-1)/VIDEO_SAT_CELL+1)
+#define VIDEO_SAT_ROWS              ((CAM_RES2_HEIGHT+VIDEO_SAT_CELL-1)/VIDEO_SAT_CELL+1)
+#define VIDEO_SAT_SIZE              (VIDEO_SAT_COLS*VIDEO_SAT_ROWS)
+#define VIDEO_SAT_MEMORY            ((uint32_t *)QQ_LOC) // 3*VIDEO_SAT_SIZE*4 bytes, less than QQ_SIZE
+
 class ProgVideo : public Prog
 {
 public:
@@ -34,11 +78,25 @@ public:
 	virtual ~ProgVideo();
 	
 	virtual int loop(char *status);
+	virtual int getView(uint16_t index, const char **name);
+	virtual int setView(uint16_t index);
 
 	virtual int packet(uint8_t type, const uint8_t *data, uint8_t len, bool checksum);
 
 private:
 	void sendCustom(uint8_t renderFlags=RENDER_FLAG_FLUSH);
+	void sendTiles();
+	void buildSat();
+	void answerRGBs();
+	int sendRGBs(const uint8_t *data, uint8_t len, bool checksum);
+
+	uint8_t *m_signatures;
+	uint8_t *m_band;
+	uint16_t m_keyframeCount;
+	volatile uint8_t m_rgbsState;
+	uint8_t m_rgbsRequest[VIDEO_RGBS_REQUEST_LEN];
+	uint8_t m_rgbsLen;
+	uint8_t m_rgbsResult[VIDEO_RGBS_MAX*3];
 
 };
 
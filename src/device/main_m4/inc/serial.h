@@ -61,6 +61,8 @@
 #define SER_TYPE_REQUEST_LED          0x14
 #define SER_TYPE_REQUEST_LAMP         0x16
 #define SER_TYPE_REQUEST_FPS          0x18
+#define SER_TYPE_REQUEST_SUBSCRIBE    0x1a
+#define SER_TYPE_RESPONSE_PUSH        0x1b
 #define SER_TYPE_REQUEST_NO_PROG_MAX  0x1f
 
 // error codes
@@ -71,6 +73,14 @@
 #define SER_ERROR_BUTTON_OVERRIDE     -5
 #define SER_ERROR_PROG_CHANGING       -6
 
+// Subscriptions.  The client sends a program request (e.g. get blocks) once in a subscribe request 
+// and the response to it is pushed after every frame, wrapped in a push response with a sequence 
+// number (SER_PUSH_HEADER_SIZE bytes: uint16 sequence, response type).  Only UART and SPI with SS. 
+#define SER_SUBSCRIBE_FLAG_PULSE      0x01 // pulse the SS pin (I/O connector pin 7) after each push, UART only
+#define SER_SUBSCRIBE_MAX_LEN         8    // request data
+#define SER_PUSH_HEADER_SIZE          3
+#define SER_PUSH_PULSE_US             10
+
 int ser_init(Chirp *chirp);
 int32_t ser_packetChirp(const uint8_t &type, const uint32_t &len, const uint8_t *request, Chirp *chirp=NULL);
 int ser_setInterface(uint8_t interface);
@@ -85,6 +95,7 @@ bool ser_newPacket();
 void ser_rxCallback();
 void ser_update();
 void ser_setReady();
+void ser_push();
 
 Iserial *ser_getSerial();
 
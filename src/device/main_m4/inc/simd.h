@@ -0,0 +1,101 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+#ifndef _SIMD_H
+#define _SIMD_H
+
+#include <stdint.h>
+#include <string.h>
+
+// The M4's packed 16-bit SIMD instructions, and CLZ.  On the M4 these are the CMSIS intrinsics
+// (core_cm4_simd.h, core_cmInstr.h).  On the host (__LINUX__) they are emulated in C with the
+// same results, so code written with them can be built and checked bit-for-bit against a scalar
+// version.  Only the intrinsics the JPEG encoder uses are emulated.
+
+#ifdef __LINUX__
+
+static inline uint32_t __SADD16(uint32_t op1, uint32_t op2)
+{
+	return (uint16_t)((int16_t)op1 + (int16_t)op2) | (uint32_t)(uint16_t)((int16_t)(op1>>16) + (int16_t)(op2>>16))<<16;
+}
+
+static inline uint32_t __SSUB16(uint32_t op1, uint32_t op2)
+{
+	return (uint16_t)((int16_t)op1 - (int16_t)op2) | (uint32_t)(uint16_t)((int16_t)(op1>>16) - (int16_t)(op2>>16))<<16;
+}
+
+static inline uint32_t __UADD16(uint32_t op1, uint32_t op2)
+{
+	return (uint16_t)((op1&0xffff) + (op2&0xffff)) | (uint32_t)(uint16_t)((op1>>16) + (op2>>16))<<16;
+}
+
+static inline uint32_t __UHADD16(uint32_t op1, uint32_t op2)
+{
+	return ((op1&0xffff) + (op2&0xffff))>>1 | (((op1>>16) + (op2>>16))>>1)<<16;
+}
+
+static inline uint32_t __UXTB16(uint32_t op1)
+{
+	return op1&0x00ff00ff;
+}
+
+static inline uint32_t __SMUAD(uint32_t op1, uint32_t op2)
+{
+	return (int32_t)(int16_t)op1*(int16_t)op2 + (int32_t)(int16_t)(op1>>16)*(int16_t)(op2>>16);
+}
+
+static inline uint32_t __SMUSD(uint32_t op1, uint32_t op2)
+{
+	return (int32_t)(int16_t)op1*(int16_t)op2 - (int32_t)(int16_t)(op1>>16)*(int16_t)(op2>>16);
+}
+
+static inline uint32_t __SMLAD(uint32_t op1, uint32_t op2, uint32_t op3)
+{
+	return __SMUAD(op1, op2) + op3;
+}
+
+#define __PKHBT(ARG1, ARG2, ARG3)  ((((uint32_t)(ARG1)) & 0x0000ffff) | ((((uint32_t)(ARG2)) << (ARG3)) & 0xffff0000))
+#define __PKHTB(ARG1, ARG2, ARG3)  ((((uint32_t)(ARG1)) & 0xffff0000) | ((((uint32_t)(ARG2)) >> (ARG3)) & 0x0000ffff))
+
+static inline uint8_t __CLZ(uint32_t value)
+{
+	return value ? __builtin_clz(value) : 32;
+}
+
+#else
+
+#include "lpc43xx.h"
+
+#endif
+
+// two signed halfwords, lo in the bottom half, e.g. a pair of coefficients for __SMLAD
+#define PACK16(lo, hi)  ((uint32_t)(uint16_t)(lo) | (uint32_t)(uint16_t)(hi)<<16)
+
+static inline uint32_t ror32(uint32_t val, uint8_t n)
+{
+	return (val>>n) | (val<<(32-n));
+}
+
+// Load 2 halfwords or 4 bytes as one word.  The M4 allows unaligned word loads, and the memcpy
+// compiles to a single LDR.
+static inline uint32_t load32(const void *p)
+{
+	uint32_t val;
+
+	memcpy(&val, p, 4);
+	return val;
+}
+
+#endif
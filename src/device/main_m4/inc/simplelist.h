@@ -20,13 +20,101 @@
 
 template <typename Object> class SimpleListNode;
 
+// Fixed-capacity node pool.  Nodes are handed out from a single preallocated array, 
+// so a list that uses a pool never touches the heap after allocate() is called.  A pool 
+// should only serve a single list, because SimpleList::clear() resets the whole pool at once.
+template <typename Object> class SimpleListPool
+{
+	public:
+	SimpleListPool()
+	{
+		m_nodes = NULL;
+		m_capacity = 0;
+		m_highWater = 0;
+		m_exhausted = 0;
+		reset();
+	}
+	~SimpleListPool()
+	{
+		deallocate();
+	}
+	
+	int allocate(uint16_t capacity)
+	{
+		deallocate();
+		m_nodes = new (std::nothrow) SimpleListNode<Object>[capacity];
+		if (m_nodes==NULL)
+			return -1;
+		m_capacity = capacity;
+		m_highWater = 0;
+		m_exhausted = 0;
+		reset();
+		return 0;
+	}
+	
+	void deallocate()
+	{
+		if (m_nodes)
+			delete [] m_nodes;
+		m_nodes = NULL;
+		m_capacity = 0;
+		reset();
+	}
+	
+	SimpleListNode<Object> *alloc()
+	{
+		SimpleListNode<Object> *node;
+		
+		if (m_free) // recycle removed nodes first
+		{
+			node = m_free;
+			m_free = node->m_next;
+		}
+		else if (m_index<m_capacity)
+			node = &m_nodes[m_index++];
+		else
+		{
+			m_exhausted++;
+			return NULL;
+		}
+		node->m_next = NULL;
+		if (++m_used>m_highWater)
+			m_highWater = m_used;
+		return node;
+	}
+	
+	void release(SimpleListNode<Object> *node)
+	{
+		node->m_next = m_free;
+		m_free = node;
+		m_used--;
+	}
+	
+	// O(1) -- all nodes become available again
+	void reset()
+	{
+		m_index = 0;
+		m_used = 0;
+		m_free = NULL;
+	}
+	
+	SimpleListNode<Object> *m_nodes;
+	SimpleListNode<Object> *m_free;
+	uint16_t m_capacity;
+	uint16_t m_index;
+	uint16_t m_used;
+	uint16_t m_highWater; // most nodes in use at once
+	uint32_t m_exhausted; // number of failed allocations
+};
+
 template <typename Object> class SimpleList
 {
 	public:
-	SimpleList()
+	SimpleList(SimpleListPool<Object> *pool=NULL)
 	{
 		m_first = m_last = NULL;
 		m_size = 0;
+		m_pool = pool;
 	}
 	~SimpleList()
 	{
@@ -37,20 +125,34 @@ template <typename Object> class SimpleList
 	{
 		SimpleListNode<Object> *n, *temp;
 
-		n = m_first;
-		while(n)
+		if (m_pool)
+			m_pool->reset();
+		else
 		{
-			temp = n->m_next;
-			delete n;
-			n = temp;
+			n = m_first;
+			while(n)
+			{
+				temp = n->m_next;
+				delete n;
+				n = temp;
+			}
 		}
 		m_first = m_last = NULL;
 		m_size = 0;
 	}
 	
+	// allocate a node that can be added to this list with add(node)
+	SimpleListNode<Object> *newNode()
+	{
+		if (m_pool)
+			return m_pool->alloc();
+		else
+			return new (std::nothrow) SimpleListNode<Object>;
+	}
+	
 	SimpleListNode<Object> *add(const Object &object)
 	{
-		SimpleListNode<Object> *node = new (std::nothrow) SimpleListNode<Object>;
+		SimpleListNode<Object> *node = newNode();
 
 		if (node==NULL)
 			return NULL;
@@ -86,7 +188,10 @@ template <typename Object> class SimpleList
 					m_last = nprev;
 				if (nprev)
 					nprev->m_next = n->m_next;
-				delete n;
+				if (m_pool)
+					m_pool->release(n);
+				else
+					delete n;
 				result = true;
 				m_size--;
 				break;
@@ -97,6 +202,7 @@ template <typename Object> class SimpleList
 		return result;
 	}
 	
+	// Note, both lists need to allocate their nodes the same way (same pool, or both from the heap)
 	void merge(SimpleList<Object> *list)
 	{
 		if (list && list->m_first)
@@ -115,6 +221,7 @@ template <typename Object> class SimpleList
 	SimpleListNode<Object> *m_first;
 	SimpleListNode<Object> *m_last;
 	uint16_t m_size;
+	SimpleListPool<Object> *m_pool;
 };
 
 template <typename Object> class SimpleListNode
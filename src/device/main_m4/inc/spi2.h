@@ -19,7 +19,7 @@
 #include "lpc43xx_ssp.h"
 #include "iserial.h"
 
-#define SPI2_RECEIVEBUF_SIZE   	64
+#define SPI2_RECEIVEBUF_SIZE   	256 // room for a whole packet's data (SER_MAXLEN)
 
 #define SS_ASSERT()  			LPC_SGPIO->GPIO_OUTREG = 0;
 #define SS_NEGATE() 			LPC_SGPIO->GPIO_OUTREG = 1<<14;
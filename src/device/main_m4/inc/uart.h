@@ -19,7 +19,7 @@
 #include "lpc43xx_uart.h"
 
 #define UART_TRANSMIT_BUF_SIZE     32
-#define UART_RECEIVE_BUF_SIZE      64
+#define UART_RECEIVE_BUF_SIZE      256 // room for a whole packet's data (SER_MAXLEN)
 #define UART_DEFAULT_BAUDRATE      19200
 
 class Uart : public Iserial
@@ -35,6 +35,10 @@ Qqueue *g_qqueue = NULL;
 Blobs *g_blobs = NULL;
 uint16_t g_ledBrightness;
 bool g_ledOverride = false;
+uint16_t g_regionPadding;
+uint8_t g_regionIndex;
+uint8_t g_regionRes;
+uint32_t g_regionBytes;
 
 
 static const ProcModule g_module[] =
@@ -168,6 +172,14 @@ void cc_shadowCallback(const char *id, const void *val)
 		g_blobs->setBlobFiltering(*(uint8_t *)val);
 	else if (strcmp(id, "Max tracking velocity")==0)
 		g_blobs->setMaxBlobVelocity(*(uint16_t *)val);	
+	else if (strcmp(id, "Region video padding")==0)
+		g_regionPadding = *(uint16_t *)val;
+	else if (strcmp(id, "Region video index")==0)
+		g_regionIndex = *(uint8_t *)val;
+	else if (strcmp(id, "Region video resolution")==0)
+		g_regionRes = *(uint8_t *)val;
+	else if (strcmp(id, "Region video bytes")==0)
+		g_regionBytes = *(uint32_t *)val;
 }
 
 
@@ -238,6 +250,19 @@ void cc_loadParams(void)
 		"@c Expert @m 10 @M 320 Sets the maximum velocity a block can be tracked in pixels-per-second (default " STRINGIFY(BL_MAX_TRACKING_DIST) ")", INT16(BL_MAX_TRACKING_DIST), END);
 	prm_setShadowCallback("Max tracking velocity", (ShadowCallback)cc_shadowCallback);
 
+	prm_add("Region video padding", progFlags | PRM_FLAG_SLIDER, PRM_PRIORITY_4+3,
+		"@c Expert @m 0 @M 100 Sets the number of pixels around the tracked blocks that are included in the \"tracked region video\" view (default " STRINGIFY(REGION_DEFAULT_PADDING) ")", UINT16(REGION_DEFAULT_PADDING), END);
+	prm_setShadowCallback("Region video padding", (ShadowCallback)cc_shadowCallback);
+	prm_add("Region video index", progFlags, PRM_PRIORITY_4+3,
+		"@c Expert Sets the tracking index of the block followed by the \"tracked region video\" view, or 0 to follow all tracked blocks (default 0)", UINT8(0), END);
+	prm_setShadowCallback("Region video index", (ShadowCallback)cc_shadowCallback);
+	prm_add("Region video resolution", progFlags, PRM_PRIORITY_4+3,
+		"@c Expert @s 2=Standard @s 1=High Sets the resolution of the \"tracked region video\" view, standard (316x208) or high (640x400).  High resolution shows more detail, but the region is grabbed separately, which lowers the block frame rate (default Standard)", UINT8(CAM_RES2), END);
+	prm_setShadowCallback("Region video resolution", (ShadowCallback)cc_shadowCallback);
+	prm_add("Region video bytes", progFlags | PRM_FLAG_SLIDER, PRM_PRIORITY_4+3,
+		"@c Expert @m 1024 @M " STRINGIFY(REGION_MAX_BYTES) " Sets the largest region sent by the \"tracked region video\" view, in pixels.  Larger regions are shrunk about their center (default " STRINGIFY(REGION_DEFAULT_BYTES) ")", UINT32(REGION_DEFAULT_BYTES), END);
+	prm_setShadowCallback("Region video bytes", (ShadowCallback)cc_shadowCallback);
+
 	// load
 	uint8_t ccMode, filtering;
 	uint16_t maxBlobs, maxBlobsPerModel, maxVel, mergeDist;
@@ -254,6 +279,10 @@ void cc_loadParams(void)
 	prm_get("LED brightness", &g_ledBrightness, END);
 	prm_get("Block filtering", &filtering, END);
 	prm_get("Max tracking velocity", &maxVel, END);
+	prm_get("Region video padding", &g_regionPadding, END);
+	prm_get("Region video index", &g_regionIndex, END);
+	prm_get("Region video resolution", &g_regionRes, END);
+	prm_get("Region video bytes", &g_regionBytes, END);
 	
 	g_blobs->setMaxBlobs(maxBlobs);
 	g_blobs->setMaxBlobsPerModel(maxBlobsPerModel);
@@ -1,6 +1,56 @@
 #include "globals.h"
+#include "simd.h"
 #include "dct.h"
 
+// Ci = cos(i*PI/16)*(1 << 14), paired up for the dual 16-bit MACs (__SMUAD, __SMLAD, __SMUSD)
+#define C1 16070
+#define C2 15137
+#define C3 13623
+#define C4 11586
+#define C5 9103
+#define C6 6270
+#define C7 3197
+
+/**
+ * @brief One 8-point pass of the DCT, with the multiplications done as 12 dual 16-bit MACs.  The 8 inputs
+ *  are read as 4 halfword pairs and the sums and differences of the butterflies are done 2 at a
+ *  time, so the results are the same as with 16-bit shorts and 32-bit products.
+ *  @param  in    - 8 values, the row (or transposed column) to transform;
+ *  @param  out   - where the 8 frequencies go, 8 shorts apart, i.e. down a column of an 8x8 block;
+ *  @param  shift - scaling of the products;
+ *  @return       - Nothing
+ */
+static inline void dct8(const short in[8], short *out, unsigned shift)
+    {
+    uint32_t p01, p23, p54, p76;
+    uint32_t s0716, d0716, s2534, d2534, s3425, e, d;
+
+    p01 = load32(in);
+    p23 = load32(in + 2);
+    p54 = ror32(load32(in + 4), 16); // (p5, p4)
+    p76 = ror32(load32(in + 6), 16); // (p7, p6)
+
+    s0716 = __SADD16(p01, p76); // (s07, s16)
+    d0716 = __SSUB16(p01, p76); // (d07, d16)
+    s2534 = __SADD16(p23, p54); // (s25, s34)
+    d2534 = __SSUB16(p23, p54); // (d25, d34)
+
+    out[8*1] = (int32_t)__SMLAD(d0716, PACK16(C1, C3), __SMUAD(d2534, PACK16(C5, C7))) >> shift;
+    out[8*3] = (int32_t)__SMLAD(d0716, PACK16(C3, -C7), __SMUAD(d2534, PACK16(-C1, -C5))) >> shift;
+    out[8*5] = (int32_t)__SMLAD(d0716, PACK16(C5, -C1), __SMUAD(d2534, PACK16(C7, C3))) >> shift;
+    out[8*7] = (int32_t)__SMLAD(d0716, PACK16(C7, -C5), __SMUAD(d2534, PACK16(C3, -C1))) >> shift;
+
+    s3425 = ror32(s2534, 16);
+    e = __SADD16(s0716, s3425); // (s0734, s1625)
+    d = __SSUB16(s0716, s3425); // (d0734, d1625)
+
+    out[8*0] = (int32_t)__SMUAD(e, PACK16(C4, C4)) >> shift;
+    out[8*4] = (int32_t)__SMUSD(e, PACK16(C4, C4)) >> shift;
+
+    out[8*2] = (int32_t)__SMUAD(d, PACK16(C2, C6)) >> shift;
+    out[8*6] = (int32_t)__SMUSD(d, PACK16(C6, C2)) >> shift;
+    }
+
 /**
  * @brief Fast Discrete Cosine Transform converts 8x8 pixel block into frequencies. The lowest frequencies are at the upper-left corner.
  *  The input and output could point at the same array, in this case the data will be overwritten.
@@ -14,73 +64,13 @@ void dct(short pixels[8][8], short data[8][8])
     short rows[8][8];
     unsigned i;
 
-    static const short // Ci = cos(i*PI/16)*(1 << 14);
-    C1 = 16070, C2 = 15137, C3 = 13623, C4 = 11586, C5 = 9103, C6 = 6270, C7 =
-	    3197;
-
     // simple but fast DCT - 22*16 multiplication 28*16 additions and 8*16 shifts.
 
-    /* transform rows */
+    /* transform rows, storing them transposed, so the columns can be read in pairs too */
     for (i = 0; i < 8; i++)
-	{
-	short s07, s16, s25, s34, s0734, s1625;
-	short d07, d16, d25, d34, d0734, d1625;
-
-	s07 = pixels[i][0] + pixels[i][7];
-	d07 = pixels[i][0] - pixels[i][7];
-	s16 = pixels[i][1] + pixels[i][6];
-	d16 = pixels[i][1] - pixels[i][6];
-	s25 = pixels[i][2] + pixels[i][5];
-	d25 = pixels[i][2] - pixels[i][5];
-	s34 = pixels[i][3] + pixels[i][4];
-	d34 = pixels[i][3] - pixels[i][4];
-
-	rows[i][1] = (C1 * d07 + C3 * d16 + C5 * d25 + C7 * d34) >> 14;
-	rows[i][3] = (C3 * d07 - C7 * d16 - C1 * d25 - C5 * d34) >> 14;
-	rows[i][5] = (C5 * d07 - C1 * d16 + C7 * d25 + C3 * d34) >> 14;
-	rows[i][7] = (C7 * d07 - C5 * d16 + C3 * d25 - C1 * d34) >> 14;
-
-	s0734 = s07 + s34;
-	d0734 = s07 - s34;
-	s1625 = s16 + s25;
-	d1625 = s16 - s25;
-
-	rows[i][0] = (C4 * (s0734 + s1625)) >> 14;
-	rows[i][4] = (C4 * (s0734 - s1625)) >> 14;
-
-	rows[i][2] = (C2 * d0734 + C6 * d1625) >> 14;
-	rows[i][6] = (C6 * d0734 - C2 * d1625) >> 14;
-	}
+	dct8(pixels[i], &rows[0][i], 14);
 
     /* transform columns */
     for (i = 0; i < 8; i++)
-	{
-	short s07, s16, s25, s34, s0734, s1625;
-	short d07, d16, d25, d34, d0734, d1625;
-
-	s07 = rows[0][i] + rows[7][i];
-	d07 = rows[0][i] - rows[7][i];
-	s16 = rows[1][i] + rows[6][i];
-	d16 = rows[1][i] - rows[6][i];
-	s25 = rows[2][i] + rows[5][i];
-	d25 = rows[2][i] - rows[5][i];
-	s34 = rows[3][i] + rows[4][i];
-	d34 = rows[3][i] - rows[4][i];
-
-	data[1][i] = (C1 * d07 + C3 * d16 + C5 * d25 + C7 * d34) >> 16;
-	data[3][i] = (C3 * d07 - C7 * d16 - C1 * d25 - C5 * d34) >> 16;
-	data[5][i] = (C5 * d07 - C1 * d16 + C7 * d25 + C3 * d34) >> 16;
-	data[7][i] = (C7 * d07 - C5 * d16 + C3 * d25 - C1 * d34) >> 16;
-
-	s0734 = s07 + s34;
-	d0734 = s07 - s34;
-	s1625 = s16 + s25;
-	d1625 = s16 - s25;
-
-	data[0][i] = (C4 * (s0734 + s1625)) >> 16;
-	data[4][i] = (C4 * (s0734 - s1625)) >> 16;
-
-	data[2][i] = (C2 * d0734 + C6 * d1625) >> 16;
-	data[6][i] = (C6 * d0734 - C2 * d1625) >> 16;
-	}
+	dct8(rows[i], &data[0][i], 16);
     }
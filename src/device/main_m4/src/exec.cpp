@@ -731,6 +731,8 @@ void exec_mainLoop()
 				exec_runProg(g_defaultProgram); // run default program
 				g_state = 0; // setup state
 			}
+			else
+				ser_push(); // send this frame's results to a subscribed serial client
 			break;
 
 		case 3:	// stop state
@@ -848,6 +850,14 @@ int exec_changeProg(uint8_t type)
 	return -1;
 }
 
+// unlike exec_changeProg(), this doesn't switch programs
+bool exec_progHandlesType(uint8_t type)
+{
+	if (g_prog==NULL || g_runningProgIndex>=ProgTableUtil::m_progTableIndex)
+		return false;
+	return ProgTableUtil::m_progTable[g_runningProgIndex].m_minType<=type && type<=ProgTableUtil::m_progTable[g_runningProgIndex].m_maxType;
+}
+
 void exec_progPacket(uint8_t type, const uint8_t *data, uint8_t len, bool checksum)
 {
 	// only valid when we're in the loop state, ie after we've already called
@@ -1,5 +1,6 @@
 #include <stddef.h>
 #include "globals.h"
+#include "simd.h"
 #include "jpegenc.h"
 
 /* tables from JPEG standard
@@ -32,13 +33,6 @@ const unsigned char qtable_std_chrom[64] =
 
 // As you can see I use Paint tables
 
-static unsigned char g_quality = 0;
-
-static unsigned char qtable_0_lum[64];
-static unsigned char qtable_0_chrom[64];
-static unsigned char qtable_lum[64];
-static unsigned char qtable_chrom[64];
-
 
 static const unsigned char qtable_0_lum0[64] =
 {
@@ -295,44 +289,72 @@ static const unsigned short HCACbits[16][12] =
 	{0x03fa, 0x7fc3, 0xFFF6, 0xFFF7, 0xFFF8, 0xFFF9, 0xFFFA, 0xFFFB, 0xFFFC, 0xFFFD, 0xFFFE, 0x0000}
 };
 
-huffman_t huffman_ctx[3] =
-{
-	{HYAClen, HYACbits, HYDClen, HYDCbits, qtable_lum,   0}, // Y
-	{HCAClen, HCACbits, HCDClen, HCDCbits, qtable_chrom, 0}, // Cb
-	{HCAClen, HCACbits, HCDClen, HCDCbits, qtable_chrom, 0}  // Cr
-};
-
-typedef struct bitbuffer_s
+typedef struct huffman_s
 {
-	unsigned buf;
-	unsigned n;
+	const unsigned char  (*haclen)[12];
+	const unsigned short (*hacbit)[12];
+	const unsigned char  *hdclen;
+	const unsigned short *hdcbit;
 }
-bitbuffer_t;
+huffman_t;
 
-static bitbuffer_t bitbuf;
+static const huffman_t huffman_tables[3] =
+{
+	{HYAClen, HYACbits, HYDClen, HYDCbits}, // Y
+	{HCAClen, HCACbits, HCDClen, HCDCbits}, // Cb
+	{HCAClen, HCACbits, HCDClen, HCDCbits}  // Cr
+};
 
-void setQuality(unsigned char quality)
+/**
+ * @brief Sets up an encoder context -- the quantization tables for the given quality and the 
+ *  restart interval.  The context holds all of the encoder's state, so several images, or 
+ *  several slices of one image, can be encoded at the same time, each with its own context.
+ *  @param ctx     - encoder context
+ *  @param quality - 1-100
+ *  @param restart - restart interval in MCUs (16x16 pixels), 0 for none
+ *  @return        - Nothing
+ */
+void jpeg_init(jpeg_t *ctx, unsigned char quality, unsigned short restart)
 {
-	if (quality!=g_quality)
+	unsigned char i;
+	unsigned short v;
+
+	for (i=0; i<64; i++)
 	{
-		unsigned char i;
-		unsigned short v;
-
-		for (i=0; i<64; i++)
-		{
-			v = (unsigned short)qtable_0_lum0[i]*100/quality;
-			if (v>0xff) 
-				v = 0xff;
-			qtable_0_lum[i] = v; 
-			v = qtable_0_chrom0[i]*100/quality;
-			if (v>0xff)
-				v = 0xff;
-			qtable_0_chrom[i] = v;
-			qtable_lum[i] = (unsigned short)((1<<QTAB_SCALE) + (qtable_0_lum[i]>>1))/qtable_0_lum[i];
-			qtable_chrom[i] = (unsigned short)((1<<QTAB_SCALE) + (qtable_0_chrom[i]>>1))/qtable_0_chrom[i];
-		}
-		g_quality = quality;
+		v = (unsigned short)qtable_0_lum0[i]*100/quality;
+		if (v>0xff) 
+			v = 0xff;
+		ctx->qtable_0_lum[i] = v; 
+		v = qtable_0_chrom0[i]*100/quality;
+		if (v>0xff)
+			v = 0xff;
+		ctx->qtable_0_chrom[i] = v;
+	}
+	for (i=0; i<64; i++)
+	{
+		ctx->qtable_lum[i] = (unsigned short)((1<<QTAB_SCALE) + (ctx->qtable_0_lum[zig[i]]>>1))/ctx->qtable_0_lum[zig[i]];
+		ctx->qtable_chrom[i] = (unsigned short)((1<<QTAB_SCALE) + (ctx->qtable_0_chrom[zig[i]]>>1))/ctx->qtable_0_chrom[zig[i]];
 	}
+	ctx->restart = restart;
+	ctx->out = NULL;
+	ctx->outSize = ctx->outIndex = 0;
+	ctx->overflow = 0;
+}
+
+/**
+ * @brief Sets where the encoder writes its output.  If the output doesn't fit, it's truncated and 
+ *  ctx->overflow is set.
+ *  @param ctx  - encoder context
+ *  @param out  - output buffer
+ *  @param size - size of the output buffer (bytes)
+ *  @return     - Nothing
+ */
+void jpeg_setOutput(jpeg_t *ctx, unsigned char *out, uint32_t size)
+{
+	ctx->out = out;
+	ctx->outSize = size;
+	ctx->outIndex = 0;
+	ctx->overflow = 0;
 }
 /**
  * @brief DCT coefficient quantization. To avoid division function uses quantization coefs amplified by 2^QTAB_SCALE
@@ -349,180 +371,222 @@ static short quantize(const short data, const unsigned short qt)
 }
 
 
-
-// code-stream output counter
-static unsigned jpgn = 0;
-// code-stream output buffer, adjust its size if you need
-static unsigned char jpgbuff[256];
-
 /**
- * @brief Writes byte into output buffer and flushes the buffer if it is full.
- * @param jpgbuff - Global output buffer
- * @param jpgn    - The buffer index
- * @return        - Nothing
+ * @brief Writes byte into output buffer, or drops it and sets overflow if the buffer is full.
+ * @param ctx - encoder context
+ * @param b   - the byte
+ * @return    - Nothing
  */
 
-static void writebyte(const unsigned char b)
+static void writebyte(jpeg_t *ctx, const unsigned char b)
 {
-	jpgbuff[jpgn++] = b;
+	if (ctx->outIndex == ctx->outSize) {
+		ctx->overflow = 1;
+		return;
+	}
+
+	ctx->out[ctx->outIndex++] = b;
+}
 
-	if (jpgn == sizeof(jpgbuff)) {
-		jpgn = 0;
-		write_jpeg(jpgbuff, sizeof(jpgbuff));
+/**
+ * @brief Writes a whole word of the bit-stream, most significant byte first, adding 0x00 after 
+ * each 0xFF byte.  0xFF bytes are rare, so the whole word is checked for them first -- ~w has a 
+ * zero byte wherever w has an 0xFF byte.
+ * @param ctx - encoder context
+ * @param w   - 4 bytes of the bit-stream
+ * @return    - Nothing
+ */
+static void writestream(jpeg_t *ctx, const uint32_t w)
+{
+	unsigned i;
+	unsigned char b;
+	unsigned char *out = ctx->out + ctx->outIndex;
+
+	if (((~w - 0x01010101) & w & 0x80808080) == 0 && ctx->outIndex + 4 <= ctx->outSize) {
+		out[0] = w >> 24;
+		out[1] = w >> 16;
+		out[2] = w >> 8;
+		out[3] = w;
+		ctx->outIndex += 4;
+	}
+	else {
+		for (i = 0; i < 32; i += 8) {
+			b = w >> (24 - i);
+			writebyte(ctx, b);
+			if (b == 0xFF)
+				writebyte(ctx, 0); // add 0x00 after 0xFF
+		}
 	}
 }
 
-static void writeword(const unsigned short w)
+static void writeword(jpeg_t *ctx, const unsigned short w)
 {
-	writebyte(w >> 8); writebyte(w);
+	writebyte(ctx, w >> 8); writebyte(ctx, w);
 }
 
-static void write_APP0info(void)
+static void write_APP0info(jpeg_t *ctx)
     {
-    writeword(0xFFE0); //marker
-    writeword(16);     //length
-    writebyte('J');
-    writebyte('F');
-    writebyte('I');
-    writebyte('F');
-    writebyte(0);
-    writebyte(1); //versionhi
-    writebyte(1); //versionlo
-    writebyte(0); //xyunits
-    writeword(1); //xdensity
-    writeword(1); //ydensity
-    writebyte(0); //thumbnwidth
-    writebyte(0); //thumbnheight
+    writeword(ctx, 0xFFE0); //marker
+    writeword(ctx, 16);     //length
+    writebyte(ctx, 'J');
+    writebyte(ctx, 'F');
+    writebyte(ctx, 'I');
+    writebyte(ctx, 'F');
+    writebyte(ctx, 0);
+    writebyte(ctx, 1); //versionhi
+    writebyte(ctx, 1); //versionlo
+    writebyte(ctx, 0); //xyunits
+    writeword(ctx, 1); //xdensity
+    writeword(ctx, 1); //ydensity
+    writebyte(ctx, 0); //thumbnwidth
+    writebyte(ctx, 0); //thumbnheight
     }
 
 // should set width and height before writing
-static void write_SOF0info(const short height, const short width)
-{
-	writeword(0xFFC0);	//marker
-	writeword(17);		//length
-	writebyte(8);		//precision
-	writeword(height);	//height
-	writeword(width);	//width
-	writebyte(3);		//nrofcomponents
-	writebyte(1);		//IdY
-	writebyte(0x22);	//HVY, 4:2:0 subsampling
-	writebyte(0);		//QTY
-	writebyte(2);		//IdCb
-	writebyte(0x11);	//HVCb
-	writebyte(1);		//QTCb
-	writebyte(3);		//IdCr
-	writebyte(0x11);	//HVCr
-	writebyte(1);		//QTCr
+static void write_SOF0info(jpeg_t *ctx, const short height, const short width)
+{
+	writeword(ctx, 0xFFC0);	//marker
+	writeword(ctx, 17);		//length
+	writebyte(ctx, 8);		//precision
+	writeword(ctx, height);	//height
+	writeword(ctx, width);	//width
+	writebyte(ctx, 3);		//nrofcomponents
+	writebyte(ctx, 1);		//IdY
+	writebyte(ctx, 0x22);	//HVY, 4:2:0 subsampling
+	writebyte(ctx, 0);		//QTY
+	writebyte(ctx, 2);		//IdCb
+	writebyte(ctx, 0x11);	//HVCb
+	writebyte(ctx, 1);		//QTCb
+	writebyte(ctx, 3);		//IdCr
+	writebyte(ctx, 0x11);	//HVCr
+	writebyte(ctx, 1);		//QTCr
 }
 
-static void write_SOSinfo(void)
-{
-	writeword(0xFFDA);	//marker
-	writeword(12);		//length
-	writebyte(3);		//nrofcomponents
-	writebyte(1);		//IdY
-	writebyte(0);		//HTY
-	writebyte(2);		//IdCb
-	writebyte(0x11);	//HTCb
-	writebyte(3);		//IdCr
-	writebyte(0x11);	//HTCr
-	writebyte(0);		//Ss
-	writebyte(0x3F);	//Se
-	writebyte(0);		//Bf
+static void write_SOSinfo(jpeg_t *ctx)
+{
+	writeword(ctx, 0xFFDA);	//marker
+	writeword(ctx, 12);		//length
+	writebyte(ctx, 3);		//nrofcomponents
+	writebyte(ctx, 1);		//IdY
+	writebyte(ctx, 0);		//HTY
+	writebyte(ctx, 2);		//IdCb
+	writebyte(ctx, 0x11);	//HTCb
+	writebyte(ctx, 3);		//IdCr
+	writebyte(ctx, 0x11);	//HTCr
+	writebyte(ctx, 0);		//Ss
+	writebyte(ctx, 0x3F);	//Se
+	writebyte(ctx, 0);		//Bf
 }
 
-static void write_DQTinfo(void)
+static void write_DQTinfo(jpeg_t *ctx)
 {
 	unsigned i;
 	
-	writeword(0xFFDB);
-	writeword(132);
-	writebyte(0);
+	writeword(ctx, 0xFFDB);
+	writeword(ctx, 132);
+	writebyte(ctx, 0);
 
 	for (i = 0; i < 64; i++) 
-		writebyte(((unsigned char*)qtable_0_lum)[zig[i]]); // zig-zag order
+		writebyte(ctx, ctx->qtable_0_lum[zig[i]]); // zig-zag order
 
-	writebyte(1);
+	writebyte(ctx, 1);
 
 	for (i = 0; i < 64; i++) 
-		writebyte(((unsigned char*)qtable_0_chrom)[zig[i]]); // zig-zag order
+		writebyte(ctx, ctx->qtable_0_chrom[zig[i]]); // zig-zag order
 }
 
-static void write_DHTinfo(void)
+static void write_DRIinfo(jpeg_t *ctx)
+{
+	writeword(ctx, 0xFFDD);			// marker
+	writeword(ctx, 4);				// length
+	writeword(ctx, ctx->restart);	// restart interval
+}
+
+static void write_DHTinfo(jpeg_t *ctx)
 {
 	unsigned i;
 	
-	writeword(0xFFC4); // marker
-	writeword(0x01A2); // length
+	writeword(ctx, 0xFFC4); // marker
+	writeword(ctx, 0x01A2); // length
 
-	writebyte(0); // HTYDCinfo
+	writebyte(ctx, 0); // HTYDCinfo
 	for (i = 0; i < 16; i++) 
-		writebyte(std_dc_luminance_nrcodes[i]);
+		writebyte(ctx, std_dc_luminance_nrcodes[i]);
 	for (i = 0; i < 12; i++) 
-		writebyte(std_dc_luminance_values[i]);
+		writebyte(ctx, std_dc_luminance_values[i]);
 
-	writebyte(0x10); // HTYACinfo
+	writebyte(ctx, 0x10); // HTYACinfo
 	for (i = 0; i < 16; i++)
-		writebyte(std_ac_luminance_nrcodes[i]);
+		writebyte(ctx, std_ac_luminance_nrcodes[i]);
 	for (i = 0; i < 162; i++)
-		writebyte(std_ac_luminance_values[i]);
+		writebyte(ctx, std_ac_luminance_values[i]);
 	
 
-	writebyte(1); // HTCbDCinfo
+	writebyte(ctx, 1); // HTCbDCinfo
 	for (i = 0; i < 16; i++)
-		writebyte(std_dc_chrominance_nrcodes[i]);
+		writebyte(ctx, std_dc_chrominance_nrcodes[i]);
 	for (i = 0; i < 12; i++)
-		writebyte(std_dc_chrominance_values[i]);
+		writebyte(ctx, std_dc_chrominance_values[i]);
 	
-	writebyte(0x11); // HTCbACinfo = 0x11;
+	writebyte(ctx, 0x11); // HTCbACinfo = 0x11;
 	for (i = 0; i < 16; i++)
-		writebyte(std_ac_chrominance_nrcodes[i]);
+		writebyte(ctx, std_ac_chrominance_nrcodes[i]);
 	for (i = 0; i < 162; i++)
-		writebyte(std_ac_chrominance_values[i]);
+		writebyte(ctx, std_ac_chrominance_values[i]);
 }
 
 /**
- * @brief Write bits into bit-buffer. If the number of bits exceeds 16 the result is unpredictable.
- * @param bb    - Pointer to bit-buffer context
+ * @brief Write bits into bit-buffer. The bit-buffer is written out a word at a time, when it fills up.
+ * A Huffman code and the VLI that follows it can be written together.
+ * @param ctx   - encoder context
  * @param bits  - Bits to write
- * @param nbits - Number of bits to write, 0-16
+ * @param nbits - Number of bits to write, 0-31
  * @return      - Nothing
  */
-static void writebits(bitbuffer_t *const pbb, unsigned bits, unsigned nbits)
+static inline void writebits(jpeg_t *const ctx, unsigned bits, unsigned nbits)
 {
-	// shift old bits to the left, add new to the right
-	pbb->buf = (pbb->buf << nbits) | (bits & ((1 << nbits)-1));
-
-	// new number of bits
-	nbits += pbb->n;
+	// flushbits() writes 0 bits when the last byte is full -- with an empty word (bitfree 32) 
+	// that would shift by 32 below
+	if (nbits==0)
+		return;
+	bits &= (1 << nbits)-1;
 
-	// flush whole bytes
-	while (nbits >= 8) {
-		unsigned char b;
-
-		nbits -= 8;
-		b = pbb->buf >> nbits;
-
-		writebyte(b);
-
-		if (b == 0xFF)
-			writebyte(0); // add 0x00 after 0xFF
+	if (nbits < ctx->bitfree) {
+		ctx->bitfree -= nbits;
+		ctx->bitbuf |= bits << ctx->bitfree;
+	}
+	else {
+		// fill the word up, write it and start the next one with the bits that are left
+		nbits -= ctx->bitfree;
+		ctx->bitbuf |= bits >> nbits;
+		writestream(ctx, ctx->bitbuf);
+		ctx->bitfree = 32 - nbits;
+		ctx->bitbuf = nbits ? bits << ctx->bitfree : 0;
 	}
-
-	// remember how many bits is remained
-	pbb->n = nbits;
 }
 
 /**
  * @brief Flush bits into bit-buffer. If there is not an integer number of bytes in bit-buffer - add 1-s
  * and write these bytes
- * @param pbb - pointer to bit-buffer context
+ * @param ctx - encoder context
  * @return    - Nothing
  */
-static void flushbits(bitbuffer_t *pbb)
+static void flushbits(jpeg_t *ctx)
 {
-	if (pbb->n)
-		writebits(pbb, 0xFF, 8 - pbb->n);
+	unsigned char b;
+
+	writebits(ctx, 0xFF, ctx->bitfree & 7);
+
+	for (; ctx->bitfree < 32; ctx->bitfree += 8) {
+		b = ctx->bitbuf >> 24;
+		ctx->bitbuf <<= 8;
+
+		writebyte(ctx, b);
+
+		if (b == 0xFF)
+			writebyte(ctx, 0); // add 0x00 after 0xFF
+	}
+	ctx->bitbuf = 0;
 }
 
 /**
@@ -547,91 +611,114 @@ static unsigned huffman_bits(const short value)
 static unsigned huffman_magnitude(const short value)
 {
 	unsigned x = (value < 0)? -value: value;
-	unsigned m = 0;
 
-	while (x >> m) ++m;
-
-	return m;
+	return 32 - __CLZ(x);
 }
 
 /**
  * @brief Starts the Huffman encoding by writing Start of Image (SOI) and all headers.
- * Sets image size in Start of File (SOF) header before writing it.
+ * Sets image size in Start of File (SOF) header before writing it.  If the context has a 
+ * restart interval, a Define Restart Interval (DRI) header is written too.
+ * @param ctx    - encoder context
  * @param height - image height (pixels)
  * @param width  - image width (pixels)
  * @return       - Nothing
  */
-void huffman_start(short height, short width)
-{
-	writeword(0xFFD8); // SOI
-	write_APP0info();
-	write_DQTinfo();
-	write_SOF0info(height, width);
-	write_DHTinfo();
-	write_SOSinfo();
-
-	huffman_ctx[2].dc = 
-	huffman_ctx[1].dc = 
-	huffman_ctx[0].dc = 0;
+void huffman_start(jpeg_t *ctx, short height, short width)
+{
+	writeword(ctx, 0xFFD8); // SOI
+	write_APP0info(ctx);
+	write_DQTinfo(ctx);
+	write_SOF0info(ctx, height, width);
+	write_DHTinfo(ctx);
+	if (ctx->restart)
+		write_DRIinfo(ctx);
+	write_SOSinfo(ctx);
+
+	huffman_reset(ctx);
+}
+
+/**
+ * @brief Starts an entropy-coded segment -- the image data after the headers or after a 
+ * restart marker -- by resetting the DC predictions and the bit-buffer.
+ * @param ctx - encoder context
+ * @return    - Nothing
+ */
+void huffman_reset(jpeg_t *ctx)
+{
+	ctx->dc[2] = 
+	ctx->dc[1] = 
+	ctx->dc[0] = 0;
+
+	ctx->bitbuf = 0;
+	ctx->bitfree = 32;
 }
 
 /**
- * @brief Finalize Huffman encoding by flushing bit-buffer, writing End of Image (EOI)
- * into output buffer and flushing this buffer.
- * @param  - Nothing
- * @return - Nothing
+ * @brief Ends an entropy-coded segment by flushing the bit-buffer.
+ * @param ctx - encoder context
+ * @return    - Nothing
+ */
+void huffman_flush(jpeg_t *ctx)
+{
+	flushbits(ctx);
+}
+
+/**
+ * @brief Finalize Huffman encoding by flushing bit-buffer and writing End of Image (EOI)
+ * into output buffer.
+ * @param ctx - encoder context
+ * @return    - Nothing
  */
 
-void huffman_stop(void)
+void huffman_stop(jpeg_t *ctx)
 {
-	flushbits(&bitbuf);
-	writeword(0xFFD9); // EOI - End of Image
-	write_jpeg(jpgbuff, jpgn);
-	jpgn = 0;
+	flushbits(ctx);
+	writeword(ctx, 0xFFD9); // EOI - End of Image
 }
 
 /**
  * @brief Quantize and Encode a 8x8 DCT block by JPEG Huffman lossless coding.
  * This function writes encoded bit-stream into bit-buffer.
- * @param ctx  - pointer to encoder context
- * @param data - pointer to 8x8 DCT block
- * @return     - Nothing
+ * @param ctx       - pointer to encoder context
+ * @param component - HUFFMAN_CTX_Y, HUFFMAN_CTX_Cb or HUFFMAN_CTX_Cr
+ * @param data      - pointer to 8x8 DCT block
+ * @return          - Nothing
  */
-void huffman_encode(huffman_t *const ctx, const short data[])
+void huffman_encode(jpeg_t *const ctx, const unsigned component, const short data[])
 {
 	unsigned magn, bits;
 	unsigned zerorun, i;
 	short    diff;
+	const huffman_t *const h = &huffman_tables[component];
+	const unsigned char *const qtable = component==HUFFMAN_CTX_Y ? ctx->qtable_lum : ctx->qtable_chrom;
 
-	short    dc = quantize(data[0], ctx->qtable[0]);
+	short    dc = quantize(data[0], qtable[0]);
 	// difference between old and new DC
-	diff = dc - ctx->dc;
-	ctx->dc = dc;
+	diff = dc - ctx->dc[component];
+	ctx->dc[component] = dc;
 
 	bits = huffman_bits(diff); // VLI
 	magn = huffman_magnitude(diff); // VLI length
 
-	// encode VLI length
-	writebits(&bitbuf, ctx->hdcbit[magn], ctx->hdclen[magn]);
-	// encode VLI itself
-	writebits(&bitbuf, bits, magn);
+	// encode VLI length and VLI itself
+	writebits(ctx, h->hdcbit[magn] << magn | (bits & ((1 << magn)-1)), h->hdclen[magn] + magn);
 
 	for (zerorun = 0, i = 1; i < 64; i++)
 	{
-		const short ac = quantize(data[zig[i]], ctx->qtable[zig[i]]);
+		const short ac = quantize(data[zig[i]], qtable[i]);
 
 		if (ac) {
 			while (zerorun >= 16) {
 				zerorun -= 16;
 				// ZRL
-				writebits(&bitbuf, ctx->hacbit[15][0], ctx->haclen[15][0]);
+				writebits(ctx, h->hacbit[15][0], h->haclen[15][0]);
 			}
 
 			bits = huffman_bits(ac);
 			magn = huffman_magnitude(ac);
 
-			writebits(&bitbuf, ctx->hacbit[zerorun][magn], ctx->haclen[zerorun][magn]);
-			writebits(&bitbuf, bits, magn);
+			writebits(ctx, h->hacbit[zerorun][magn] << magn | (bits & ((1 << magn)-1)), h->haclen[zerorun][magn] + magn);
 
 			zerorun = 0;
 		}
@@ -639,6 +726,6 @@ void huffman_encode(huffman_t *const ctx, const short data[])
 	}
 
 	if (zerorun) { // EOB - End Of Block
-		writebits(&bitbuf, ctx->hacbit[0][0], ctx->haclen[0][0]);
+		writebits(ctx, h->hacbit[0][0], h->haclen[0][0]);
 	}
 }
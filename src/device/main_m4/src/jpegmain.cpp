@@ -1,167 +1,170 @@
 #include <stdint.h>
-#include <debug.h>
+#include <stddef.h>
+#include <string.h>
 #include <pixytypes.h>
 #include "globals.h"
 #include "jpegenc.h"
 #include "dct.h"
+#include "simd.h"
 
 
-static uint8_t *g_outBuf;
-static uint32_t g_outSize;
-static uint32_t g_outIndex;
- 
-/*****************************************************************************
- * Public functions
- ****************************************************************************/
-
-
-/*
- * @brief Function for writing to the JPEG output file
- * @param buff[] - Buffer that holds the data to be written
- * @param size   -  The number of bytes to be written
- * @return       - Nothing
- */
-void write_jpeg(const unsigned char buff[], const unsigned size)
-    {
-	uint32_t i;
-
-   	for (i=0; i<size && g_outIndex<g_outSize; i++)
-		g_outBuf[g_outIndex++] = buff[i];
-    }
+// RGB to YCbCr (see RGB2Y(), RGB2Cb() and RGB2Cr()) on the dual 16-bit MACs.  The coefficients
+// of Y sum to 65536 and those of Cb and Cr to 0, so all 3 can be calculated exactly from the
+// packed differences (R-G, B-G), which fit in signed halfwords, unlike Y's G coefficient (38470).
+#define YCC_Y   PACK16(19595, 7471)
+#define YCC_CB  PACK16(-11058, 32767)
+#define YCC_CR  PACK16(32767, -5329)
 
+// Unpack columns -1 to 2 of one row of a 2x2 quad, and of the quad to its right, each as 2
+// halfword lanes -- the lower lane is the quad at p, the upper the quad at p+2.
+static inline void unpackRow(const uint8_t *p, uint32_t cols[4])
+{
+	uint32_t lo, hi;
+
+	lo = load32(p-1); // p[-1], p[0], p[1], p[2]
+	hi = load32(p+1); // p[1], p[2], p[3], p[4]
+	cols[0] = __UXTB16(lo);
+	cols[1] = __UXTB16(ror32(lo, 8));
+	cols[2] = __UXTB16(hi);
+	cols[3] = __UXTB16(ror32(hi, 8));
+}
+
+// (a+b+c+d)>>2 in both lanes
+static inline uint32_t avg4(uint32_t a, uint32_t b, uint32_t c, uint32_t d)
+{
+	return __UHADD16(__UHADD16(__UADD16(a, b), __UADD16(c, d)), 0);
+}
 
 void convertYUV(const Frame8 *frame, uint16_t x, uint16_t y, short Y8x8[4][8][8], short Cb8x8[8][8], short Cr8x8[8][8])
 {
-	uint8_t xx, yy;
-	uint8_t R0, G0, B0;
-	uint8_t R1, G1, B1;
-	uint8_t R2, G2, B2;
-	uint8_t R3, G3, B3;
-	uint8_t RA, GA, BA;
+	uint8_t xx, yy, i, offset;
+	uint32_t a[4], b[4], c[4], d[4];
+	uint32_t R[4], G[4], B[4];
+	uint32_t RA, GA, BA, rg, bg;
 	uint8_t *pixel0, *pixel; 
+	short *Y;
 	uint16_t width = frame->m_width;
 
 	pixel0 = frame->m_pixels + y*width + x;
 	for (yy=0; yy<16; yy+=2, pixel0+=width<<1)
 	{
-		for (xx=0, pixel=pixel0; xx<16; xx+=2, pixel+=2)
+		// do 2 quads at a time, the one at xx in the lower lanes and the one at xx+2 in the upper
+		for (xx=0, pixel=pixel0; xx<16; xx+=4, pixel+=4)
 		{
+			// rows -1 to 2, columns -1 to 2 are in a[0] to a[3], ..., d[0] to d[3]
+			unpackRow(pixel-width, a);
+			unpackRow(pixel, b);
+			unpackRow(pixel+width, c);
+			unpackRow(pixel+(width<<1), d);
+
 			// calc RGB using interpolation for all 4 pixels 
-    		R0 = (*(pixel-width-1)+*(pixel-width+1)+*(pixel+width-1)+*(pixel+width+1))>>2; 
-            G0 = (*(pixel-1)+*(pixel+1)+*(pixel+width)+*(pixel-width))>>2; 
-            B0 = *pixel;
+			R[0] = avg4(a[0], a[2], c[0], c[2]);
+			G[0] = avg4(b[0], b[2], c[1], a[1]);
+			B[0] = b[1];
 
-          	R1 = (*(pixel-width+1)+*(pixel+width+1))>>1;
-            G1 = *(pixel+1);
-            B1 = (*(pixel-1+1)+*(pixel+1+1))>>1;
+			R[1] = __UHADD16(a[2], c[2]);
+			G[1] = b[2];
+			B[1] = __UHADD16(b[1], b[3]);
 
-           	R2 = (*(pixel-1+width)+*(pixel+1+width))>>1; 
-            G2 = *(pixel+width); 
-            B2 = (*(pixel-width+width)+*(pixel+width+width))>>1; 
+			R[2] = __UHADD16(c[0], c[2]);
+			G[2] = c[1];
+			B[2] = __UHADD16(b[1], d[1]);
 
-            R3 = *(pixel+width+1); 
-            G3 = (*(pixel-1+width+1)+*(pixel+1+width+1)+*(pixel+width+width+1)+*(pixel-width+width+1))>>2; 
-            B3 = (*(pixel-width-1+width+1)+*(pixel-width+1+width+1)+*(pixel+width-1+width+1)+*(pixel+width+1+width+1))>>2; 
+			R[3] = c[2];
+			G[3] = avg4(c[1], c[3], d[2], b[2]);
+			B[3] = avg4(b[1], b[3], d[1], d[3]);
 
-			RA = (R0+R1+R2+R3)>>2;
-			GA = (G0+G1+G2+G3)>>2;
-			BA = (B0+B1+B2+B3)>>2;
+			RA = avg4(R[0], R[1], R[2], R[3]);
+			GA = avg4(G[0], G[1], G[2], G[3]);
+			BA = avg4(B[0], B[1], B[2], B[3]);
 
-			// calc YUV
-			if (yy>=8)
-			{
-				if (xx>=8)
-				{
-					Y8x8[3][yy-8][xx-8] = RGB2Y(R0, G0, B0) - 128;
-					Y8x8[3][yy-8][xx+1-8] = RGB2Y(R1, G1, B1) - 128;
-					Y8x8[3][yy+1-8][xx-8] = RGB2Y(R2, G2, B2) - 128;
-					Y8x8[3][yy+1-8][xx+1-8] = RGB2Y(R3, G3, B3) - 128;
-				}
-				else
-				{
-					Y8x8[2][yy-8][xx] = RGB2Y(R0, G0, B0) - 128;
-					Y8x8[2][yy-8][xx+1] = RGB2Y(R1, G1, B1) - 128;
-					Y8x8[2][yy+1-8][xx] = RGB2Y(R2, G2, B2) - 128;
-					Y8x8[2][yy+1-8][xx+1] = RGB2Y(R3, G3, B3) - 128;
-				}
-			}
-			else
+			// calc YUV, Y8x8[0] to [3] are the upper-left, upper-right, lower-left and lower-right blocks
+			Y = &Y8x8[((yy&8)>>2) | (xx>>3)][yy&7][xx&7];
+			for (i=0; i<4; i++)
 			{
-				if (xx>=8)
-				{
-					Y8x8[1][yy][xx-8] = RGB2Y(R0, G0, B0) - 128;
-					Y8x8[1][yy][xx+1-8] = RGB2Y(R1, G1, B1) - 128;
-					Y8x8[1][yy+1][xx-8] = RGB2Y(R2, G2, B2) - 128;
-					Y8x8[1][yy+1][xx+1-8] = RGB2Y(R3, G3, B3) - 128;
-				}
-				else
-				{
-					Y8x8[0][yy][xx] = RGB2Y(R0, G0, B0) - 128;
-					Y8x8[0][yy][xx+1] = RGB2Y(R1, G1, B1) - 128;
-					Y8x8[0][yy+1][xx] = RGB2Y(R2, G2, B2) - 128;
-					Y8x8[0][yy+1][xx+1] = RGB2Y(R3, G3, B3) - 128;
-				}
+				offset = ((i&2)<<2) | (i&1); // 0, 1, 8, 9
+				rg = __SSUB16(R[i], G[i]);
+				bg = __SSUB16(B[i], G[i]);
+				Y[offset] = (G[i]&0xffff) + ((int32_t)__SMLAD(__PKHBT(rg, bg, 16), YCC_Y, 32768)>>16) - 128;
+				Y[offset+2] = (G[i]>>16) + ((int32_t)__SMLAD(__PKHTB(bg, rg, 16), YCC_Y, 32768)>>16) - 128;
 			}
-		    Cb8x8[yy>>1][xx>>1] = (short)RGB2Cb(RA, GA, BA) - 128;
-		    Cr8x8[yy>>1][xx>>1] = (short)RGB2Cr(RA, GA, BA) - 128;
+			rg = __SSUB16(RA, GA);
+			bg = __SSUB16(BA, GA);
+			Cb8x8[yy>>1][xx>>1] = ((int32_t)__SMLAD(__PKHBT(rg, bg, 16), YCC_CB, 8421376)>>16) - 128;
+			Cb8x8[yy>>1][(xx>>1)+1] = ((int32_t)__SMLAD(__PKHTB(bg, rg, 16), YCC_CB, 8421376)>>16) - 128;
+			Cr8x8[yy>>1][xx>>1] = ((int32_t)__SMLAD(__PKHBT(rg, bg, 16), YCC_CR, 8421376)>>16) - 128;
+			Cr8x8[yy>>1][(xx>>1)+1] = ((int32_t)__SMLAD(__PKHTB(bg, rg, 16), YCC_CR, 8421376)>>16) - 128;
 		}
 	} 
-}
+}
 
-int jpeg_encode(const Frame8 *frame, uint8_t quality, uint8_t *out, uint32_t *size)
+/*
+ * @brief Encodes the 16x16 blocks (MCUs) of rows y0 to y1-1 of the frame, as one entropy-coded 
+ * segment, i.e. from reset DC predictions to a byte boundary.  Slices of a frame encoded 
+ * with separate contexts can be put together with restart markers (RSTn) between them. 
+ * @param ctx   - encoder context, see jpeg_init() and jpeg_setOutput()
+ * @param frame - the frame, with at least a row of valid memory before and after it
+ * @param y0    - first row, multiple of 16
+ * @param y1    - row after the last row, the frame height is rounded down to a multiple of 16
+ * @return      - bytes in the output so far, or -1 if the output buffer is full 
+ */
+int jpeg_encodeRows(jpeg_t *ctx, const Frame8 *frame, uint16_t y0, uint16_t y1)
     {
-
     short Y8x8[4][8][8]; // four 8x8 blocks - 16x16
     short Cb8x8[8][8];
     short Cr8x8[8][8];
 
     unsigned short x, y;
 
-	g_outBuf = out;
-	g_outSize = *size;
-	g_outIndex = 0;
+	huffman_reset(ctx);
 
-    /*
-     * Process the bitmap image data in 16x16 blocks, (16x16 because of chroma subsampling)
-     * The resulting image will be truncated on the right/down side if its width/height is not N*16.
-     * The data is written into <file_jpg> file by write_jpeg() function which Huffman encoder uses
-     * to flush its output, so this file should be opened before the call of huffman_start().
-     */
-	setQuality(quality);
-
-    huffman_start(frame->m_height & -16, frame->m_width & -16);
-
-    for (y = 0; y < frame->m_height - 15; y += 16)
+    for (y = y0; y < y1 && y < frame->m_height - 15; y += 16)
 	{
 	for (x = 0; x < frame->m_width - 15; x += 16)
 	    {
 		convertYUV(frame, x, y, Y8x8, Cb8x8, Cr8x8); 
 
-#if 1
 	    // 1 Y-compression
 	    dct(Y8x8[0], Y8x8[0]);
-	    huffman_encode(HUFFMAN_CTX_Y, (short*) Y8x8[0]);
+	    huffman_encode(ctx, HUFFMAN_CTX_Y, (short*) Y8x8[0]);
 	    // 2 Y-compression
 	    dct(Y8x8[1], Y8x8[1]);
-	    huffman_encode(HUFFMAN_CTX_Y, (short*) Y8x8[1]);
+	    huffman_encode(ctx, HUFFMAN_CTX_Y, (short*) Y8x8[1]);
 	    // 3 Y-compression
 	    dct(Y8x8[2], Y8x8[2]);
-	    huffman_encode(HUFFMAN_CTX_Y, (short*) Y8x8[2]);
+	    huffman_encode(ctx, HUFFMAN_CTX_Y, (short*) Y8x8[2]);
 	    // 4 Y-compression
 	    dct(Y8x8[3], Y8x8[3]);
-	    huffman_encode(HUFFMAN_CTX_Y, (short*) Y8x8[3]);
+	    huffman_encode(ctx, HUFFMAN_CTX_Y, (short*) Y8x8[3]);
 	    // Cb-compression
 	    dct(Cb8x8, Cb8x8);
-	    huffman_encode(HUFFMAN_CTX_Cb, (short*) Cb8x8);
+	    huffman_encode(ctx, HUFFMAN_CTX_Cb, (short*) Cb8x8);
 	    // Cr-compression
 	    dct(Cr8x8, Cr8x8);
-	    huffman_encode(HUFFMAN_CTX_Cr, (short*) Cr8x8);
-#endif
+	    huffman_encode(ctx, HUFFMAN_CTX_Cr, (short*) Cr8x8);
 	    }
 	}
-    huffman_stop();
+	huffman_flush(ctx);
+
+	return ctx->overflow ? -1 : ctx->outIndex;
+    }
+
+int jpeg_encode(const Frame8 *frame, uint8_t quality, uint8_t *out, uint32_t *size)
+    {
+    jpeg_t ctx;
+
+    /*
+     * Process the bitmap image data in 16x16 blocks, (16x16 because of chroma subsampling)
+     * The resulting image will be truncated on the right/down side if its width/height is not N*16.
+     * The output is truncated if it doesn't fit in *size bytes. 
+     */
+	jpeg_init(&ctx, quality, 0);
+	jpeg_setOutput(&ctx, out, *size);
 
-	*size = g_outIndex;
-    return 0;
+    huffman_start(&ctx, frame->m_height & -16, frame->m_width & -16);
+    jpeg_encodeRows(&ctx, frame, 0, frame->m_height);
+    huffman_stop(&ctx);
 
+	*size = ctx.outIndex;
+    return ctx.overflow ? -1 : 0;
     }
@@ -0,0 +1,3590 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "pixy_init.h"
+#include "misc.h"
+#include "calc.h"
+#include "lineengine.h"
+
+#define ABS(x)      ((x)<0 ? -(x) : (x))
+#define SIGN(x)     ((x)>=0 ? 1 : -1)
+
+LineEngine::LineEngine(uint16_t prebuf) : m_linesList(&m_linesPool), m_nodesList(&m_nodesPool), m_nadirsList(&m_nadirsPool),
+	m_intersectionsList(&m_intersectionsPool), m_lineTrackersList(&m_lineTrackersPool), m_barCodeTrackersList(&m_barCodeTrackersPool)
+{
+	m_prebuf = prebuf;
+	m_stageCallback = NULL;
+	m_debug = 0;
+	m_frame = 0;
+	memset(m_stageCycles, 0, sizeof(m_stageCycles));
+	resetProfile();
+
+	m_lineGrid = NULL;
+	m_lineGridMem = NULL;
+	m_lineSegs = NULL;
+	m_lineSegsMem = NULL;
+	m_lines = NULL;
+	m_votedBarcodes = NULL;
+	m_votedBarcodesMem = NULL;
+	m_lineSegIndex = 0;
+	m_barcodeIndex = 0;
+	m_barcodeClusterIndex = 0;
+	m_votedBarcodeIndex = 0;
+	m_deltaFrame = 0;
+
+	m_maxSegTanAngle = tan(M_PI/4)*1000;
+	m_maxEquivTanAngle = tan(M_PI/10)*1000;
+	m_maxTrackingTanAngle = tan(M_PI/10)*1000;
+	m_pointsPerSeg = 12;
+	m_maxError = 0.9;
+	m_maxCodeDist = 15*15;
+	m_minVotingThreshold = 128; // divide by 256, so 128 is 1/2
+
+	updateParams();
+}
+
+LineEngine::~LineEngine()
+{
+	close();
+}
+
+int LineEngine::open()
+{
+	int pools;
+	
+	close();
+	
+	m_lineGridMem = (uint8_t *)malloc(LINE_GRID_WIDTH*LINE_GRID_HEIGHT*sizeof(LineGridNode)+m_prebuf+8); // +8 for extra memory at the end because little overruns sometimes happen
+	m_lineGrid = (LineGridNode *)(m_lineGridMem+m_prebuf);
+	
+	m_lines = (SimpleListNode<Line2> **)malloc(LINE_MAX_LINES*sizeof(SimpleListNode<Line2> *));
+	m_lineSegsMem = (uint8_t *)malloc(LINE_MAX_SEGMENTS*sizeof(LineSeg)+m_prebuf);
+	m_lineSegs = (LineSeg *)(m_lineSegsMem+m_prebuf);
+	
+	m_votedBarcodesMem = (uint8_t *)malloc(LINE_MMC_VOTED_BARCODES*sizeof(DecodedBarCode)+m_prebuf);
+	m_votedBarcodes = (DecodedBarCode *)(m_votedBarcodesMem+m_prebuf);
+	
+	pools = m_linesPool.allocate(LINE_MAX_LINES);
+	pools |= m_nodesPool.allocate(LINE_MAX_LINES*2); // 2 nodes per line
+	pools |= m_nadirsPool.allocate(LINE_MAX_NADIRS);
+	pools |= m_intersectionsPool.allocate(LINE_MAX_INTERSECTIONS);
+	pools |= m_lineTrackersPool.allocate(LINE_MAX_LINE_TRACKERS);
+	pools |= m_barCodeTrackersPool.allocate(LINE_MAX_BARCODE_TRACKERS);
+
+	if (m_lineGridMem==NULL || m_lineSegsMem==NULL || m_lines==NULL || m_votedBarcodesMem==NULL || pools<0)
+	{
+		close();
+		return -1;
+	}
+	
+	m_lineIndex = 1;
+	m_lineSegIndex = 0;
+	m_barcodeIndex = 0;
+	m_barcodeClusterIndex = 0;
+	m_votedBarcodeIndex	 = 0;
+	m_barCodeTrackerIndex = 0;
+	m_lineTrackerIndex = 0;
+	m_row = -1;
+	
+	m_lineState = LINE_STATE_ACQUIRING;
+	m_primaryActive = false;
+	// reset() leaves the intersection in the leading state, so don't leave garbage in it (the engine isn't necessarily static)
+	memset(&m_primaryIntersection.m_object, 0, sizeof(FrameIntersection));
+	m_primaryIntersection.reset();
+	m_newIntersection = false;
+	m_nextTurnAngle = 0;
+	m_newTurnAngle = false;
+	m_manualVectorSelectActive = false;
+	m_reversePrimary = false;
+	resetDelta();
+
+	return 0;
+}
+
+void LineEngine::close()
+{
+	m_linesList.clear();
+	m_nodesList.clear();
+	m_nadirsList.clear();
+	m_intersectionsList.clear();
+	m_lineTrackersList.clear();
+	m_barCodeTrackersList.clear();
+	m_linesPool.deallocate();
+	m_nodesPool.deallocate();
+	m_nadirsPool.deallocate();
+	m_intersectionsPool.deallocate();
+	m_lineTrackersPool.deallocate();
+	m_barCodeTrackersPool.deallocate();
+
+	free(m_lineGridMem);
+	free(m_lineSegsMem);
+	free(m_lines);
+	free(m_votedBarcodesMem);
+	m_lineGridMem = NULL;
+	m_lineGrid = NULL;
+	m_lineSegsMem = NULL;
+	m_lineSegs = NULL;
+	m_lines = NULL;
+	m_votedBarcodesMem = NULL;
+	m_votedBarcodes = NULL;
+	m_lineSegIndex = 0;
+	m_votedBarcodeIndex = 0;
+}
+
+void LineEngine::updateParams()
+{
+	uint16_t leading, trailing;
+
+	m_minLineLength2 = m_params.m_minLineLength*m_params.m_minLineLength; // squared
+	// compareLines() adds the squared distances of both endpoints, so neither can be farther 
+	// than sqrt(m_maxLineCompare)
+	for (m_trackRadius=0; (uint32_t)m_trackRadius*m_trackRadius<m_params.m_maxLineCompare && m_trackRadius<LINE_GRID_WIDTH; m_trackRadius++);
+	leading = m_params.m_intersectionFiltering*LINE_FILTERING_MULTIPLIER;
+	trailing = (leading+1)>>1;
+	m_primaryIntersection.setTiming(leading, trailing); 
+}
+
+void LineEngine::setStageCallback(LineStageCallback callback)
+{
+	m_stageCallback = callback;
+}
+
+void LineEngine::beginStage(uint8_t stage)
+{
+	if (m_stageCallback)
+		(*m_stageCallback)(this, stage, false);
+	setCycleTimer(&m_stageTimer);
+}
+
+void LineEngine::endStage(uint8_t stage)
+{
+	m_stageCycles[stage] = getCycleTimer(m_stageTimer);
+	m_profile[stage].add(m_stageCycles[stage]);
+	if (m_stageCallback)
+		(*m_stageCallback)(this, stage, true);
+}
+
+void LineEngine::beginFrame()
+{
+	// initialize variables
+	m_barcodeIndex = 0;
+	m_barcodeClusterIndex = 0;
+	m_row = -1;
+	memset(m_vstate, 0, LINE_VSIZE);
+	// the line index table (m_lineGrid) is only read where m_gridLabel is set, so we just clear the bitmaps
+	memset(m_gridHLine, 0, sizeof(m_gridHLine));
+	memset(m_gridVLine, 0, sizeof(m_gridVLine));
+	memset(m_gridOpen, 0, sizeof(m_gridOpen));
+	memset(m_gridLabel, 0, sizeof(m_gridLabel));
+	
+	if (m_debug&LINE_DEBUG_TRACKING)
+		cprintf(0, "Frame %d ______\n", m_frame);
+	m_frame++;
+	
+	checkGraph(__LINE__);
+	
+	beginStage(LINE_STAGE_EDGES);
+}
+
+void LineEngine::addEdges(const uint16_t *line, uint32_t len)
+{
+	if (line[0]==EQ_HSCAN_LINE_START)
+	{
+		m_row++;
+		detectCodes(m_row, line+1, len-1);
+		hLine(m_row, line+1, len-1);
+	}
+	else if (line[0]==EQ_VSCAN_LINE_START)
+		vLine(m_row, m_vstate, line+1, len-1);
+}
+
+int LineEngine::endFrame(bool error)
+{
+	endStage(LINE_STAGE_EDGES);
+
+	beginStage(LINE_STAGE_CODES);
+	clusterCodes();
+	clearGrid();
+	endStage(LINE_STAGE_CODES);
+	
+	if (error) // deal with error after we call clusterCodes, so the voted barcodes are from this frame
+	{
+		m_linesList.clear();
+		m_nodesList.clear();
+		m_nadirsList.clear();
+		m_intersectionsList.clear();
+		return -1;
+	}
+		
+	beginStage(LINE_STAGE_BARCODE_TRACKING);
+	handleBarCodeTracking();
+	endStage(LINE_STAGE_BARCODE_TRACKING);
+	
+	buildGraph();
+
+	beginStage(LINE_STAGE_LINE_TRACKING);
+	handleLineTracking();
+	endStage(LINE_STAGE_LINE_TRACKING);
+	
+	beginStage(LINE_STAGE_LINE_STATE);
+	handleLineState();
+	endStage(LINE_STAGE_LINE_STATE);
+	
+	return 0;
+}
+
+void LineEngine::buildGraph()
+{
+	m_linesList.clear();
+	m_nodesList.clear();
+	m_nadirsList.clear();
+	m_intersectionsList.clear();
+	m_lineIndex = 1; // set to 1 because 0 means empty...
+	m_lineSegIndex = 0;
+	
+	beginStage(LINE_STAGE_SEGMENTS);
+	extractLineSegments();
+	endStage(LINE_STAGE_SEGMENTS);
+	
+	beginStage(LINE_STAGE_NADIRS);
+	findNadirs();
+	endStage(LINE_STAGE_NADIRS);
+	
+	beginStage(LINE_STAGE_REDUCE_NADIRS);
+	reduceNadirs();
+	checkGraph(__LINE__);
+	endStage(LINE_STAGE_REDUCE_NADIRS);
+
+	beginStage(LINE_STAGE_INTERSECTIONS);
+	formIntersections();
+	checkGraph(__LINE__);
+	endStage(LINE_STAGE_INTERSECTIONS);
+
+	beginStage(LINE_STAGE_CLEAN);
+	cleanIntersections();
+	checkGraph(__LINE__);
+    removeMinLines(m_minLineLength2);
+	
+	if (m_debug&LINE_DEBUG_TRACKING)
+	{
+		SimpleListNode<Line2> *ln;
+		SimpleListNode<Intersection> *in;
+		uint32_t k;
+	
+		cprintf(0, "Lines\n");
+		for (ln=m_linesList.m_first, k=0; ln!=NULL; ln=ln->m_next, k++)
+			cprintf(0, "  %d: (%d %d %x)(%d %d %x)\n", k, ln->m_object.m_p0.m_x, ln->m_object.m_p0.m_y, ln->m_object.m_i0, ln->m_object.m_p1.m_x, ln->m_object.m_p1.m_y, ln->m_object.m_i1);
+		cprintf(0, "Intersections\n");
+		for (in=m_intersectionsList.m_first, k=0; in!=NULL; in=in->m_next, k++)
+			cprintf(0, " %d: %d (%d %d) %x\n", k, in->m_object.m_n, in->m_object.m_p.m_x, in->m_object.m_p.m_y, in);
+	}
+	
+	checkGraph(__LINE__);
+	endStage(LINE_STAGE_CLEAN);
+}
+
+int LineEngine::processFrame(const uint16_t *edges, uint32_t len, uint32_t *consumed)
+{
+	uint32_t i, j;
+	bool error = false;
+	
+	beginFrame();
+	for (i=0; true; i=j)
+	{
+		if (i>=len) // ran out of data before the end of the frame
+		{
+			error = true;
+			break;
+		}
+		if (edges[i]==EQ_FRAME_END)
+		{
+			i++;
+			break;
+		}
+		if (edges[i]==EQ_ERROR)
+		{
+			i++;
+			error = true;
+			break;
+		}
+		// find next line code, it terminates this line
+		for (j=i+1; j<len && edges[j]<EQ_HSCAN_LINE_START; j++);
+		if (j>=len)
+		{
+			i = j;
+			error = true;
+			break;
+		}
+		addEdges(edges+i, j-i);
+	}
+	if (consumed)
+		*consumed = i;
+	
+	return endFrame(error);
+}
+
+static uint32_t tanDiffAbs1000(const Point &p00, const Point &p01, const Point &p10, const Point &p11, bool min=false)
+{
+	// find tangent of angle difference between the two lines
+	int16_t xdiff0, ydiff0;
+	int16_t xdiff1, ydiff1;
+	int32_t x, y, res;
+
+	xdiff0 = p01.m_x - p00.m_x;
+	ydiff0 = p01.m_y - p00.m_y;
+	xdiff1 = p11.m_x - p10.m_x;
+	ydiff1 = p11.m_y - p10.m_y;
+
+	x = xdiff0*xdiff1 + ydiff0*ydiff1;
+	y = ydiff0*xdiff1 - ydiff1*xdiff0;
+
+	// min==true says that we don't care how the lines stack up, just return the abs of the minimum.
+	// min==false says that we care of the angles open beyond 90 degrees, in which case return a big value.
+	if ((min&&x==0) || (!min&&x<=0))
+		return 1000000;
+
+	res = y*1000/x;
+	res = ABS(res);
+	return res;
+}
+
+uint32_t tanAbs1000(const Point &p0, const Point &p1)
+{
+	// find tangent of angle difference between the two lines
+	int16_t xdiff, ydiff;
+	int32_t res;
+
+	xdiff = p1.m_x - p0.m_x;
+	ydiff = p1.m_y - p0.m_y;
+
+	if (xdiff==0)
+		return 1000000;
+
+	res = ydiff*1000/xdiff;
+	res = ABS(res);
+	return res;
+}
+
+// index of the lowest set bit, bits must be nonzero
+static inline uint8_t lowestBit(uint32_t bits)
+{
+#ifdef __CC_ARM
+	return __clz(__rbit(bits));
+#else
+	return __builtin_ctz(bits);
+#endif
+}
+
+static bool xdirection(const Point &p0, const Point &p1)
+{
+    int16_t xdiff, ydiff;
+
+    xdiff = p1.m_x - p0.m_x;
+    ydiff = p1.m_y - p0.m_y;
+
+    return abs(xdiff)>abs(ydiff);
+}
+
+int LineEngine::hLine(uint8_t row, const uint16_t *buf, uint32_t len)
+{
+	uint16_t j, x, bit0, bit1, col0, col1, lineWidth;
+
+	// copy a lot of code to reduce branching, make it faster
+	if (m_params.m_whiteLine) // pos neg
+	{
+		for (j=0; buf[j]<EQ_HSCAN_LINE_START && buf[j+1]<EQ_HSCAN_LINE_START && j<len; j++)
+		{
+			bit0 = buf[j]&EQ_NEGATIVE;
+			bit1 = buf[j+1]&EQ_NEGATIVE;
+			col0 = buf[j]&~EQ_NEGATIVE;
+			col1 = buf[j+1]&~EQ_NEGATIVE;
+			if (bit0==0 && bit1!=0)
+			{
+				lineWidth = col1 - col0;
+				if (m_params.m_minLineWidth<lineWidth && lineWidth<m_params.m_maxLineWidth)
+				{
+					x = (((col0+col1)>>1) + m_params.m_edgeDist)>>3;
+					if (x<LINE_GRID_WIDTH && (row>>1)<LINE_GRID_HEIGHT)
+						setGridNode(m_gridHLine, x, row>>1);
+				}
+			}
+		}
+	}
+	else // black line
+	{
+ 		for (j=0; buf[j]<EQ_HSCAN_LINE_START && buf[j+1]<EQ_HSCAN_LINE_START && j<len; j++)
+		{
+			bit0 = buf[j]&EQ_NEGATIVE;
+			bit1 = buf[j+1]&EQ_NEGATIVE;
+			col0 = buf[j]&~EQ_NEGATIVE;
+			col1 = buf[j+1]&~EQ_NEGATIVE;
+			if (bit0!=0 && bit1==0)
+			{
+				lineWidth = col1 - col0;
+				if (m_params.m_minLineWidth<lineWidth && lineWidth<m_params.m_maxLineWidth)
+				{
+					x = (((col0+col1)>>1) + m_params.m_edgeDist)>>3;
+					if (x<LINE_GRID_WIDTH && (row>>1)<LINE_GRID_HEIGHT)
+						setGridNode(m_gridHLine, x, row>>1);
+				}
+			}
+		}
+	}
+	
+	return 0;
+}
+
+int LineEngine::vLine(uint8_t row, uint8_t *vstate, const uint16_t *buf, uint32_t len)
+{
+	uint16_t i, y, bit0, col0, lineWidth;
+
+	if (m_params.m_whiteLine)
+	{
+		for (i=0; buf[i]<EQ_HSCAN_LINE_START && i<len; i++)
+		{
+			bit0 = buf[i]&EQ_NEGATIVE;
+			col0 = (buf[i]&~EQ_NEGATIVE)>>2;
+			if (bit0==0) // pos
+				vstate[col0] = row+1;
+			else // bit0!=0, neg
+			{
+				if (vstate[col0]!=0)
+				{
+					lineWidth = (row - (vstate[col0]-1))<<2; // multiply by 4 because vertical is subsampled by 4
+					if (m_params.m_minLineWidth<lineWidth && lineWidth<m_params.m_maxLineWidth && col0<LINE_VSIZE)
+					{
+						y = (row - (lineWidth>>3))>>1;
+						if (y<LINE_GRID_HEIGHT && (col0>>1)<LINE_GRID_WIDTH)
+							setGridNode(m_gridVLine, col0>>1, y);
+					}
+					vstate[col0] = 0;
+				}
+			}
+		}
+	}
+	else // black line
+	{
+		for (i=0; buf[i]<EQ_HSCAN_LINE_START && i<len; i++)
+		{
+			bit0 = buf[i]&EQ_NEGATIVE;
+			col0 = (buf[i]&~EQ_NEGATIVE)>>2;
+			if (bit0!=0) // neg
+				vstate[col0] = row+1;
+			else // bit0==0, pos
+			{
+				if (vstate[col0]!=0)
+				{
+					lineWidth = (row - (vstate[col0]-1))<<2; // multiply by 4 because vertical is subsampled by 4
+					if (m_params.m_minLineWidth<lineWidth && lineWidth<m_params.m_maxLineWidth && col0<LINE_VSIZE)
+					{
+						y = (row - (lineWidth>>3))>>1;
+						if (y<LINE_GRID_HEIGHT && (col0>>1)<LINE_GRID_WIDTH)
+							setGridNode(m_gridVLine, col0>>1, y);
+					}
+					vstate[col0] = 0;
+				}
+			}
+		}
+	}
+	return 0;
+}
+
+
+static float lineSegError(Point ps[], uint8_t points, uint8_t *maxIndex)
+{
+	int8_t i, xdiff, ydiff;
+	float e, fe, maxe, error, slope;
+	
+	xdiff = ps[points-1].m_x - ps[0].m_x;
+	ydiff = ps[points-1].m_y - ps[0].m_y;
+	
+	if (ABS(ydiff)>ABS(xdiff)) // vertical
+	{
+		slope = (float)xdiff/ydiff;
+		for (i=1, error=0.0, maxe=-1.0; i<points; i++)
+		{
+			e = ps[i].m_x - (ps[0].m_x + (ps[i].m_y-ps[0].m_y)*slope);
+			fe = fabsf(e);
+			if (fe>maxe)
+			{
+				*maxIndex = i;
+				maxe = fe;
+			}
+			error += e;
+		}
+	}
+	else // horizontal
+	{
+		slope = (float)ydiff/xdiff;
+		for (i=1, error=0.0, maxe=-1.0; i<points; i++)
+		{
+			e = ps[i].m_y - (ps[0].m_y + (ps[i].m_x-ps[0].m_x)*slope);
+			fe = fabsf(e);
+			if (fe>maxe)
+			{
+				*maxIndex = i;
+				maxe = fe;
+			}
+			error += e;
+		}
+	}
+
+	error = fabsf(error)/(points-1);
+	
+	return error;
+}
+
+	
+void LineEngine::cleanGrid(Point ps[], uint8_t points)
+{
+	uint8_t i;
+	int8_t xdiff, ydiff;
+	
+	// don't put bogus indexes in grid
+	if (m_lineIndex>=LINE_MAX_LINES)
+		return;
+	
+	xdiff = ps[points-1].m_x - ps[0].m_x;
+	ydiff = ps[points-1].m_y - ps[0].m_y;
+	
+	if (ABS(ydiff)>ABS(xdiff)) // vertical
+	{
+		for (i=0; i<points-1; i++) // don't clean around the last point, otherwise we might not be able to pick up where we left off
+		{
+			setGridLine(ps[i], m_lineIndex);
+			if (ps[i].m_x>0)
+				LINE_GRID_CLEAR(m_gridOpen, ps[i].m_x-1, ps[i].m_y);
+			if (ps[i].m_x>1)
+				LINE_GRID_CLEAR(m_gridOpen, ps[i].m_x-2, ps[i].m_y);
+			if (ps[i].m_x<LINE_GRID_WIDTH-1)
+				LINE_GRID_CLEAR(m_gridOpen, ps[i].m_x+1, ps[i].m_y);
+			if (ps[i].m_x<LINE_GRID_WIDTH-2)
+				LINE_GRID_CLEAR(m_gridOpen, ps[i].m_x+2, ps[i].m_y);
+		}
+	}
+	else // horizontal
+	{
+		for (i=0; i<points-1; i++) // don't clean around the last point, otherwise we might not be able to pick up where we left off
+		{
+			setGridLine(ps[i], m_lineIndex);
+			if (ps[i].m_y>0)
+				LINE_GRID_CLEAR(m_gridOpen, ps[i].m_x, ps[i].m_y-1);
+			if (ps[i].m_y>1)
+				LINE_GRID_CLEAR(m_gridOpen, ps[i].m_x, ps[i].m_y-2);
+			if (ps[i].m_y<LINE_GRID_HEIGHT-1)
+				LINE_GRID_CLEAR(m_gridOpen, ps[i].m_x, ps[i].m_y+1);
+			if (ps[i].m_y<LINE_GRID_HEIGHT-2)
+				LINE_GRID_CLEAR(m_gridOpen, ps[i].m_x, ps[i].m_y+2);
+		}
+	}
+	// mark last point
+	setGridLine(ps[i], m_lineIndex);
+}
+
+int LineEngine::addline(const Point &p0, const Point &p1)
+{
+	SimpleListNode<Line2> *linen;
+	Line2 line;
+
+	if (m_lineIndex>=LINE_MAX_LINES)
+		return -2;
+	
+	line.m_p0 = p0;
+	line.m_p1 = p1; 
+	line.m_index = m_lineIndex;
+	linen = m_linesList.add(line);
+	if (linen==NULL)
+		return -1;
+	m_lines[m_lineIndex++] = linen;	
+	m_nodesList.add(p0);
+	m_nodesList.add(p1);		
+	return 0;
+}	
+
+LineSegIndex LineEngine::finishGridNode(Point ps[], uint8_t points, LineSegIndex prevSeg, Point &p0)
+{
+	float error;
+	LineSeg *ls0, *ls1;
+	uint8_t maxIndex;
+	
+	if (points==0 || m_lineSegIndex>=LINE_MAX_SEGMENTS-1 || m_lineIndex>=LINE_MAX_LINES-1)
+		return prevSeg; // return prevSeg to help logic in extractLines
+	
+	// check error of segment, split if necessary
+	error = lineSegError(ps, points, &maxIndex);
+	if (error<m_maxError || points<=5)
+	{
+		ls0 = &m_lineSegs[m_lineSegIndex++];
+		ls0->reset();
+		ls0->m_p0.m_x = ps[0].m_x;
+		ls0->m_p0.m_y = ps[0].m_y;
+		ls0->m_p1.m_x = ps[points-1].m_x;
+		ls0->m_p1.m_y = ps[points-1].m_y;
+		ls0->m_ls0 = prevSeg;
+		ls0->m_line = m_lineIndex;
+		cleanGrid(ps, points);
+	}
+	else // split 
+	{		
+		ls0 = &m_lineSegs[m_lineSegIndex++];
+		ls0->reset();
+		ls0->m_p0.m_x = ps[0].m_x;
+		ls0->m_p0.m_y = ps[0].m_y;
+		ls0->m_p1.m_x = ps[maxIndex].m_x;
+		ls0->m_p1.m_y = ps[maxIndex].m_y;
+		ls0->m_ls0 = prevSeg;
+		ls0->m_ls1 = m_lineSegIndex;
+		ls0->m_line = m_lineIndex;
+		cleanGrid(ps, maxIndex+1);
+
+		// split the line
+		addline(p0, ps[maxIndex+1]);
+		p0 = ps[maxIndex+1];
+		
+		ls1 = &m_lineSegs[m_lineSegIndex++];
+		ls1->reset();
+		ls1->m_p0.m_x = ps[maxIndex].m_x;
+		ls1->m_p0.m_y = ps[maxIndex].m_y;
+		ls1->m_p1.m_x = ps[points-1].m_x;
+		ls1->m_p1.m_y = ps[points-1].m_y;
+		ls1->m_ls0 = m_lineSegIndex-2;
+		ls1->m_line = m_lineIndex;
+		cleanGrid(ps+maxIndex+1, points-(maxIndex+1));
+	}
+	return m_lineSegIndex-1;
+}
+
+bool LineEngine::ydirUp(Point &p, uint8_t &points, Point ps[])
+{
+	if (p.m_y==0)
+		return false;
+
+	if (LINE_GRID_OPEN(p.m_x, p.m_y-1))
+	{
+		p.m_y--;
+		ps[points] = p;
+		LINE_GRID_CLEAR(m_gridOpen, p.m_x, p.m_y);
+		points++;
+		return true;
+	}
+	else if (p.m_x>0 && LINE_GRID_OPEN(p.m_x-1, p.m_y-1))
+	{
+		p.m_y--;
+		p.m_x--;
+		ps[points] = p;
+		LINE_GRID_CLEAR(m_gridOpen, p.m_x, p.m_y);
+		points++;
+		return true;
+	}
+	else if (p.m_x<LINE_GRID_WIDTH-1 && LINE_GRID_OPEN(p.m_x+1, p.m_y-1))
+	{
+		p.m_y--;
+		p.m_x++;
+		ps[points] = p;
+		LINE_GRID_CLEAR(m_gridOpen, p.m_x, p.m_y);
+		points++;
+		return true;
+	}
+	else // no points in the up direction
+		return false;
+}
+
+bool LineEngine::xdirLeft(Point &p, uint8_t &points, Point ps[])
+{
+	if (p.m_x>0 && LINE_GRID_OPEN(p.m_x-1, p.m_y))
+	{
+		p.m_x--;
+		ps[points] = p;
+		LINE_GRID_CLEAR(m_gridOpen, p.m_x, p.m_y);
+		points++;
+		return true;
+	}
+	else if (p.m_x>0 && p.m_y>0 && LINE_GRID_OPEN(p.m_x-1, p.m_y-1))
+	{
+		p.m_y--;
+		p.m_x--;
+		ps[points] = p;
+		LINE_GRID_CLEAR(m_gridOpen, p.m_x, p.m_y);
+		points++;
+		return true;
+	}
+	else if (p.m_x>0 && p.m_y<LINE_GRID_HEIGHT-1 && LINE_GRID_OPEN(p.m_x-1, p.m_y+1))
+	{
+		p.m_y++;
+		p.m_x--;
+		ps[points] = p;
+		LINE_GRID_CLEAR(m_gridOpen, p.m_x, p.m_y);
+		points++;
+		return true;
+	}
+	else
+		return false;
+}
+
+bool LineEngine::xdirRight(Point &p, uint8_t &points, Point ps[])
+{
+	if (p.m_x<LINE_GRID_WIDTH-1 && LINE_GRID_OPEN(p.m_x+1, p.m_y))
+	{
+		p.m_x++;
+		ps[points] = p;
+		LINE_GRID_CLEAR(m_gridOpen, p.m_x, p.m_y);
+		points++;
+		return true;
+	}
+	else if (p.m_x<LINE_GRID_WIDTH-1 && p.m_y>0 && LINE_GRID_OPEN(p.m_x+1, p.m_y-1))
+	{
+		p.m_y--;
+		p.m_x++;
+		ps[points] = p;
+		LINE_GRID_CLEAR(m_gridOpen, p.m_x, p.m_y);
+		points++;
+		return true;
+	}
+	else if (p.m_x<LINE_GRID_WIDTH-1 && p.m_y<LINE_GRID_HEIGHT-1 && LINE_GRID_OPEN(p.m_x+1, p.m_y+1))
+	{
+		p.m_y++;
+		p.m_x++;
+		ps[points] = p;
+		LINE_GRID_CLEAR(m_gridOpen, p.m_x, p.m_y);
+		points++;
+		return true;
+	}
+	else
+		return false;
+}
+
+void LineEngine::extractLineSegments(const Point &p)
+{
+	bool ydir = true;
+	bool rdir = true;
+	Point ps[LINE_MAX_SEGMENT_POINTS];
+	uint8_t points = 0;
+	LineSegIndex prevSeg = -1, thisSeg = -1;
+	uint32_t angle;
+	Point p2 = p; // current point	
+	Point p0 = p; // first point of line
+	
+	// nullify current point
+	ps[0] = p2;
+	LINE_GRID_CLEAR(m_gridOpen, p.m_x, p.m_y);
+	points++;
+		
+	while(1)
+	{
+		if (ydir)
+		{
+			if (!ydirUp(p2, points, ps))
+			{
+				if (!xdirLeft(p2, points, ps))
+				{
+					if (!xdirRight(p2, points, ps))
+						goto end;
+					else
+					{
+						ydir = false;
+						rdir = true;
+					}
+				}
+				else
+				{
+					ydir = false;
+					rdir = false;
+				}				
+			}
+		}
+		else if (!ydir && rdir)
+		{
+			if (!xdirRight(p2, points, ps))
+			{
+				if (!ydirUp(p2, points, ps))
+					goto end;
+				else
+					ydir = true;
+			}
+		}
+		else if (!ydir && !rdir)
+		{
+			if (!xdirLeft(p2, points, ps))
+			{
+				if (!ydirUp(p2, points, ps))
+					goto end;
+				else
+					ydir = true;
+			}
+		}
+		
+		if (points>=m_pointsPerSeg)
+		{
+			thisSeg = finishGridNode(ps, points, prevSeg, p0);
+			if (prevSeg>=0)
+			{
+				if (thisSeg-prevSeg>1) // deal with bisected segment 
+				{
+					m_lineSegs[prevSeg].m_ls1 = thisSeg-1; // link up prev segment with this one
+					// look at angle between segments, add if it exceeds a threshold 
+					angle = tanDiffAbs1000(m_lineSegs[prevSeg].m_p0, m_lineSegs[prevSeg].m_p1, m_lineSegs[thisSeg-1].m_p0, m_lineSegs[thisSeg-1].m_p1);
+				}
+				else
+				{
+					m_lineSegs[prevSeg].m_ls1 = thisSeg; // link up prev segment with this one
+					// look at angle between segments, add if it exceeds a threshold 
+					angle = tanDiffAbs1000(m_lineSegs[prevSeg].m_p0, m_lineSegs[prevSeg].m_p1, m_lineSegs[thisSeg].m_p0, m_lineSegs[thisSeg].m_p1);
+				}
+				if (angle>m_maxSegTanAngle)
+				{
+					// split the line here
+					addline(p0, m_lineSegs[prevSeg].m_p1);
+					if (m_lineIndex<LINE_MAX_LINES)
+					{
+						m_lineSegs[thisSeg].m_line = m_lineIndex; // set line seg line index to new index
+						cleanGrid(ps, points); // set nodes to new line index
+					}
+					p0 = ps[0];
+				}
+			}
+			prevSeg = thisSeg;
+			points = 0;
+		}
+	}
+
+	end:
+	// should we use the current segment?
+	// we should if there were previous segments or if the current segment is bigger than 2
+	if (prevSeg>=0 || points>2)
+	{		
+		thisSeg = finishGridNode(ps, points, prevSeg, p0);	
+		if (prevSeg>=0)
+			m_lineSegs[prevSeg].m_ls1 = thisSeg;
+		prevSeg = thisSeg;
+	}
+	
+	// add line
+	if (prevSeg>=0 && m_lineIndex<LINE_MAX_LINES)
+	{
+		if (addline(p0, m_lineSegs[prevSeg].m_p1)<0)
+			return;
+	}		
+}
+
+void LineEngine::extractLineSegments()
+{
+	int8_t i, j;
+	uint32_t *row, bits;
+	
+	for (i=LINE_GRID_HEIGHT-1; i>=0; i--) // bottom-up
+	{
+		row = m_gridOpen + LINE_GRID_WORD(0, i);
+		for (j=0; j<LINE_GRID_ROW_WORDS; j++)
+		{
+			// Re-read the word after each extraction because extraction closes nodes, possibly in this word. 
+			// Nodes to the left of the one we pick are already closed, so we still go left to right.
+			while ((bits=row[j]))
+				// we could do some analysis here to find the end of the continuous train of pixels, then asses which direction 
+				// the line is headed, upper-right, upper-left if it's horizontal
+				extractLineSegments(Point((j<<5) + lowestBit(bits), i)); 
+		}
+	}
+}
+
+
+void LineEngine::addNadir(const Point &p0, const Point &p1)
+{
+	uint16_t dist;
+	SimpleListNode<Nadir> *i;
+	Nadir n;
+	uint8_t i0, i1, is;
+	Point pp0, pp1;
+	
+	// calc distance between points
+	dist = p0.dist2(p1);
+	
+	// find lines
+	i0 = LINE_GRID_LINE_P(p0);
+	i1 = LINE_GRID_LINE_P(p1);
+	
+	if (i0==i1)
+		return;
+	if (i0<i1)
+	{
+		pp0 = p0;
+		pp1 = p1;
+	}
+	else // swap
+	{
+		pp0 = p1;
+		pp1 = p0;
+		is = i0;
+		i0 = i1;
+		i1 = is;
+	}
+	
+	// search nadir list for this pair, if it exists, and it's closer, replace it.
+	// The nadirs are chained by their first line, so we only look at the ones with line i0.
+	for (i=m_nadirLines[i0]; i!=NULL; i=i->m_object.m_lineNext)
+	{
+		if (i1==LINE_GRID_LINE_P(i->m_object.m_points[1]))
+		{
+			if (dist < i->m_object.m_dist)
+			{
+				i->m_object.m_dist = dist;
+				i->m_object.m_points[0] = pp0;
+				i->m_object.m_points[1] = pp1;
+				i->m_object.m_pavg = pp0;
+				i->m_object.m_pavg.avg(pp1);
+			}
+			return;
+		}
+	}
+			
+	// if it isn't in the list, add it.
+	n.m_points[0] = pp0;
+	n.m_points[1] = pp1;
+	n.m_n = 2;
+	n.m_dist = dist;
+	n.m_pavg = pp0;
+	n.m_pavg.avg(pp1);
+	n.m_lineNext = m_nadirLines[i0];
+	i = m_nadirsList.add(n);
+	if (i)
+		m_nadirLines[i0] = i;
+}
+
+void LineEngine::search(const Point &p, uint8_t radius)
+{
+	int8_t i, r;
+	uint8_t i0, i1;
+	
+	i0 = LINE_GRID_LINE(p.m_x, p.m_y);
+	
+	// search up
+	r = p.m_y - radius;
+	if (r<0) 
+		r = 0;
+	for (i=p.m_y-1; i>=r; i--)
+	{
+		i1 = LINE_GRID_LINE(p.m_x, i);
+		if (i1==0 || i0==i1)
+			continue;
+		addNadir(p, Point(p.m_x, i));
+	}
+	// search down
+	r = p.m_y + radius;
+	if (r>LINE_GRID_HEIGHT) 
+		r = LINE_GRID_HEIGHT;
+	for (i=p.m_y+1; i<r; i++)
+	{
+		i1 = LINE_GRID_LINE(p.m_x, i);
+		if (i1==0 || i0==i1)
+			continue;
+		addNadir(p, Point(p.m_x, i));
+	}
+	
+	// search left
+	r = p.m_x - radius;
+	if (r<0)
+		r = 0;
+	for (i=p.m_x-1; i>=r; i--)
+	{
+		i1 = LINE_GRID_LINE(i, p.m_y);
+		if (i1==0 || i0==i1)
+			continue;
+		addNadir(p, Point(i, p.m_y));
+	}
+	// search right
+	r = p.m_x + radius;
+	if (r>LINE_GRID_WIDTH)
+		r = LINE_GRID_WIDTH;
+	for (i=p.m_x+1; i<r; i++)
+	{
+		i1 = LINE_GRID_LINE(i, p.m_y);
+		if (i1==0 || i0==i1)
+			continue;
+		addNadir(p, Point(i, p.m_y));
+	}	
+}
+
+
+void LineEngine::findNadirs()
+{
+	SimpleListNode<Point> *i;
+	uint16_t e, f, n, dist, c;
+	int16_t x, y, x0, y0, x1, y1;
+	uint8_t li, lj, w;
+	uint16_t maxMergeDist=m_params.m_maxMergeDist, maxMergeDist2=maxMergeDist*maxMergeDist;
+	uint32_t bits, nearby[LINE_MAX_LINES*2/32];
+	
+	// index the nodes by cell
+	memset(m_cells, 0xff, sizeof(m_cells));
+	memset(m_nadirLines, 0, sizeof(m_nadirLines));
+	for (i=m_nodesList.m_first, n=0; i!=NULL && n<LINE_MAX_LINES*2; i=i->m_next, n++)
+	{
+		m_nodePoints[n] = i->m_object;
+		m_nodeLines[n] = LINE_GRID_LINE_P(i->m_object);
+		c = LINE_CELL_P(i->m_object);
+		m_cellNext[n] = m_cells[c];
+		m_cells[c] = n;
+	}
+	
+	// do n*(n-1)/2 search, but only compare with the nodes in the cells within the merge distance.
+	// We collect them in a bitmap so we still go through them in list order, which determines the
+	// order of the nadirs. 
+	for (e=0; e<n; e++)
+	{
+		memset(nearby, 0, sizeof(nearby));
+		x0 = LINE_CELL_X(MAX(m_nodePoints[e].m_x-maxMergeDist, 0));
+		x1 = LINE_CELL_X(m_nodePoints[e].m_x+maxMergeDist);
+		y0 = LINE_CELL_Y(MAX(m_nodePoints[e].m_y-maxMergeDist, 0));
+		y1 = LINE_CELL_Y(m_nodePoints[e].m_y+maxMergeDist);
+		for (y=y0; y<=y1; y++)
+		{
+			for (x=x0; x<=x1; x++)
+			{
+				for (f=m_cells[LINE_CELL(x, y)]; f!=LINE_CELL_NONE; f=m_cellNext[f])
+				{
+					if (f>e)
+						nearby[f>>5] |= LINE_GRID_BIT(f);
+				}
+			}
+		}
+		
+		li = m_nodeLines[e]; 
+		for (w=(e+1)>>5; w<=(n-1)>>5; w++)
+		{
+			for (bits=nearby[w]; bits; bits&=bits-1)
+			{
+				f = (w<<5) + lowestBit(bits);
+				lj = m_nodeLines[f]; 
+				if (li==lj) // if we're the same line, don't bother.  We're looking for a greater line index
+					continue;
+				dist = m_nodePoints[e].dist2(m_nodePoints[f]);
+				if (dist<=maxMergeDist2)
+					// in general li<lj because of the ordering of the labeling of the nodes and lines
+					// this is important because of the grid search below.  We'll ignore cases where li>=lj
+					// in the interest of efficiency.
+					addNadir(m_nodePoints[e], m_nodePoints[f]);
+			}
+		}
+	}
+	
+	// do grid search 
+	for (i=m_nodesList.m_first; i!=NULL; i=i->m_next)
+		search(i->m_object, m_params.m_maxMergeDist);
+}
+
+void LineEngine::reduceNadirs()
+{
+	SimpleListNode<Nadir> *i, *j, *inext, *jnext;
+	uint32_t dist;
+	uint16_t n, maxMergeDist2=(m_params.m_maxMergeDist*m_params.m_maxMergeDist*12)>>3; // multiply by a scaling factor of 1.5
+	
+	while(1)
+	{
+		// perform n^2 search, looking for nadirs that are close to each other
+		n = 0;
+		for (i=m_nadirsList.m_first; i!=NULL; i=inext)
+		{
+			inext = i->m_next;
+			for (j=i->m_next; j!=NULL; j=jnext)
+			{
+				jnext = j->m_next;
+				dist = i->m_object.m_pavg.dist2(j->m_object.m_pavg);
+				if (dist<maxMergeDist2)
+				{
+					i->m_object.merge(j->m_object, m_lineGrid, m_gridLabel); // merge j -> i
+					m_nadirsList.remove(j);
+					if (inext==j)
+						inext = jnext;
+					n++;
+				}
+			}
+		}
+		if (n==0) // no change, return...
+			break;
+	}
+}
+
+// line1.m_p0 is center (intersection)
+// line1.m_p1 is outer point of line1
+// p01 is outer point of line0
+void LineEngine::addLine(SimpleListNode<Nadir> *nadirs, uint8_t li0, const Point &p01, SimpleListNode<Line2> *linen1)
+{
+	SimpleListNode<Intersection> *j;
+	uint8_t i, li1 = linen1->m_object.m_index;
+	int8_t diffx, diffy;
+	bool horiz;
+	const Line2 &line1 = linen1->m_object;
+
+	// determine direction
+	diffx = p01.m_x - line1.m_p1.m_x;
+	diffy = p01.m_y - line1.m_p1.m_y;
+	
+	horiz = ABS(diffx)>ABS(diffy);
+
+	// look through intersections list for lines that are affected
+	for (j=m_intersectionsList.m_first; j!=NULL; j=j->m_next)
+	{
+		for (i=0; i<j->m_object.m_n; i++)
+		{
+			// line li0 has changed.  It's had one of its endpoints set to the new intersection
+			if (j->m_object.m_lines[i]->m_object.m_index==li0)
+			{
+				// We only need to look at line1.m_p1 since it's the only point that's an endpoint and therefore possibly coincident with this intersection
+				// if line.m_p1 is coincident with the intersection, we need to change the line pointer
+				if (j->m_object.m_p.equals(line1.m_p1))
+				{
+					j->m_object.m_lines[i] = linen1;
+					linen1->m_object.m_i1 = j; // if we change the line in an intersection, we need to change the line to point to the intersection
+				}
+			}
+		}
+	}
+
+	// look through remaining nadir list for points->lines that are affected
+	for (; nadirs!=NULL; nadirs=nadirs->m_next)
+	{
+		for (i=0; i<nadirs->m_object.m_n; i++)
+		{
+			const Point &pt = nadirs->m_object.m_points[i];
+			//if (LINE_GRID_INDEX_P(pt)>LINE_GRID_HEIGHT*LINE_GRID_WIDTH)
+			//	printf("*** %d\n");
+			if (li0==LINE_GRID_LINE_P(pt))
+			{
+				if (horiz)
+				{
+					if (SIGN(pt.m_x-line1.m_p0.m_x)==SIGN(line1.m_p1.m_x-line1.m_p0.m_x))
+						setGridLine(pt, li1);
+				}
+				else // vertical
+				{
+					if (SIGN(pt.m_y-line1.m_p0.m_y)==SIGN(line1.m_p1.m_y-line1.m_p0.m_y))
+						setGridLine(pt, li1);
+				}
+			}			
+		}
+	}
+}
+
+bool LineEngine::breakLine(SimpleListNode<Nadir> *nadirs, uint8_t li, SimpleListNode<Intersection> *intern)
+{
+	// orig line linen0   p0                m_p               p1
+	// broken line        p0 linen0 p1 intersection p0 linen1 p1
+	Line2 line2;
+	SimpleListNode<Line2> *linen1;
+	SimpleListNode<Line2> *linen0 = m_lines[li];
+	checkGraph(__LINE__, 1, 2);
+	
+	if (m_lineIndex>=LINE_MAX_LINES || intern->m_object.m_n>LINE_MAX_INTERSECTION_LINES-2 || 
+		linen0->m_object.m_p0.equals(linen0->m_object.m_p1)) // this last case is a crazy case the fouls up the addLine() logic below
+		return false;
+	
+	// create new line, add it to intersection
+	line2.m_p1 = linen0->m_object.m_p1;
+	line2.m_p0 = intern->m_object.m_p;
+	line2.m_index = m_lineIndex;
+	linen1 = m_linesList.add(line2);
+
+	if (linen1==NULL)
+		return false;
+
+	// modify first line
+	linen0->m_object.m_p1 = intern->m_object.m_p;
+	intern->m_object.addLine(linen0, intern, 1);
+
+	m_lines[m_lineIndex++] = linen1;
+	intern->m_object.addLine(linen1, intern, 0);
+	
+	// feedforward new line to nadirs we haven't seen yet
+	addLine(nadirs, li, linen0->m_object.m_p0, linen1); 
+	
+	checkGraph(__LINE__, 1, 2);
+	
+	return true;
+}
+
+uint8_t LineEngine::removeLine(SimpleListNode<Line2> *linen, SimpleListNode<Intersection> *intern)
+{
+	uint8_t i, j, m;
+	
+	// remove line from intersection
+	for (i=m=0; intern && i<intern->m_object.m_n; i++)
+	{
+		if (intern->m_object.m_lines[i]==linen)
+		{
+			intern->m_object.m_n--;
+			// shift lines down
+			for (j=i; j<intern->m_object.m_n; j++)
+				intern->m_object.m_lines[j] = intern->m_object.m_lines[j+1];
+			i--;
+			m++;
+		}
+	}
+	return m;
+}
+
+
+void LineEngine::removeLine(SimpleListNode<Line2> *linen)
+{	
+	removeLine(linen, linen->m_object.m_i0);
+	removeLine(linen, linen->m_object.m_i1);
+	
+#if 0
+	// remove line from m_lines
+	for (i=0; i<m_lineIndex; i++)
+	{
+		if (m_lines[i]==linen)
+		{
+			m_lines[i] = NULL;
+			break;
+		}
+	}
+#endif
+	
+	// remove line from m_linesList
+	m_linesList.remove(linen);
+	
+}
+
+void LineEngine::replaceLine(SimpleListNode<Line2> *linen, SimpleListNode<Line2> *linenx)
+{
+	uint8_t i;
+	SimpleListNode<Intersection> *j;
+
+#if 0	
+	for (i=0; i<m_lineIndex; i++)
+	{
+		if (m_lines[i]==linenx)
+		{
+			m_lines[i] = linen;
+			break;
+		}
+	}
+#endif
+	
+	// remove line from existing intersections
+	for (j=m_intersectionsList.m_first; j!=NULL; j=j->m_next)
+	{
+		for (i=0; i<j->m_object.m_n; i++)
+		{
+			if (j->m_object.m_lines[i]==linenx)
+			{
+				j->m_object.m_lines[i] = linen;
+//				break;
+			}
+		}
+	}
+	
+	m_linesList.remove(linenx);
+}
+
+
+void LineEngine::formIntersections()
+{
+	SimpleListNode<Nadir> *i;
+	uint8_t j, li;
+
+	checkGraph(__LINE__);
+	
+	// go through nadir list and break up the lines
+	for (i=m_nadirsList.m_first; i!=NULL; i=i->m_next)
+	{
+		SimpleListNode<Intersection> *intern = m_intersectionsList.newNode();
+		if (intern==NULL)
+			return;
+		Intersection *inter = &intern->m_object;
+		inter->m_p = i->m_object.m_pavg;
+		// look at each point/line in the list
+		// If it's an endpoint, we extend the line to the intersection point (avg)
+		// if it's not endpoint, we need to break the line and form 2 lines, each with the endpoint at the intersection
+		
+		for (j=inter->m_n=0; j<i->m_object.m_n && inter->m_n<LINE_MAX_INTERSECTION_LINES; j++)
+		{
+			Line2 *line;
+			SimpleListNode<Line2> *linen;
+			const Point &pt = i->m_object.m_points[j];
+			li = LINE_GRID_LINE_P(pt); 
+			if (li==0)
+				continue;
+			linen = m_lines[li];
+			line = &linen->m_object;
+			checkGraph(__LINE__, 1, 2, intern);
+			if (pt.equals(line->m_p0)) // matches p0
+			{
+				line->m_p0 = inter->m_p; // extend line
+				if (line->m_i0) // if we are already pointing to another intersection, remove and add ours
+					removeLine(linen, line->m_i0);
+				inter->addLine(linen, intern, 0);
+				checkGraph(__LINE__, 0, 0, intern);
+				checkGraph(__LINE__, 1, 2);
+			}
+			else if (pt.equals(line->m_p1)) // matches p1
+			{
+				line->m_p1 = inter->m_p; // extend line
+				if (line->m_i1) // if we are already pointing to another intersection, remove and add ours
+					removeLine(linen, line->m_i1);
+				inter->addLine(linen, intern, 1);
+				checkGraph(__LINE__, 0, 0, intern);
+				checkGraph(__LINE__, 1, 2);
+			}
+			else
+			{
+				breakLine(i->m_next, li, intern);
+				checkGraph(__LINE__, 0, 0, intern);
+				checkGraph(__LINE__, 1, 2);
+			}
+		}
+		m_intersectionsList.add(intern);
+		checkGraph(__LINE__);
+	}
+}	
+
+bool LineEngine::validIntersection(SimpleListNode<Intersection> *intern)
+{
+	SimpleListNode<Intersection> *i;
+	
+	if (intern==NULL)
+		return true; // valid
+
+	for (i=m_intersectionsList.m_first; i!=NULL; i=i->m_next)
+	{
+		if (i==intern)
+			return true;
+	}
+	return false;
+}
+
+bool LineEngine::validLine(SimpleListNode<Line2> *linen)
+{
+	SimpleListNode<Line2> *i;
+	
+	if (linen==NULL)
+		return true; // valid
+
+	for (i=m_linesList.m_first; i!=NULL; i=i->m_next)
+	{
+		if (i==linen)
+			return true;
+	}
+	return false;
+}
+
+
+#define CHECK(cond, index)   if(!(cond) && suppress0!=index && suppress1!=index) {check=index; goto end;} 
+
+bool LineEngine::checkGraph(int val, uint8_t suppress0, uint8_t suppress1, SimpleListNode<Intersection> *intern)
+{
+	SimpleListNode<Line2> *i;
+	SimpleListNode<Intersection> *j;
+	uint8_t k, n, h, check=0;	
+	
+	if (!(m_debug&LINE_DEBUG_GRAPH_CHECK))
+		return true;
+	
+	if (intern)
+		goto intersection;
+	
+	// go through line list, make sure all intersection pointers are valid 
+	// by finding them in the list, make sure the line is in the intersection's list
+	for (i=m_linesList.m_first; i!=NULL; i=i->m_next)
+	{
+		CHECK(validIntersection(i->m_object.m_i0), 1);
+		CHECK(validIntersection(i->m_object.m_i1), 2);
+		if (i->m_object.m_i0)
+		{
+			for (k=n=0; k<i->m_object.m_i0->m_object.m_n; k++)
+			{
+				if (i->m_object.m_i0->m_object.m_lines[k]==i)
+					n++;
+			}
+			CHECK(n==1, 3);
+		}
+		if (i->m_object.m_i1)
+		{
+			for (k=n=0; k<i->m_object.m_i1->m_object.m_n; k++)
+			{
+				if (i->m_object.m_i1->m_object.m_lines[k]==i)
+					n++;
+			}
+			CHECK(n==1, 4);
+		}		
+	}
+	
+	intersection:
+	// go through intersection list, make sure each intersection's lines are valid
+	// make sure each line points back to the intersection
+	for (j=m_intersectionsList.m_first; j!=NULL; j=j->m_next)
+	{
+		if (intern)
+			j = intern;
+		for (k=n=0; k<j->m_object.m_n; k++)
+		{
+			CHECK(validLine(j->m_object.m_lines[k]), 5);
+			CHECK(j->m_object.m_lines[k]->m_object.m_i0 != j->m_object.m_lines[k]->m_object.m_i1, 6);
+			CHECK(j->m_object.m_lines[k]->m_object.m_i0==j || j->m_object.m_lines[k]->m_object.m_i1==j, 7);
+			if (j->m_object.m_lines[k]->m_object.m_i0==j)
+				CHECK(j->m_object.m_p.equals(j->m_object.m_lines[k]->m_object.m_p0), 8);
+			if (j->m_object.m_lines[k]->m_object.m_i1==j)
+				CHECK(j->m_object.m_p.equals(j->m_object.m_lines[k]->m_object.m_p1), 9);			
+			for (h=k+1; h<j->m_object.m_n; h++)
+			{
+				if (j->m_object.m_lines[k]==j->m_object.m_lines[h])
+					n++;
+			}
+			CHECK(n==0, 10);
+		}
+		if (intern)
+			break;
+	}
+	
+	end:
+	if (check!=0)
+	{
+		cprintf(0, "fail %d %d\n", check, val);
+		return false;
+	}
+		
+	return true;
+}
+
+uint16_t LineEngine::removeShortLinesIntersections()
+{
+	uint8_t i, si;
+	SimpleListNode<Intersection> *j;
+	uint16_t n, m, length, shortest;
+	
+	// look through intersections removing short lines
+	// we remove the shortest lines first because we want to preserve the next-longest line for when we get to lines==2
+	for (j=m_intersectionsList.m_first, m=0; j!=NULL; j=j->m_next)
+	{
+		while(1)
+		{
+			checkGraph(__LINE__);
+			n = 0;
+			// If there are 2 lines in the intersection, no reason to trim (we'll merge them)
+			//if (j->m_object.m_n<=2)
+			//	break;
+			
+			// find shortest line in intersection
+			for (i=0, shortest=0xffff, si=0; i<j->m_object.m_n; i++)
+			{
+				length = j->m_object.m_lines[i]->m_object.length2();
+				if (length<shortest)
+				{
+					si = i;
+					shortest = length;
+				}
+			}
+				
+			// if it's shorter than m_minLineLength2, possibly remove it 
+			if (shortest<m_minLineLength2)
+			{
+				SimpleListNode<Line2> *linen = j->m_object.m_lines[si];
+				// one of the intersection pointers needs to be NULL, the other is our intersection
+				// if they are both non-NULL, this line bridges 2 intersections, so we can't remove
+				if (linen->m_object.m_i0==NULL || linen->m_object.m_i1==NULL)
+				{
+					removeLine(linen);
+					n++;
+					m++;
+				}
+			}
+			checkGraph(__LINE__);
+			if (n==0)
+				break;
+		}
+	}
+	return m;
+}
+
+static bool equivalentLines(const Line2 &line0, const Line2 &line1)
+{
+	return ((line0.m_p0.equals(line1.m_p0) && line0.m_p1.equals(line1.m_p1)) ||
+		(line0.m_p0.equals(line1.m_p1) && line0.m_p1.equals(line1.m_p0)));
+}
+
+static bool minAngleLines(const Line2 &line0, const Line2 &line1, const Point &p, uint32_t minAngle)
+{
+	Point p01, p11;
+	
+	if (p.equals(line0.m_p0))
+		p01 = line0.m_p1;
+	else
+		p01 = line0.m_p0;
+	if (p.equals(line1.m_p0))
+		p11 = line1.m_p1;
+	else
+		p11 = line1.m_p0;
+	
+	return (tanDiffAbs1000(p, p01, p, p11) <= minAngle);
+}
+
+uint16_t LineEngine::removeRedundantLinesIntersections()
+{
+	uint8_t i, j, n;
+	SimpleListNode<Intersection> *k;
+
+	for (k=m_intersectionsList.m_first, n=0; k!=NULL; k=k->m_next)
+	{
+		// perform n^2 search of lines within this intersection
+		for (i=0; i<k->m_object.m_n; i++)
+		{
+			for (j=i+1; j<k->m_object.m_n; j++)
+			{
+				// Check for equivalent lines...
+				if (equivalentLines(k->m_object.m_lines[i]->m_object, k->m_object.m_lines[j]->m_object))
+				{
+					removeLine(k->m_object.m_lines[j]);
+					n++;
+					j--; // list was shifted down, decrement so we don't skip an entry
+				}
+				// Check for lines with a small angle between them
+				else if (minAngleLines(k->m_object.m_lines[i]->m_object, k->m_object.m_lines[j]->m_object, k->m_object.m_p, m_maxEquivTanAngle))
+				{
+					// lines i and j have a small angle between them.  Which do we delete?  Which line is longer?  What if the shorter one is connected to another intersection?
+					// if i is longer than j
+					if (k->m_object.m_lines[i]->m_object.length2() > k->m_object.m_lines[j]->m_object.length2())
+					{
+						// remove line j, since it's shorter, unless it's connected...
+						if (k->m_object.m_lines[j]->m_object.m_i0==NULL || k->m_object.m_lines[j]->m_object.m_i1==NULL)
+						{
+							removeLine(k->m_object.m_lines[j]);
+							n++;
+							j--; // list was shifted down, decrement so we don't skip an entry
+						}
+						// otherwise remove line i, if it's not connected (we know that it's connected this intersection, so if it has at least 1 NULL intersection pointer...)
+						else if (k->m_object.m_lines[i]->m_object.m_i0==NULL || k->m_object.m_lines[i]->m_object.m_i1==NULL)
+						{
+							removeLine(k->m_object.m_lines[i]);
+							n++;
+							i--; // list was shifted down, decrement so we don't skip an entry
+							break; // then exit, since it affects our i-th index
+						}
+					}
+					else // Line j is longer than i
+					{
+						// remove line i, since it's shorter, unless it's connected... 
+						if (k->m_object.m_lines[i]->m_object.m_i0==NULL || k->m_object.m_lines[i]->m_object.m_i1==NULL)
+						{
+							removeLine(k->m_object.m_lines[i]);
+							n++;
+							i--; // list was shifted down, decrement so we don't skip an entry
+							break; // then exit, since it affects our i-th index
+						}
+						// otherwise remove line j, if it's not connected
+						else if (k->m_object.m_lines[j]->m_object.m_i0==NULL || k->m_object.m_lines[j]->m_object.m_i1==NULL)
+						{
+							removeLine(k->m_object.m_lines[j]);
+							n++;
+							j--; // list was shifted down, decrement so we don't skip an entry
+						}
+					}
+				}
+			}
+		}
+	}
+	checkGraph(__LINE__);
+	
+	return n;
+}
+
+uint16_t LineEngine::simplifyIntersections()
+{
+	uint16_t n;
+	SimpleListNode<Intersection> *j, *jnext;
+
+	checkGraph(__LINE__);
+
+	// look through intersections dealing with 0, 1 and 2-line intersections
+	for (j=m_intersectionsList.m_first, n=0; j!=NULL; j=jnext)
+	{
+		jnext = j->m_next;
+		if (j->m_object.m_n==0)
+		{
+			m_intersectionsList.remove(j);
+			checkGraph(__LINE__);
+			n++;
+		}
+		else if (j->m_object.m_n==1)
+		{
+			if (j->m_object.m_lines[0]->m_object.m_i0==j)
+				j->m_object.m_lines[0]->m_object.m_i0 = NULL;
+			if (j->m_object.m_lines[0]->m_object.m_i1==j)
+				j->m_object.m_lines[0]->m_object.m_i1 = NULL;
+			m_intersectionsList.remove(j);
+			checkGraph(__LINE__);
+			n++;
+		}
+		else if (j->m_object.m_n==2 && 
+			j->m_object.m_p.m_x>m_params.m_minLineLength && j->m_object.m_p.m_x<LINE_GRID_WIDTH-m_params.m_minLineLength && // do not simplify intersections that are
+			j->m_object.m_p.m_y>m_params.m_minLineLength && j->m_object.m_p.m_y<LINE_GRID_HEIGHT-m_params.m_minLineLength) // close to any edge because they don't look like intersections.
+		{
+			SimpleListNode<Line2> *linen0 = j->m_object.m_lines[0];
+			SimpleListNode<Line2> *linen1 = j->m_object.m_lines[1];
+			m_intersectionsList.remove(j);
+			if (linen0->m_object.m_i0==j)
+			{
+				if (linen1->m_object.m_i0==j)
+				{
+					// this case will lead to an intersection with two of the same line pointers, so get rid of linen1, proceed...
+					if (linen0->m_object.m_i1==linen1->m_object.m_i1 && linen1->m_object.m_i1!=NULL)
+					{
+						linen0->m_object.m_i0 = NULL;
+						removeLine(linen1);
+					}
+					else
+					{
+						linen0->m_object.m_p0 = linen1->m_object.m_p1;
+						linen0->m_object.m_i0 = linen1->m_object.m_i1;
+						replaceLine(linen0, linen1);
+					}
+				}
+				else
+				{
+					// this case will lead to an intersection with two of the same line pointers, so get rid of linen1, proceed...
+					if (linen0->m_object.m_i1==linen1->m_object.m_i0 && linen1->m_object.m_i0!=NULL)
+					{
+						linen0->m_object.m_i0 = NULL;
+						removeLine(linen1);
+					}
+					else
+					{
+						linen0->m_object.m_p0 = linen1->m_object.m_p0;
+						linen0->m_object.m_i0 = linen1->m_object.m_i0;
+						replaceLine(linen0, linen1);
+					}
+				}
+			}
+			else
+			{
+				if (linen1->m_object.m_i0==j)
+				{
+					// this case will lead to an intersection with two of the same line pointers, so get rid of linen1, proceed...
+					if (linen0->m_object.m_i0==linen1->m_object.m_i1 && linen1->m_object.m_i1!=NULL)
+					{
+						linen0->m_object.m_i1 = NULL;
+						removeLine(linen1);
+					}
+					else
+					{
+						linen0->m_object.m_p1 = linen1->m_object.m_p1;
+						linen0->m_object.m_i1 = linen1->m_object.m_i1;
+						replaceLine(linen0, linen1);
+					}
+				}
+				else
+				{
+					// this case will lead to an intersection with two of the same line pointers, so get rid of linen1, proceed...
+					if (linen0->m_object.m_i0==linen1->m_object.m_i0 && linen1->m_object.m_i0!=NULL)
+					{
+						linen0->m_object.m_i1 = NULL;
+						removeLine(linen1);
+					}
+					else
+					{
+						linen0->m_object.m_p1 = linen1->m_object.m_p0;
+						linen0->m_object.m_i1 = linen1->m_object.m_i0;
+						replaceLine(linen0, linen1);
+					}
+				}
+			}
+			checkGraph(__LINE__);
+			n++;
+		}
+	}
+	return n;
+}
+
+void LineEngine::cleanIntersections()
+{
+	uint16_t n;
+	
+	while(1)
+	{
+		n = 0;
+		n += removeShortLinesIntersections(); 
+		n += removeRedundantLinesIntersections();
+		n += simplifyIntersections();
+		
+		if (n==0)
+			break;
+	}
+}
+
+void LineEngine::removeMinLines(uint16_t minLineLength)
+{
+	SimpleListNode<Line2> *i, *inext;
+		
+	for (i=m_linesList.m_first; i!=NULL; i=inext)
+	{
+		inext = i->m_next; // remove() hands i back to the pool, which reuses m_next
+		if (i->m_object.length2()<minLineLength && i->m_object.m_i0==NULL && i->m_object.m_i1==NULL)
+			m_linesList.remove(i);
+	}
+}
+
+
+
+int16_t LineEngine::voteCodes(BarCodeCluster *cluster)
+{
+    uint16_t i, max, maxIndex=0;
+
+	if (cluster->m_n<=1)
+		return -1;
+	
+    // find winner, the votes were tallied as the codes were added to the cluster
+    for (i=0, max=0; i<LINE_MMC_VTSIZE; i++)
+    {
+        if (cluster->m_votes[i]==0) // we've reached end
+            break;
+        if (cluster->m_votes[i]>max)
+        {
+            max = cluster->m_votes[i];
+            maxIndex = i;
+        }
+    }
+
+    if (max<=1) // no valid codes, and you need at least 2 votes
+        return -2;
+	if ((max<<8)/cluster->m_n<m_minVotingThreshold)
+		return -3;
+    return cluster->m_vals[maxIndex];
+}
+
+static uint32_t dist2_4(const Point16 &p0, const Point16 &p1)
+{
+		int32_t diffx, diffy;
+		
+		diffx = p1.m_x - p0.m_x;
+		diffy = (p1.m_y - p0.m_y)*4;
+		
+		return diffx*diffx + diffy*diffy;	
+}
+
+// Candidates arrive in row order, so we cluster them as they're detected instead of keeping them 
+// until the end of the frame.  A candidate joins the first cluster whose last candidate is close by.  
+// There are at most LINE_MMC_VOTED_BARCODES clusters, so we just look at all of them.
+void LineEngine::clusterCode(const BarCode *bc)
+{
+    uint8_t j;
+    int32_t dist;
+
+    for (j=0; j<m_barcodeClusterIndex; j++)
+    {
+        dist = dist2_4 (bc->m_p0, m_barcodeClusters[j].m_p1);
+        if (dist<m_maxCodeDist)
+            break;
+    }
+    if (j>=LINE_MMC_VOTED_BARCODES) // table is full, move onto next code
+        return;
+    if (j>=m_barcodeClusterIndex) // new entry
+    {
+        m_barcodeClusters[j].reset();
+        // reset positions
+        m_barcodeClusters[j].m_p0 = bc->m_p0;
+        m_barcodeClusters[j].m_p1 = bc->m_p0;
+        m_barcodeClusterIndex++;
+    }
+    //cprintf(" add %d, %d %d %d %d", j, bc->m_p0.m_x, bc->m_p0.m_y,
+     //      m_barcodeClusters[j].m_p1.m_x, m_barcodeClusters[j].m_p1.m_y);
+    m_barcodeClusters[j].addCode(bc->m_val);
+    // update width, position
+    m_barcodeClusters[j].updateWidth(bc->m_width);
+    m_barcodeClusters[j].m_p1 = bc->m_p0;
+}
+
+void LineEngine::clusterCodes()
+{
+    uint8_t i;
+    int16_t val;
+    BarCodeCluster *cluster;
+
+#if 0
+	for (i=0; i<m_barcodeClusterIndex; i++)
+		cprintf(0, "%d: %d %d %d %d\n", i, m_barcodeClusters[i].m_p0.m_x, m_barcodeClusters[i].m_p0.m_y, m_barcodeClusters[i].m_p1.m_x, m_barcodeClusters[i].m_p1.m_y);
+#endif
+    // vote
+    for (i=0, m_votedBarcodeIndex=0; i<m_barcodeClusterIndex; i++)
+    {
+        if (m_votedBarcodeIndex>=LINE_MMC_VOTED_BARCODES)
+            break; // out of table space
+        cluster = &m_barcodeClusters[i];
+        val = voteCodes(cluster);
+        if (val<0)
+            continue;
+        m_votedBarcodes[m_votedBarcodeIndex].m_val = val;
+        m_votedBarcodes[m_votedBarcodeIndex].m_outline.m_xOffset = cluster->m_p0.m_x + m_params.m_edgeDist;
+        m_votedBarcodes[m_votedBarcodeIndex].m_outline.m_yOffset = cluster->m_p0.m_y;
+        m_votedBarcodes[m_votedBarcodeIndex].m_outline.m_width = cluster->m_width + 1;
+        m_votedBarcodes[m_votedBarcodeIndex].m_outline.m_height = cluster->m_p1.m_y - cluster->m_p0.m_y + 1;
+		m_votedBarcodes[m_votedBarcodeIndex].m_tracker = NULL;
+        m_votedBarcodeIndex++;
+    }
+
+	
+#if 0
+    for (i=0; i<m_votedBarcodeIndex; i++)
+	cprintf(0, "%d: %d, %d %d %d %d", i, m_votedBarcodes[i].m_val,
+               m_votedBarcodes[i].m_outline.m_xOffset, m_votedBarcodes[i].m_outline.m_yOffset,
+               m_votedBarcodes[i].m_outline.m_width, m_votedBarcodes[i].m_outline.m_height);
+#endif
+}
+
+static int32_t decodeCode(BarCode *bc, uint16_t dec)
+{
+    uint8_t i, bits;
+    uint16_t val, bit, width, minWidth, maxWidth;
+    bool flag;
+
+    for (i=1, bits=0, val=0, flag=false, minWidth=0xffff, maxWidth=0; i<bc->m_n && bits<LINE_MMC_BITS; i++)
+    {
+        bit = bc->m_edges[i]&EQ_NEGATIVE;
+        if ((bit==0 && (i&1)) || (bit && (i&1)==0))
+            return -1;
+
+        width = bc->m_edges[i]&~EQ_NEGATIVE;
+        if (width<minWidth)
+            minWidth = width;
+        if (width>maxWidth)
+            maxWidth = width;
+        if (width<dec)
+        {
+            if (flag)
+            {
+                val <<= 1;
+                if (bit==0)
+                    val |= 1;
+                bits++;
+                flag = false;
+            }
+            else
+                flag = true;
+        }
+        else if (flag) // wide with flag, must be error
+            return 0;
+        else // wide
+        {
+            val <<= 1;
+            if (bit==0)
+                val |= 1;
+            bits++;
+        }
+    }
+    if (bits!=LINE_MMC_BITS)
+        return 0;
+    if (maxWidth/minWidth>10)
+        return -2;
+    bc->m_val = val;
+    return 1;
+}
+
+#define SORT2(a, b)  if ((a)>(b)) {uint8_t t=(a); (a)=(b); (b)=t;}
+
+// sorts LINE_MMC_MAX_EDGES (10) widths with a fixed sorting network, 29 compare-exchanges  
+static void sortEdges(uint8_t *e)
+{
+#if LINE_MMC_MAX_EDGES!=10
+#error "sortEdges() needs a sorting network for LINE_MMC_MAX_EDGES"
+#endif
+	SORT2(e[0], e[8]); SORT2(e[1], e[9]); SORT2(e[2], e[7]); SORT2(e[3], e[5]); SORT2(e[4], e[6]);
+	SORT2(e[0], e[2]); SORT2(e[1], e[4]); SORT2(e[5], e[8]); SORT2(e[7], e[9]);
+	SORT2(e[0], e[3]); SORT2(e[2], e[4]); SORT2(e[5], e[7]); SORT2(e[6], e[9]);
+	SORT2(e[0], e[1]); SORT2(e[3], e[6]); SORT2(e[8], e[9]);
+	SORT2(e[1], e[5]); SORT2(e[2], e[3]); SORT2(e[4], e[8]); SORT2(e[6], e[7]);
+	SORT2(e[1], e[2]); SORT2(e[3], e[5]); SORT2(e[4], e[6]); SORT2(e[7], e[8]);
+	SORT2(e[2], e[3]); SORT2(e[4], e[5]); SORT2(e[6], e[7]);
+	SORT2(e[3], e[4]); SORT2(e[5], e[6]);
+}
+
+static bool decodeCode(BarCode *bc)
+{
+    int32_t res;
+	uint8_t edges[LINE_MMC_MAX_EDGES];
+	uint8_t i, gap, maxGap, threshold;
+	
+	// copy edges, pad the unused entries so they sort to the end
+	for (i=0; i<bc->m_n; i++)
+		edges[i] = bc->m_edges[i];
+	for (; i<LINE_MMC_MAX_EDGES; i++)
+		edges[i] = 0xff;
+	
+	// sort 
+	sortEdges(edges);
+	
+	// find biggest gap
+	for (i=0, maxGap=0; i<bc->m_n-1; i++)
+	{
+		gap = edges[i+1] - edges[i];
+		if (gap>maxGap)
+		{
+			maxGap = gap;
+			threshold = (edges[i+1] + edges[i])>>1;
+		}
+	}
+	
+	// is the biggest gap big enough?
+	// It needs to be at least a quarter of the smallest gap
+	if (maxGap < (edges[0]>>2) + 1)
+		threshold = edges[bc->m_n-1] + 1;  // it's not big enough, make threshold outside our gap range
+	
+    res = decodeCode(bc, threshold);
+    if (res==1)
+		return true;
+    else // error
+		return false;
+}
+
+
+static bool detectCode(const uint16_t *edges, uint16_t len, bool begin, BarCode *bc)
+{
+    uint16_t col00, col0, col1, col01, width0, width, qWidth;
+    uint8_t e;
+
+    col00 = edges[0]&~EQ_NEGATIVE;
+    col01 = edges[1]&~EQ_NEGATIVE;
+    width0 = col01 - col00;
+    qWidth = width0<<2; // use to calc front-porch and back-porch
+
+    // check front quiet period
+    if (!begin)
+    {
+        width = col00 - (edges[-1]&~EQ_NEGATIVE);
+        if (width<qWidth)
+            return false;
+    }
+
+
+    // first determine if we have enough edges
+    for (e=0, bc->m_n=0; e<len-1; e++)
+    {
+        if  (e>=LINE_MMC_MAX_EDGES)
+            return false; // too many edges for valid code
+        col0 = edges[e]&~EQ_NEGATIVE;
+        // correct
+        //if ((edges[e]&EQ_NEGATIVE)==0)
+        //    col0--;
+        col1 = edges[e+1]&~EQ_NEGATIVE;
+
+        width = col1 - col0;
+        if (width>qWidth) // back-porch?
+            break;
+        // save edge
+        bc->m_edges[e] = width | (edges[e+1]&EQ_NEGATIVE);
+        bc->m_n++;
+        bc->m_width = col1 - col00;
+    }
+
+    if (e<LINE_MMC_MIN_EDGES-1)
+        return false; // too few edges
+
+    bc->m_p0.m_x = col00;
+    return true;
+}
+
+void LineEngine::detectCodes(uint8_t row, const uint16_t *edges, uint32_t len)
+{
+	bool res;
+	bool begin;
+	uint16_t j, k, bit0, bit1;
+    BarCode *bc = &m_barcode;
+
+	if (len<LINE_MMC_MIN_EDGES)
+		return;
+
+	for (j=0, begin=true, k=0; j<len-1 && edges[j]<EQ_HSCAN_LINE_START && edges[j+1]<EQ_HSCAN_LINE_START; j++, begin=false, k++)
+	{
+		bit0 = edges[j]&EQ_NEGATIVE;
+		bit1 = edges[j+1]&EQ_NEGATIVE;
+		if (bit0!=0 && bit1==0 && len>=LINE_MMC_MIN_EDGES-1+k)
+        {
+			bc->m_p0.m_y = row;
+
+			if (detectCode(&edges[j], len-j, begin, bc))
+			{
+                if (m_barcodeIndex>=LINE_MMC_CANDIDATE_BARCODES)
+					return;
+				res = decodeCode(bc);
+#if 0
+                cprintf(0, "%d %d: %d %d: %d, %d %d %d %d %d %d %d %d %d", bc->m_p0.m_x, bc->m_p0.m_y, res, bc->m_val,
+                           bc->m_n, bc->m_edges[0]&~EQ_NEGATIVE, bc->m_edges[1]&~EQ_NEGATIVE, bc->m_edges[2]&~EQ_NEGATIVE, bc->m_edges[3]&~EQ_NEGATIVE, bc->m_edges[4]&~EQ_NEGATIVE,
+                            bc->m_edges[5]&~EQ_NEGATIVE, bc->m_edges[6]&~EQ_NEGATIVE, bc->m_edges[7]&~EQ_NEGATIVE, bc->m_edges[8]&~EQ_NEGATIVE);
+#endif
+				if (res)
+				{
+					clusterCode(bc);
+					m_barcodeIndex++;
+				}
+			}
+		}
+	}
+}
+
+
+void LineEngine::renderGrid()
+{
+	uint8_t i, j;
+	LineGridNode node;
+	
+	for (i=0; i<LINE_GRID_HEIGHT; i++)
+	{
+		for (j=0; j<LINE_GRID_WIDTH; j++)
+		{
+			node = LINE_GRID_LINE(j, i);
+			if (LINE_GRID_TEST(m_gridHLine, j, i))
+				node |= LINE_NODE_FLAG_HLINE;
+			if (LINE_GRID_TEST(m_gridVLine, j, i))
+				node |= LINE_NODE_FLAG_VLINE;
+			if ((node&LINE_NODE_FLAG_1) && !LINE_GRID_OPEN(j, i))
+				node |= LINE_NODE_FLAG_NULL;
+			m_lineGrid[LINE_GRID_INDEX(j, i)] = node;
+		}
+	}
+}
+
+void LineEngine::clearGrid(const RectB rect)
+{
+	uint8_t i, j;
+	uint16_t height;
+	int16_t r0;
+	
+	height = rect.m_bottom - rect.m_top;
+	height *= 4;
+	
+	
+	r0 = rect.m_top-height;
+	if (r0<0)
+		r0 = 0;
+	for (i=r0; i<=rect.m_bottom; i++)
+	{
+		for (j=rect.m_left; j<=rect.m_right; j++)
+		{
+			LINE_GRID_CLEAR(m_gridHLine, j, i);
+			LINE_GRID_CLEAR(m_gridVLine, j, i);
+			LINE_GRID_CLEAR(m_gridOpen, j, i);
+		}
+	}
+}
+
+void LineEngine::clearGrid()
+{
+	// remove edges 
+	int16_t val, i;
+	uint16_t v, h;
+	RectB rect;
+	
+	for (i=0; i<m_votedBarcodeIndex; i++)
+	{
+		h = LINE_MMC_HBOUNDARY*m_votedBarcodes[i].m_outline.m_width;
+		if (h>>LINE_GRID_WIDTH_REDUCTION==0)
+			h = 1<<LINE_GRID_WIDTH_REDUCTION; // ensure minimum of 1 pixel in grid
+		v = LINE_MMC_VBOUNDARY*m_votedBarcodes[i].m_outline.m_height;
+		if (v>>LINE_GRID_HEIGHT_REDUCTION==0)
+			v = 1<<LINE_GRID_HEIGHT_REDUCTION; // ensure minimum of 1 pixel in grid
+		
+		val = (m_votedBarcodes[i].m_outline.m_xOffset - h)>>LINE_GRID_WIDTH_REDUCTION;
+		if (val<0)
+			val = 0;
+		rect.m_left = val;
+		
+		val = (m_votedBarcodes[i].m_outline.m_xOffset + m_votedBarcodes[i].m_outline.m_width + h)>>LINE_GRID_WIDTH_REDUCTION;
+		if (val>=LINE_GRID_WIDTH)
+			val = LINE_GRID_WIDTH-1;
+		rect.m_right = val;
+		
+		val = (m_votedBarcodes[i].m_outline.m_yOffset - v)>>LINE_GRID_HEIGHT_REDUCTION;
+		if (val<0)
+			val = 0;
+		rect.m_top = val;
+		
+		val = (m_votedBarcodes[i].m_outline.m_yOffset + m_votedBarcodes[i].m_outline.m_height + v)>>LINE_GRID_HEIGHT_REDUCTION;
+		if (val>=LINE_GRID_HEIGHT)
+			val = LINE_GRID_HEIGHT-1;
+		rect.m_bottom = val;
+		
+		clearGrid(rect); 
+	}	
+}
+
+
+uint32_t LineEngine::compareLines(const Line2 &line0, const Line2 &line1)
+{
+	uint16_t d0, d1, d2, d3, da, db;
+	uint32_t angle, df;
+	
+	d0 = line0.m_p0.dist2(line1.m_p0);
+	d1 = line0.m_p0.dist2(line1.m_p1);
+	d2 = line0.m_p1.dist2(line1.m_p0);
+	d3 = line0.m_p1.dist2(line1.m_p1);
+	
+	da = MIN(d0, d1);
+	db = MIN(d2, d3);
+	
+	df = da+db;
+	
+	// compare to max line distance
+	if (df>m_params.m_maxLineCompare)
+		return TR_MAXVAL;
+
+	// test angle
+	angle = tanDiffAbs1000(line0.m_p0, line0.m_p1, line1.m_p0, line1.m_p1, true);
+	if (angle>m_maxTrackingTanAngle)
+		return TR_MAXVAL;
+		
+	return da+db;
+}
+
+void LineEngine::indexTrackingLines()
+{
+	SimpleListNode<Line2> *j;
+	uint16_t e;
+	uint8_t c;
+	
+	memset(m_cells, 0xff, sizeof(m_cells));
+	for (j=m_linesList.m_first, e=0; j!=NULL && e<LINE_MAX_LINES*2; j=j->m_next, e+=2)
+	{
+		m_trackLines[e>>1] = &j->m_object;
+		c = LINE_CELL_P(j->m_object.m_p0);
+		m_cellNext[e] = m_cells[c];
+		m_cells[c] = e;
+		c = LINE_CELL_P(j->m_object.m_p1);
+		m_cellNext[e+1] = m_cells[c];
+		m_cells[c] = e+1;
+	}
+}
+
+// Find the line that best matches the tracker.  We only look at lines with an endpoint in the cells within 
+// m_trackRadius of the tracker's first endpoint, instead of comparing against every line.  Lines farther 
+// away than that fail compareLines() anyway, so the result is the same.  Ties go to the line that comes 
+// first in m_linesList, as before.
+Line2 *LineEngine::findTrackingLine(Tracker<Line2> *tracker, bool priority, uint32_t *min)
+{
+	int16_t x, y, x0, y0, x1, y1;
+	uint16_t e;
+	uint8_t seq, minSeq=0;
+	uint32_t val, visited[LINE_MAX_LINES/32];
+	Line2 *minLine=NULL;
+	
+	memset(visited, 0, sizeof(visited));
+	*min = TR_MAXVAL;
+	x0 = LINE_CELL_X(MAX(tracker->m_object.m_p0.m_x-m_trackRadius, 0));
+	y0 = LINE_CELL_Y(MAX(tracker->m_object.m_p0.m_y-m_trackRadius, 0));
+	x1 = LINE_CELL_X(tracker->m_object.m_p0.m_x+m_trackRadius);
+	y1 = LINE_CELL_Y(tracker->m_object.m_p0.m_y+m_trackRadius);
+	for (y=y0; y<=y1; y++)
+	{
+		for (x=x0; x<=x1; x++)
+		{
+			for (e=m_cells[LINE_CELL(x, y)]; e!=LINE_CELL_NONE; e=m_cellNext[e])
+			{
+				seq = e>>1;
+				if (visited[seq>>5]&LINE_GRID_BIT(seq)) // we've seen the other endpoint already
+					continue;
+				visited[seq>>5] |= LINE_GRID_BIT(seq);
+				val = compareLines(tracker->m_object, *m_trackLines[seq]);
+				if (val==TR_MAXVAL)
+					continue;
+				if (!priority) 
+					val <<= 12; // we scale up by 4096 because this exceeds pretty much all possible compare values due to geometry
+				// find minimum, but if line is already chosen, make sure we're a better match
+				if ((val<*min || (val==*min && seq<minSeq)) && tracker->swappable(val, m_trackLines[seq]))
+				{
+					*min = val;
+					minSeq = seq;
+					minLine = m_trackLines[seq];
+				}
+			}
+		}
+	}
+	return minLine;
+}
+
+uint16_t LineEngine::handleLineTracking2()
+{
+	uint32_t min;
+	uint16_t n=0;
+	SimpleListNode<Tracker<Line2> > *i;
+	uint8_t k;
+	Line2 *minLine;
+	bool priority;
+	
+	// go through list, find best candidates
+	for (i=m_lineTrackersList.m_first; i!=NULL; i=i->m_next)
+	{
+		// calculate priority -- primary lines and lines in the primary intersection
+		priority = false;
+		if (m_primaryActive && m_primaryLineIndex==i->m_object.m_index)
+			priority = true;
+		else if (m_primaryIntersection.m_state!=TR_INVALID)
+		{
+			for (k=0; k<m_primaryIntersection.m_object.m_n; k++)
+			{
+				if (m_primaryIntersection.m_object.m_lines[k].m_index==i->m_object.m_index)
+				{
+					priority = true;
+					break;
+				}
+			}
+		}
+		// already found minimum, continue
+		if (i->m_object.m_minVal!=TR_MAXVAL)
+			continue;
+		
+		// find min
+		minLine = findTrackingLine(&i->m_object, priority, &min);
+		if (minLine)
+		{
+			// if this minimum line already has a tracker, see which is better
+			if (minLine->m_tracker)
+			{
+				minLine->m_tracker->resetMin(); // reset tracker pointed to by current minline
+				minLine->m_tracker = &i->m_object; 
+				i->m_object.setMin(minLine, min);
+				n++;
+			}
+			else
+			{
+				minLine->m_tracker = &i->m_object; // update tracker pointer			
+				i->m_object.setMin(minLine, min);
+				n++;
+			}
+		}
+	}
+	return n;
+}
+
+
+void LineEngine::handleLineTracking()
+{
+	SimpleListNode<Tracker<Line2> > *i, *inext;
+	SimpleListNode<Line2> *j;
+	uint16_t leading, trailing;
+	
+	// reset tracking table
+	// Note, we don't need to reset m_linesList entries (e.g. m_tracker) because these are renewed  
+	for (i=m_lineTrackersList.m_first; i!=NULL; i=i->m_next)
+		i->m_object.resetMin();
+	
+	// do search, find minimums
+	indexTrackingLines();
+	while(handleLineTracking2());
+	
+	// go through, update tracker, remove entries that are no longer valid
+	for (i=m_lineTrackersList.m_first; i!=NULL; i=inext)
+	{
+		inext = i->m_next;
+		
+		if (i->m_object.update()&TR_EVENT_INVALIDATED)
+			m_lineTrackersList.remove(i); // no longer valid?  remove from tracker list
+	}	
+	
+	// find new candidates
+	for (j=m_linesList.m_first; j!=NULL; j=j->m_next)
+	{
+		if (j->m_object.m_tracker==NULL)
+		{
+			SimpleListNode<Tracker<Line2> > *n;
+			leading = m_params.m_lineFiltering*LINE_FILTERING_MULTIPLIER;
+			trailing = (leading+1)>>1;
+			n = m_lineTrackersList.add(Tracker<Line2>(j->m_object, m_lineTrackerIndex++, leading, trailing));
+			if (n==NULL)
+			{
+				cprintf(0, "hlt\n");
+				break;
+			}
+			j->m_object.m_tracker = &n->m_object; // point back to tracker
+		}
+	}
+	if (m_debug&LINE_DEBUG_TRACKING)
+	{
+		uint8_t n;
+		cprintf(0, "Trackers\n");
+		for (i=m_lineTrackersList.m_first, n=0; i!=NULL; i=i->m_next, n++)
+			cprintf(0, "   %d: %d %d (%d %d)(%d %d)\n", n, i->m_object.m_index, i->m_object.m_state, 
+			i->m_object.m_object.m_p0.m_x, i->m_object.m_object.m_p0.m_y, i->m_object.m_object.m_p1.m_x, i->m_object.m_object.m_p1.m_y);
+	}
+}
+
+static uint32_t compareBarCodes(const DecodedBarCode &c0, const DecodedBarCode &c1)
+{
+	int32_t x, y;
+	
+	// different values are different
+	if (c0.m_val!=c1.m_val)
+		return TR_MAXVAL;
+	
+	// find distance between 
+	x = c0.m_outline.m_xOffset + (c0.m_outline.m_width>>1);
+	y = c0.m_outline.m_yOffset + (c0.m_outline.m_height>>1);
+	x -= c1.m_outline.m_xOffset + (c1.m_outline.m_width>>1);
+	y -= c1.m_outline.m_yOffset + (c1.m_outline.m_height>>1);
+	
+	return x*x + y*y; 
+}
+
+uint16_t LineEngine::handleBarCodeTracking2()
+{
+	uint32_t val, min;
+	uint16_t n=0;
+	SimpleListNode<Tracker<DecodedBarCode> > *i;
+	uint8_t j;
+	DecodedBarCode *minCode;
+	
+	// go through list, find best candidates
+	for (i=m_barCodeTrackersList.m_first; i!=NULL; i=i->m_next)
+	{
+		// already found minimum, continue
+		if (i->m_object.m_minVal!=TR_MAXVAL)
+			continue;
+		
+		// find min
+		for (j=0, min=TR_MAXVAL, minCode=NULL; j<m_votedBarcodeIndex; j++)
+		{
+			val = compareBarCodes(i->m_object.m_object, m_votedBarcodes[j]);
+			// find minimum, but if line is already chosen, make sure we're a better match
+			if (val<min && i->m_object.swappable(val, &m_votedBarcodes[j]))
+			{
+				min = val;
+				minCode = &m_votedBarcodes[j];
+			}
+		}
+		if (minCode)
+		{
+			// if this minimum line already has a tracker, see which is better
+			if (minCode->m_tracker)
+			{
+				minCode->m_tracker->resetMin(); // reset tracker pointed to by current minline
+				minCode->m_tracker = &i->m_object; 
+				i->m_object.setMin(minCode, min);
+				n++;
+			}
+			else
+			{
+				minCode->m_tracker = &i->m_object; // update tracker pointer			
+				i->m_object.setMin(minCode, min);
+				n++;
+			}
+		}
+	}
+	return n;
+}
+
+void LineEngine::handleBarCodeTracking()
+{
+	SimpleListNode<Tracker<DecodedBarCode> > *i, *inext;
+	uint8_t j;
+	uint16_t leading, trailing;
+	
+	// reset tracking table
+	// Note, we don't need to reset m_linesList entries (e.g. m_tracker) because these are renewed  
+	for (i=m_barCodeTrackersList.m_first; i!=NULL; i=i->m_next) 
+		i->m_object.resetMin();
+	
+	// do search, find minimums
+	while(handleBarCodeTracking2());
+	
+	// go through, update tracker, remove entries that are no longer valid
+	for (i=m_barCodeTrackersList.m_first; i!=NULL; i=inext)
+	{
+		inext = i->m_next;
+		
+		if (i->m_object.update()&TR_EVENT_INVALIDATED)
+			m_barCodeTrackersList.remove(i); // no longer valid?  remove from tracker list
+	}	
+	
+	// find new candidates
+	for (j=0; j<m_votedBarcodeIndex; j++)
+	{
+		if (m_votedBarcodes[j].m_tracker==NULL)
+		{
+			SimpleListNode<Tracker<DecodedBarCode> > *n;
+			leading = m_params.m_barcodeFiltering*LINE_FILTERING_MULTIPLIER;
+			trailing = (leading+1)>>1;
+			n = m_barCodeTrackersList.add(Tracker<DecodedBarCode>(m_votedBarcodes[j], m_barCodeTrackerIndex++, leading, trailing));
+			if (n==NULL)
+			{
+				cprintf(0, "hlt\n");
+				break;
+			}
+			m_votedBarcodes[j].m_tracker = &n->m_object; // point back to tracker
+		}
+	}
+	if (m_debug&LINE_DEBUG_TRACKING)
+	{
+		uint8_t n;
+		cprintf(0, "Barcodes\n");
+		for (i=m_barCodeTrackersList.m_first, n=0; i!=NULL; i=i->m_next, n++)
+			cprintf(0, "   %d: %d %d %d (%d %d %d %d)\n", n, i->m_object.m_index, i->m_object.m_state, i->m_object.m_object.m_val,
+			i->m_object.m_object.m_outline.m_height, i->m_object.m_object.m_outline.m_width, 
+			i->m_object.m_object.m_outline.m_xOffset, i->m_object.m_object.m_outline.m_yOffset);
+	}
+}
+
+Line2 *LineEngine::findLine(uint8_t index)
+{
+	SimpleListNode<Line2> *i;
+	
+	for (i=m_linesList.m_first; i!=NULL; i=i->m_next)
+	{
+		if (i->m_object.m_tracker && i->m_object.m_tracker->m_index==index)
+			return &i->m_object;
+	}
+	return NULL;
+}
+
+
+Line2 *LineEngine::findTrackedLine(uint8_t index)
+{
+	SimpleListNode<Tracker<Line2> > *i;
+	
+	for (i=m_lineTrackersList.m_first; i!=NULL; i=i->m_next)
+	{
+		if (i->m_object.m_index==index)
+			return &i->m_object.m_object;
+	}
+	return NULL;
+}
+
+uint8_t LineEngine::trackedLinesWithPoint(const Point &p)
+{
+	uint8_t n;
+	Line2 *line;
+	
+	SimpleListNode<Tracker<Line2> > *i;
+	
+	for (i=m_lineTrackersList.m_first, n=0; i!=NULL; i=i->m_next)
+	{
+		line = &i->m_object.m_object;
+		if (line && (line->m_p0.equals(p) || line->m_p1.equals(p))) 
+			n++;
+	}
+	return n;
+}
+
+static bool compareIntersections(const Intersection &i0, const FrameIntersection &i1)
+{
+#if 0
+	uint8_t i, n;
+	
+	// count valid lines
+	for (i=0, n=0; i<i0.m_n; i++)
+	{
+		if (i0.m_lines[i]->m_object.m_tracker && i0.m_lines[i]->m_object.m_tracker->get()!=NULL)
+			n++;
+	}
+	
+	// are valid lines in i0 equal to number of lines in i1?
+	return n==i1.m_n;
+#else
+	return i0.m_n==i1.m_n;
+#endif
+}
+
+static int16_t getAngle(const Line2 &line, const Point &p)
+{
+	float x, y;
+	int16_t xdiff, ydiff, res;
+	
+	// find diff's using the point that's not p
+	// Note that y axis is pointing down, so we invert.
+	if (p.equals(line.m_p0)) 
+	{
+		xdiff = line.m_p1.m_x - p.m_x;
+		ydiff = p.m_y - line.m_p1.m_y;
+	}
+	else
+	{
+		xdiff = line.m_p0.m_x - p.m_x;
+		ydiff = p.m_y - line.m_p0.m_y;
+	}
+	// rotate axes 90 degrees so 0 is pointing straight up
+	x = ydiff;
+	y = -xdiff;
+	
+	res = (int16_t)(atan2(y, x)*180/(float)M_PI);
+	
+	return res;
+}
+
+static int compareAngle(const void *a, const void *b)
+{
+  return (((FrameIntersectionLine *)a)->m_angle - ((FrameIntersectionLine *)b)->m_angle );
+}
+
+static void formatIntersection(const Intersection &intersection, FrameIntersection *fintersection, bool tracked)
+{
+	uint8_t i, j;
+		
+	for (i=0, j=0; i<intersection.m_n && j<LINE_MAX_FRAME_INTERSECTION_LINES; i++)
+	{
+		// only add valid lines to fintersection
+		if (!tracked || intersection.m_lines[i]->m_object.m_tracker)// && intersection.m_lines[i]->m_object.m_tracker->get()!=NULL))
+		{	
+			if (tracked)
+				fintersection->m_lines[j].m_index = intersection.m_lines[i]->m_object.m_tracker->m_index;
+			else
+				fintersection->m_lines[j].m_index = 0;				
+			fintersection->m_lines[j].m_angle = getAngle(intersection.m_lines[i]->m_object, intersection.m_p);   
+			fintersection->m_lines[j].m_reserved = 0;
+			j++;
+		}
+	}
+	// zero-out rest of lines
+	for (i=j; i<LINE_MAX_FRAME_INTERSECTION_LINES; i++)
+	{	
+		fintersection->m_lines[i].m_index = 0;
+		fintersection->m_lines[i].m_angle = 0;   
+		fintersection->m_lines[i].m_reserved = 0;
+	}
+	
+	fintersection->m_x = intersection.m_p.m_x;
+	fintersection->m_y = intersection.m_p.m_y;
+	fintersection->m_n = j;
+	fintersection->m_reserved = 0;
+	
+	// sort lines based on angles
+	qsort(fintersection->m_lines, fintersection->m_n, sizeof(FrameIntersectionLine), compareAngle);
+}
+
+
+uint8_t LineEngine::updatePrimaryIntersection(SimpleListNode<Intersection> *intern)
+{
+	FrameIntersection fint;
+	
+	m_primaryIntersection.resetMin();
+	
+	if (intern && 
+		intern->m_object.m_p.m_y>m_params.m_minLineLength*1.4 && // only consider intersections that are sufficiently far from the top
+		intern->m_object.m_p.m_y<LINE_GRID_HEIGHT-m_params.m_minLineLength*1.4) // and bottom
+	{
+		if (m_primaryIntersection.m_state==TR_INVALID || compareIntersections(intern->m_object, m_primaryIntersection.m_object))
+		{
+			formatIntersection(intern->m_object, &fint, true);
+			m_primaryIntersection.setMin(&fint, 0);
+		}
+	}
+		
+	return m_primaryIntersection.update();
+}
+
+#if 0
+void LineEngine::updatePrimaryPoint(const Line2 &primary)
+{
+	m_primaryActive = primary.m_tracker->get()!=NULL;
+	
+	if (xdirection(primary.m_p0, primary.m_p1))
+	{
+		if (((LINE_HT_LEFT | LINE_HT_RIGHT)&m_primaryPointMap)==0)
+		{
+			if (m_primaryPointMap&LINE_HT_UP)
+			{
+				if (primary.m_p0.m_y < primary.m_p1.m_y) // p0 is primary
+				{
+					if (primary.m_p0.m_x < primary.m_p1.m_x) 
+						m_primaryPointMap |= LINE_HT_LEFT;
+					else // p0 > p1
+						m_primaryPointMap |= LINE_HT_RIGHT;					
+				}
+				else // p1 is primary
+				{
+					if (primary.m_p1.m_x < primary.m_p0.m_x) 
+						m_primaryPointMap |= LINE_HT_LEFT;
+					else // p1 > p0
+						m_primaryPointMap |= LINE_HT_RIGHT;					
+				}
+			}
+			else // m_primaryPointMap&LINE_HT_DOWN
+			{
+				if (primary.m_p0.m_y > primary.m_p1.m_y) // p0 is primary 
+				{
+					if (primary.m_p0.m_x < primary.m_p1.m_x) 
+						m_primaryPointMap |= LINE_HT_LEFT;
+					else // p0 > p1
+						m_primaryPointMap |= LINE_HT_RIGHT;					
+				}
+				else // p1 is primary
+				{
+					if (primary.m_p1.m_x < primary.m_p0.m_x) 
+						m_primaryPointMap |= LINE_HT_LEFT;
+					else // p1 > p0
+						m_primaryPointMap |= LINE_HT_RIGHT;					
+				}
+			}
+		}
+		if (m_primaryPointMap&LINE_HT_LEFT)
+		{
+			if (primary.m_p0.m_x < primary.m_p1.m_x) // p0 is primary 
+			{
+				m_primaryPoint = primary.m_p0;
+				m_goalPoint = primary.m_p1;
+			}
+			else // p1 is primary
+			{
+				m_primaryPoint = primary.m_p1;
+				m_goalPoint = primary.m_p0;
+			}
+		}
+		else // m_primaryPointMap&LINE_HT_RIGHT
+		{
+			if (primary.m_p0.m_x > primary.m_p1.m_x) // p0 is primary 
+			{
+				m_primaryPoint = primary.m_p0;
+				m_goalPoint = primary.m_p1;
+			}
+			else // p1 is primary
+			{
+				m_primaryPoint = primary.m_p1;
+				m_goalPoint = primary.m_p0;
+			}
+		}
+	}
+	else // y direction
+	{
+		if (((LINE_HT_UP | LINE_HT_DOWN)&m_primaryPointMap)==0)
+		{
+			if (m_primaryPointMap&LINE_HT_LEFT)
+			{
+				if (primary.m_p0.m_x < primary.m_p1.m_x) // p0 is primary
+				{
+					if (primary.m_p0.m_y < primary.m_p1.m_y) 
+						m_primaryPointMap |= LINE_HT_UP;
+					else // p0 > p1
+						m_primaryPointMap |= LINE_HT_DOWN;					
+				}
+				else // p1 is primary
+				{
+					if (primary.m_p1.m_y < primary.m_p0.m_y) 
+						m_primaryPointMap |= LINE_HT_UP;
+					else // p1 > p0
+						m_primaryPointMap |= LINE_HT_DOWN;					
+				}
+			}
+			else // m_primaryPointMap&LINE_HT_RIGHT
+			{
+				if (primary.m_p0.m_x > primary.m_p1.m_x) // p0 is primary 
+				{
+					if (primary.m_p0.m_y < primary.m_p1.m_y) 
+						m_primaryPointMap |= LINE_HT_UP;
+					else // p0 > p1
+						m_primaryPointMap |= LINE_HT_DOWN;					
+				}
+				else // p1 is primary
+				{
+					if (primary.m_p1.m_y < primary.m_p0.m_y) 
+						m_primaryPointMap |= LINE_HT_UP;
+					else // p1 > p0
+						m_primaryPointMap |= LINE_HT_DOWN;					
+				}
+			}
+		}
+		if (m_primaryPointMap&LINE_HT_UP)
+		{
+			if (primary.m_p0.m_y < primary.m_p1.m_y) // p0 is primary 
+			{
+				m_primaryPoint = primary.m_p0;
+				m_goalPoint = primary.m_p1;
+			}
+			else // p1 is primary
+			{
+				m_primaryPoint = primary.m_p1;
+				m_goalPoint = primary.m_p0;
+			}
+		}
+		else // m_primaryPointMap&LINE_HT_DOWN
+		{
+			if (primary.m_p0.m_y > primary.m_p1.m_y) // p0 is primary 
+			{
+				m_primaryPoint = primary.m_p0;
+				m_goalPoint = primary.m_p1;
+			}
+			else // p1 is primary
+			{
+				m_primaryPoint = primary.m_p1;
+				m_goalPoint = primary.m_p0;
+			}
+		}
+	}
+}
+#else
+void LineEngine::updatePrimaryPoint(const Line2 &primary)
+{
+	m_primaryActive = primary.m_tracker->get()!=NULL;
+	
+	if (xdirection(primary.m_p0, primary.m_p1))
+	{
+		if (m_primaryPointMap&LINE_HT_RIGHT)
+		{
+			m_primaryPointMap = LINE_HT_RIGHT;
+			if (primary.m_p0.m_x > primary.m_p1.m_x) // p0 is the primary point
+			{
+				m_primaryPoint = primary.m_p0;
+				m_goalPoint = primary.m_p1;
+				// update UP/DOWN flag
+				if (primary.m_p0.m_y > primary.m_p1.m_y)
+					m_primaryPointMap |= LINE_HT_DOWN;
+			}
+			else // p1 is the primary point
+			{
+				m_primaryPoint = primary.m_p1;
+				m_goalPoint = primary.m_p0;
+				// update UP/DOWN flag
+				if (primary.m_p1.m_y > primary.m_p0.m_y)
+					m_primaryPointMap |= LINE_HT_DOWN;
+			}
+		}
+		else // LINE_HT_LEFT
+		{
+			m_primaryPointMap = LINE_HT_LEFT;
+			if (primary.m_p0.m_x < primary.m_p1.m_x) // p0 is the primary point
+			{
+				m_primaryPoint = primary.m_p0;
+				m_goalPoint = primary.m_p1;
+				// update UP/DOWN flag
+				if (primary.m_p0.m_y > primary.m_p1.m_y)
+					m_primaryPointMap |= LINE_HT_DOWN;
+			}
+			else // p1 is the primary point
+			{
+				m_primaryPoint = primary.m_p1;
+				m_goalPoint = primary.m_p0;
+				// update UP/DOWN flag
+				if (primary.m_p1.m_y > primary.m_p0.m_y)
+					m_primaryPointMap |= LINE_HT_DOWN;
+			}
+		}				
+	}
+	else // y direction
+	{
+		if (m_primaryPointMap&LINE_HT_DOWN)
+		{
+			m_primaryPointMap = LINE_HT_DOWN;
+			if (primary.m_p0.m_y > primary.m_p1.m_y) // p0 is the primary point
+			{
+				m_primaryPoint = primary.m_p0;
+				m_goalPoint = primary.m_p1;
+				// update LEFT/RIGHT flag
+				if (primary.m_p0.m_x > primary.m_p1.m_x)
+					m_primaryPointMap |= LINE_HT_RIGHT;
+			}
+			else // p1 is the primary point
+			{
+				m_primaryPoint = primary.m_p1;
+				m_goalPoint = primary.m_p0;
+				// update LEFT/RIGHT flag
+				if (primary.m_p1.m_x > primary.m_p0.m_x)
+					m_primaryPointMap |= LINE_HT_RIGHT;
+			}
+		}
+		else // LINE_HT_UP
+		{
+			m_primaryPointMap = LINE_HT_UP;
+			if (primary.m_p0.m_y < primary.m_p1.m_y) // p0 is the primary point
+			{
+				m_primaryPoint = primary.m_p0;
+				m_goalPoint = primary.m_p1;
+				// update LEFT/RIGHT flag
+				if (primary.m_p0.m_x > primary.m_p1.m_x)
+					m_primaryPointMap |= LINE_HT_RIGHT;
+			}
+			else // p1 is the primary point
+			{
+				m_primaryPoint = primary.m_p1;
+				m_goalPoint = primary.m_p0;
+				// update LEFT/RIGHT flag
+				if (primary.m_p1.m_x > primary.m_p0.m_x)
+					m_primaryPointMap |= LINE_HT_RIGHT;
+			}
+		}
+	}
+}
+#endif
+
+int LineEngine::intersectionTurn()
+{
+	uint8_t k, mink;
+	uint16_t angle, minAngle;
+	Line2 *primary;
+		
+	// find line that best fits our desired turn angle (m_nextTurnAngle), ie, find minimum difference
+	for (k=0, minAngle=0xffff; k<m_primaryIntersection.m_object.m_n; k++)
+	{
+		// calculate difference between angles
+		angle = ABS(m_primaryIntersection.m_object.m_lines[k].m_angle - m_nextTurnAngle);
+		if (angle<minAngle)
+		{
+			minAngle = angle;
+			mink = k;
+		}
+	}
+	// assign new primary line
+	m_primaryLineIndex = m_primaryIntersection.m_object.m_lines[mink].m_index;
+	primary = findTrackedLine(m_primaryLineIndex);
+	// set m_primaryPointMap
+	if (m_primaryIntersection.m_object.m_x==primary->m_p0.m_x && m_primaryIntersection.m_object.m_y==primary->m_p0.m_y) // primary point is p0
+	{
+		m_primaryPoint = primary->m_p0;
+		m_goalPoint = primary->m_p1;
+	}
+	else // primary point is p1
+	{
+		m_primaryPoint = primary->m_p1;
+		m_goalPoint = primary->m_p0;
+	}
+	if (xdirection(primary->m_p0, primary->m_p1))
+	{
+		if (m_primaryPoint.m_x<m_goalPoint.m_x)
+			m_primaryPointMap = LINE_HT_LEFT;
+		else
+			m_primaryPointMap = LINE_HT_RIGHT;							
+	}
+	else // y direction
+	{
+		if (m_primaryPoint.m_y<m_goalPoint.m_y)
+			m_primaryPointMap = LINE_HT_UP;
+		else
+			m_primaryPointMap = LINE_HT_DOWN;							
+	}
+	m_primaryActive = true;
+	m_primaryIntersection.m_state = TR_INVALID; // invalidate intersection
+	
+	// reset angle to default angle
+	m_nextTurnAngle = m_params.m_defaultTurnAngle;
+	m_newTurnAngle = false;
+	
+	// we always succeed by choosing the closest line
+	return 0;	
+}
+
+void LineEngine::setPrimaryVector(uint8_t index)
+{
+	Line2 *line;
+	
+	line = findTrackedLine(index);
+	if (line)
+	{
+		// choose point lower in the image as the primary point
+		m_primaryPointMap = LINE_HT_DOWN;
+					
+		m_primaryLineIndex = index;
+		m_primaryIntersection.m_state = TR_INVALID;
+		m_lineState = LINE_STATE_TRACKING;
+		// update 
+		updatePrimaryPoint(*line);
+	}
+}
+
+void LineEngine::handleLineState()
+{
+	uint8_t ymax;
+	SimpleListNode<Tracker<Line2> > *i, *max;
+	Line2 *line, *primary;
+	uint8_t events;
+	
+	if (m_lineState==LINE_STATE_ACQUIRING)
+	{
+		if (m_params.m_manualVectorSelect) // // wait for user to select
+		{
+			if (m_manualVectorSelectActive)
+			{
+				setPrimaryVector(m_manualVectorSelectIndex);
+				m_manualVectorSelectActive = false;
+			}
+			
+			return;
+		}
+		// find line that meets our criteria -- it should be at least 45 degrees past horizontal and reasonably long
+		// we will consider lines that are lower in the image first.  The first line to fit the criterial is our line.
+		
+		// reset 
+		for (i=m_lineTrackersList.m_first; i!=NULL; i=i->m_next)
+			i->m_object.resetMin();
+
+		while(1)
+		{
+			for (i=m_lineTrackersList.m_first, ymax=0, max=NULL; i!=NULL; i=i->m_next)
+			{
+				line = i->m_object.get();
+				if (line!=NULL && i->m_object.m_minVal==TR_MAXVAL)
+				{
+					if (line->m_p0.m_y>ymax)
+					{
+						ymax = line->m_p0.m_y;
+						max = i;
+					}
+					else if (line->m_p1.m_y>ymax)
+					{	
+						ymax = line->m_p1.m_y;
+						max = i;
+					}
+				}
+			}
+			if (max)
+			{
+				//angle = tanAbs1000(max->m_object.m_object.m_p0, max->m_object.m_object.m_p1);
+				//if (angle>=LINE_MIN_ACQUISITION_TAN_ANGLE && max->m_object.m_object.length2()>=LINE_MIN_ACQUISITION_LENGTH2)
+				if (max->m_object.m_object.length2()>=LINE_MIN_ACQUISITION_LENGTH2)
+				{
+					//cprintf("acq %d %d %d %d %d %d\n", max->m_object.m_index, angle, 
+					//	max->m_object.m_object.m_p0.m_x, max->m_object.m_object.m_p0.m_y, max->m_object.m_object.m_p1.m_x, max->m_object.m_object.m_p1.m_y);
+					
+					setPrimaryVector(max->m_object.m_index);
+					break;
+				}			
+				max->m_object.m_minVal = 0; // flag that we've visited
+			}
+			else
+			{
+				//cprintf("null\n");
+				break;
+			}
+		}
+	}
+	else // LINE_STATE_TRACKING
+	{
+		primary = findTrackedLine(m_primaryLineIndex);
+		
+		if (primary)
+		{
+			if (m_reversePrimary)
+			{
+				m_reversePrimary = false;
+				if (m_primaryPointMap&LINE_HT_UP)
+				{
+					m_primaryPointMap &= ~LINE_HT_UP;
+					m_primaryPointMap |= LINE_HT_DOWN;
+				}
+				else if (m_primaryPointMap&LINE_HT_DOWN)
+				{
+					m_primaryPointMap &= ~LINE_HT_DOWN;
+					m_primaryPointMap |= LINE_HT_UP;
+				}
+				if (m_primaryPointMap&LINE_HT_RIGHT)
+				{
+					m_primaryPointMap &= ~LINE_HT_RIGHT;
+					m_primaryPointMap |= LINE_HT_LEFT;
+				}
+				else if (m_primaryPointMap&LINE_HT_LEFT)
+				{
+					m_primaryPointMap &= ~LINE_HT_LEFT;
+					m_primaryPointMap |= LINE_HT_RIGHT;
+				}
+			}
+			// deal with primary point 
+			updatePrimaryPoint(*primary);
+			
+			if (m_debug&LINE_DEBUG_TRACKING)
+				cprintf(0, "Primary %d %d (%d %d)(%d %d)\n", m_primaryLineIndex, m_primaryPointMap, 
+				m_primaryPoint.m_x, m_primaryPoint.m_y, m_goalPoint.m_x, m_goalPoint.m_y);
+			
+			// Find primary again in list of lines.  Note if we find "primary" here, it will be the same line as "primary" above.  
+			// The only difference is this line will always have a valid intersection.  The "otherIndex" and "otherPoint" found 
+			// above will apply here also. 
+			primary = findLine(m_primaryLineIndex);
+			if (primary)
+			{
+				if (primary->m_p0.equals(m_goalPoint)) // look for intersection at i0
+					events = updatePrimaryIntersection(primary->m_i0); 
+				else // look for intersection at i1
+					events = updatePrimaryIntersection(primary->m_i1);
+				
+				// as soon as we see the m_primaryIntersection state transition to valid...
+				if (events&TR_EVENT_VALIDATED)
+				{
+					m_newIntersection = true;
+					if (m_debug&LINE_DEBUG_TRACKING)
+						cprintf(0, "New intersection\n");
+					
+					// if turn angle is set before intersection, go ahead and choose turn now
+					if (!m_params.m_delayedTurn)
+						intersectionTurn();
+					else // LINE_TURNMODE_DURING_INTERSECTION, we need to reset m_newTurnAngle, so we don't accidentally turn
+						m_newTurnAngle = false;
+				}
+				// deal with turn, if turn mode dictates that choose turn during the intersection
+				else if (m_newTurnAngle && m_params.m_delayedTurn && m_primaryIntersection.m_state!=TR_INVALID)
+					intersectionTurn();
+					
+				if (events&TR_EVENT_INVALIDATED)
+					m_newIntersection = false;
+
+				if ((m_debug&LINE_DEBUG_TRACKING) && m_primaryIntersection.m_state!=TR_INVALID)
+					cprintf(0, "Intersection %d (%d %d)\n", m_primaryIntersection.m_state, m_primaryIntersection.m_object.m_x, m_primaryIntersection.m_object.m_y);
+			}							
+		}
+		else // we lost the line
+			m_lineState = LINE_STATE_ACQUIRING;
+		
+	}
+}
+
+
+template <typename Object> void printPool(const char *desc, const SimpleListPool<Object> &pool)
+{
+	cprintf(0, "%s pool: %d/%d max %d exhausted %d\n", desc, pool.m_used, pool.m_capacity, pool.m_highWater, pool.m_exhausted);
+}
+
+void LineEngine::printPoolStats()
+{
+	printPool("lines", m_linesPool);
+	printPool("nodes", m_nodesPool);
+	printPool("nadirs", m_nadirsPool);
+	printPool("intersections", m_intersectionsPool);
+	printPool("line trackers", m_lineTrackersPool);
+	printPool("barcode trackers", m_barCodeTrackersPool);
+}
+
+void LineStageProfile::reset()
+{
+	m_count = 0;
+	m_min = 0;
+	m_max = 0;
+	m_sum = 0;
+	memset(m_hist, 0, sizeof(m_hist));
+}
+
+void LineStageProfile::add(uint32_t cycles)
+{
+	int8_t octave;
+	uint16_t i, bucket;
+	
+	if (m_count==0 || cycles<m_min)
+		m_min = cycles;
+	if (cycles>m_max)
+		m_max = cycles;
+	m_sum += cycles;
+	m_count++;
+	
+	// find most significant bit, then use the next 2 bits to pick one of 4 buckets in the octave
+	for (octave=31; octave>LINE_PROFILE_MIN_OCTAVE && (cycles&(1UL<<octave))==0; octave--);
+	if ((cycles>>LINE_PROFILE_MIN_OCTAVE)==0)
+		bucket = 0;
+	else
+	{
+		bucket = ((octave-LINE_PROFILE_MIN_OCTAVE)<<2) + ((cycles>>(octave-2))&0x03);
+		if (bucket>=LINE_PROFILE_BUCKETS)
+			bucket = LINE_PROFILE_BUCKETS-1;
+	}
+	// don't overflow, keep the shape of the histogram
+	if (m_hist[bucket]==0xffff)
+	{
+		for (i=0; i<LINE_PROFILE_BUCKETS; i++)
+			m_hist[i] >>= 1;
+	}
+	m_hist[bucket]++;
+}
+
+uint32_t LineStageProfile::mean() const
+{
+	if (m_count==0)
+		return 0;
+	return m_sum/m_count;
+}
+
+uint32_t LineStageProfile::percentile(uint8_t pct) const
+{
+	uint16_t i;
+	uint32_t n, total, val;
+	
+	for (i=0, total=0; i<LINE_PROFILE_BUCKETS; i++)
+		total += m_hist[i];
+	if (total==0)
+		return 0;
+	
+	// return the upper edge of the bucket that contains the percentile
+	total = (total*pct + 99)/100;
+	for (i=0, n=0; i<LINE_PROFILE_BUCKETS-1; i++)
+	{
+		n += m_hist[i];
+		if (n>=total)
+			break;
+	}
+	val = (uint32_t)(4 + (i&0x03) + 1)<<((i>>2) + LINE_PROFILE_MIN_OCTAVE - 2);
+	if (val>m_max)
+		val = m_max;
+	if (val<m_min)
+		val = m_min;
+	
+	return val;
+}
+
+void LineEngine::resetProfile()
+{
+	uint8_t i;
+	
+	for (i=0; i<LINE_STAGES; i++)
+		m_profile[i].reset();
+}
+
+void LineEngine::getProfile(uint32_t *stats)
+{
+	uint8_t i;
+	
+	for (i=0; i<LINE_STAGES; i++, stats+=LINE_PROFILE_STATS)
+	{
+		stats[0] = m_profile[i].m_count;
+		stats[1] = m_profile[i].m_min;
+		stats[2] = m_profile[i].mean();
+		stats[3] = m_profile[i].percentile(99);
+		stats[4] = m_profile[i].m_max;
+	}
+}
+
+int LineEngine::getPrimaryFrame(uint8_t typeMap, uint8_t *buf, uint16_t len)
+{
+	uint16_t length = 0;
+	
+	// only return primary line if we're tracking and primary line is in active (valid) state
+	if (m_lineState==LINE_STATE_TRACKING && m_primaryActive)
+	{
+		// we assume that we can fit all 3 features in a single packet (255 bytes)
+		if (typeMap&LINE_FR_VECTOR_LINES)
+		{
+			// line information is always present
+			FrameLine *line;
+			*(uint8_t *)(buf + length) = LINE_FR_VECTOR_LINES;
+			*(uint8_t *)(buf + length + 1) = sizeof(FrameLine);
+			line = (FrameLine *)(buf + length + 2);
+			line->m_x0 = m_primaryPoint.m_x;
+			line->m_y0 = m_primaryPoint.m_y;
+			line->m_x1 = m_goalPoint.m_x;
+			line->m_y1 = m_goalPoint.m_y;
+			line->m_index = m_primaryLineIndex; 
+			line->m_flags = 0;
+			if (m_intersectionsList.m_size)
+				line->m_flags |= LINE_FR_FLAG_INTERSECTION;
+			length += sizeof(FrameLine) + 2;
+		}
+		// Intersection information, only present when intersection appears
+		if ((typeMap&LINE_FR_INTERSECTION) && m_newIntersection)
+		{
+			*(uint8_t *)(buf + length) = LINE_FR_INTERSECTION;
+			*(uint8_t *)(buf + length + 1) = sizeof(FrameIntersection);
+			memcpy(buf+length+2, &m_primaryIntersection.m_object, sizeof(FrameIntersection));
+			length += sizeof(FrameIntersection) + 2;
+			
+			m_newIntersection = false;
+		}
+	}
+	if (typeMap&LINE_FR_BARCODE)
+	{
+		SimpleListNode<Tracker<DecodedBarCode> > *j;
+	
+		// go through list, find best candidates
+		for (j=m_barCodeTrackersList.m_first; j!=NULL; j=j->m_next)
+		{
+			if (j->m_object.m_events&TR_EVENT_VALIDATED && !(j->m_object.m_eventsShadow&TR_EVENT_VALIDATED))
+			{
+				FrameCode *barcode;
+	
+				*(uint8_t *)(buf + length) = LINE_FR_BARCODE;
+				*(uint8_t *)(buf + length + 1) = sizeof(FrameCode);
+				barcode = (FrameCode *)(buf + length + 2);
+				barcode->m_code = j->m_object.m_object.m_val;
+				barcode->m_flags = 0;
+				// return center location of code
+				barcode->m_x = (j->m_object.m_object.m_outline.m_xOffset + (j->m_object.m_object.m_outline.m_width>>1))>>LINE_GRID_WIDTH_REDUCTION;
+				barcode->m_y = (j->m_object.m_object.m_outline.m_yOffset + (j->m_object.m_object.m_outline.m_height>>1))>>LINE_GRID_HEIGHT_REDUCTION;
+				length += sizeof(FrameCode) + 2;
+				// set shadow so we don't report again
+				j->m_object.m_eventsShadow |= TR_EVENT_VALIDATED;
+				// only 1 code per frame
+				break; 
+			}
+		}
+	}
+	return length;
+}
+
+int LineEngine::getAllFrame(uint8_t typeMap, uint8_t *buf, uint16_t len)
+{
+	uint16_t length = 0;
+	uint8_t plength, *hbuf;
+	
+	if (typeMap&LINE_FR_VECTOR_LINES)
+	{
+		SimpleListNode<Tracker<Line2> > *n;
+		Line2 *line;
+		FrameLine *fline;
+		
+		// the section length is a byte, so stop before it wraps
+		for(n=m_lineTrackersList.m_first, plength=0, hbuf=buf+length; n!=NULL && length<len-sizeof(FrameLine)-2 && plength<=0xff-sizeof(FrameLine); n=n->m_next)
+		{
+			fline = (FrameLine *)(buf + length + 2);
+			line = &n->m_object.m_object;
+			fline->m_x0 = line->m_p0.m_x;
+			fline->m_y0 = line->m_p0.m_y;
+			fline->m_x1 = line->m_p1.m_x;
+			fline->m_y1 = line->m_p1.m_y;
+			fline->m_index = n->m_object.m_index;
+			fline->m_flags = n->m_object.m_state;
+				
+			length += sizeof(FrameLine);
+			plength += sizeof(FrameLine);
+		}
+		if (plength>0)
+		{
+			*(uint8_t *)hbuf = LINE_FR_VECTOR_LINES;
+			*(uint8_t *)(hbuf+1) = plength;
+			length += 2;
+		}
+	}
+	if (typeMap&LINE_FR_INTERSECTION)
+	{
+		SimpleListNode<Intersection> *i;
+		FrameIntersection *intersection;
+		
+		for (i=m_intersectionsList.m_first, plength=0, hbuf=buf+length; i!=NULL && length<len-sizeof(FrameIntersection)-2 && plength<=0xff-sizeof(FrameIntersection); i=i->m_next)
+		{
+			intersection = (FrameIntersection *)(buf + length + 2);
+			formatIntersection(i->m_object, intersection, true); 
+				
+			length += sizeof(FrameIntersection);
+			plength += sizeof(FrameIntersection);			
+		}
+		if (plength>0)
+		{
+			*(uint8_t *)hbuf = LINE_FR_INTERSECTION;
+			*(uint8_t *)(hbuf+1) = plength;
+			length += 2;
+		}
+	}
+	if (typeMap&LINE_FR_BARCODE)
+	{
+		SimpleListNode<Tracker<DecodedBarCode> > *j;
+		DecodedBarCode *dcode;
+		FrameCode *barcode;
+		
+		// go through list, find best candidates
+		for (j=m_barCodeTrackersList.m_first, plength=0, hbuf=buf+length; j!=NULL && length<len-sizeof(FrameCode)-2 && plength<=0xff-sizeof(FrameCode); j=j->m_next)
+		{
+			dcode = &j->m_object.m_object;
+			barcode = (FrameCode *)(buf + length + 2);
+			barcode->m_x = (dcode->m_outline.m_xOffset + (dcode->m_outline.m_width>>1))>>LINE_GRID_WIDTH_REDUCTION;
+			barcode->m_y = (dcode->m_outline.m_yOffset + (dcode->m_outline.m_height>>1))>>LINE_GRID_HEIGHT_REDUCTION;
+			barcode->m_flags = j->m_object.m_state;
+			barcode->m_code = dcode->m_val;
+				
+			length += sizeof(FrameCode);
+			plength += sizeof(FrameCode);
+		}
+		if (plength>0)
+		{
+			*(uint8_t *)hbuf = LINE_FR_BARCODE;
+			*(uint8_t *)(hbuf+1) = plength;
+			length += 2;
+		}
+	}
+	return length;
+}
+
+void LineEngine::resetDelta()
+{
+	// move on to a frame number the client hasn't seen, so no ack matches until it has everything again
+	if (++m_deltaFrame==0)
+		m_deltaFrame = 1;
+	m_deltaTypeMap = 0;
+	m_deltaLineCount = 0;
+	m_deltaCodeCount = 0;
+	m_deltaIntersectionHash = 0;
+}
+
+// Removes the records whose index isn't set in present and writes them as FrameRemoved records at 
+// buf+length+2 (after the section header), as long as they fit.  Records that don't fit stay, so 
+// they're removed in a later response. 
+template <typename Record> static void removeDeltaRecords(uint8_t type, Record *records, uint8_t *count, const uint32_t *present, 
+	uint8_t *buf, uint16_t *length, uint8_t *plength, uint16_t len)
+{
+	uint8_t i, index;
+	FrameRemoved *removed;
+
+	for (i=0; i<*count && *length<len-sizeof(FrameRemoved)-2 && *plength<=0xff-sizeof(FrameRemoved);)
+	{
+		index = records[i].m_index;
+		if (present[index>>5]&LINE_GRID_BIT(index))
+			i++;
+		else
+		{
+			removed = (FrameRemoved *)(buf + *length + 2);
+			removed->m_type = type;
+			removed->m_index = index;
+			*length += sizeof(FrameRemoved);
+			*plength += sizeof(FrameRemoved);
+			records[i] = records[--*count];
+		}
+	}
+}
+
+// Writes record at buf+length+2 if it's new (and there's room for it) or if it has changed, and 
+// updates records to match. 
+template <typename Record> static void updateDeltaRecord(const Record &record, Record *records, uint8_t *count, uint8_t maxCount, 
+	uint8_t *buf, uint16_t *length, uint8_t *plength, uint16_t len)
+{
+	uint8_t i;
+
+	if (*length>=len-sizeof(Record)-2 || *plength>0xff-sizeof(Record))
+		return;
+	for (i=0; i<*count && records[i].m_index!=record.m_index; i++);
+	if (i==*count)
+	{
+		if (*count==maxCount)
+			return;
+		(*count)++;
+	}
+	else if (memcmp(&records[i], &record, sizeof(Record))==0)
+		return;
+	records[i] = record;
+	memcpy(buf + *length + 2, &record, sizeof(Record));
+	*length += sizeof(Record);
+	*plength += sizeof(Record);
+}
+
+int LineEngine::getDeltaFrame(uint8_t typeMap, uint16_t ack, uint8_t *buf, uint16_t len)
+{
+	uint16_t length = 0;
+	uint8_t k, plength, *hbuf;
+	uint32_t present[0x100/32], hash;
+	FrameDelta *delta;
+	SimpleListNode<Tracker<Line2> > *n;
+	SimpleListNode<Intersection> *i;
+	SimpleListNode<Tracker<DecodedBarCode> > *j;
+
+	*(uint8_t *)buf = LINE_FR_DELTA;
+	*(uint8_t *)(buf + 1) = sizeof(FrameDelta);
+	delta = (FrameDelta *)(buf + 2);
+	delta->m_flags = 0;
+	delta->m_reserved = 0;
+	// start over unless the client has what we last sent
+	if (ack==0 || ack!=m_deltaFrame || typeMap!=m_deltaTypeMap)
+	{
+		resetDelta();
+		m_deltaTypeMap = typeMap;
+		delta->m_flags |= LINE_FR_DELTA_FULL;
+	}
+	if (++m_deltaFrame==0)
+		m_deltaFrame = 1;
+	delta->m_frame = m_deltaFrame;
+	length += sizeof(FrameDelta) + 2;
+
+	// lines and barcodes whose trackers are gone
+	plength = 0;
+	hbuf = buf + length;
+	if (typeMap&LINE_FR_VECTOR_LINES)
+	{
+		memset(present, 0, sizeof(present));
+		for (n=m_lineTrackersList.m_first; n!=NULL; n=n->m_next)
+			present[n->m_object.m_index>>5] |= LINE_GRID_BIT(n->m_object.m_index);
+		removeDeltaRecords(LINE_FR_VECTOR_LINES, m_deltaLines, &m_deltaLineCount, present, buf, &length, &plength, len);
+	}
+	if (typeMap&LINE_FR_BARCODE)
+	{
+		memset(present, 0, sizeof(present));
+		for (j=m_barCodeTrackersList.m_first; j!=NULL; j=j->m_next)
+			present[j->m_object.m_index>>5] |= LINE_GRID_BIT(j->m_object.m_index);
+		removeDeltaRecords(LINE_FR_INDEXED_BARCODE, m_deltaCodes, &m_deltaCodeCount, present, buf, &length, &plength, len);
+	}
+	if (plength>0)
+	{
+		*(uint8_t *)hbuf = LINE_FR_REMOVED;
+		*(uint8_t *)(hbuf+1) = plength;
+		length += 2;
+	}
+
+	if (typeMap&LINE_FR_VECTOR_LINES)
+	{
+		FrameLine fline;
+		Line2 *line;
+
+		for (n=m_lineTrackersList.m_first, plength=0, hbuf=buf+length; n!=NULL; n=n->m_next)
+		{
+			line = &n->m_object.m_object;
+			fline.m_x0 = line->m_p0.m_x;
+			fline.m_y0 = line->m_p0.m_y;
+			fline.m_x1 = line->m_p1.m_x;
+			fline.m_y1 = line->m_p1.m_y;
+			fline.m_index = n->m_object.m_index;
+			fline.m_flags = n->m_object.m_state;
+			updateDeltaRecord(fline, m_deltaLines, &m_deltaLineCount, LINE_DELTA_MAX_LINES, buf, &length, &plength, len);
+		}
+		if (plength>0)
+		{
+			*(uint8_t *)hbuf = LINE_FR_VECTOR_LINES;
+			*(uint8_t *)(hbuf+1) = plength;
+			length += 2;
+		}
+	}
+	if (typeMap&LINE_FR_INTERSECTION)
+	{
+		// intersections aren't tracked, so they're sent as a set (possibly empty) whenever it changes
+		for (i=m_intersectionsList.m_first, k=0, plength=0, hbuf=buf+length; i!=NULL && k<LINE_DELTA_MAX_INTERSECTIONS && length<len-sizeof(FrameIntersection)-2; i=i->m_next, k++)
+		{
+			formatIntersection(i->m_object, (FrameIntersection *)(buf + length + 2), true);
+			length += sizeof(FrameIntersection);
+			plength += sizeof(FrameIntersection);
+		}
+		// FNV-1a, 0 for no intersections
+		for (k=0, hash=plength ? 2166136261U : 0; k<plength; k++)
+			hash = (hash^hbuf[k+2])*16777619U;
+		if (hash==m_deltaIntersectionHash)
+			length -= plength; // client already has them
+		else
+		{
+			*(uint8_t *)hbuf = LINE_FR_INTERSECTION;
+			*(uint8_t *)(hbuf+1) = plength;
+			length += 2;
+			m_deltaIntersectionHash = hash;
+		}
+	}
+	if (typeMap&LINE_FR_BARCODE)
+	{
+		FrameIndexedCode barcode;
+		DecodedBarCode *dcode;
+
+		for (j=m_barCodeTrackersList.m_first, plength=0, hbuf=buf+length; j!=NULL; j=j->m_next)
+		{
+			dcode = &j->m_object.m_object;
+			barcode.m_x = (dcode->m_outline.m_xOffset + (dcode->m_outline.m_width>>1))>>LINE_GRID_WIDTH_REDUCTION;
+			barcode.m_y = (dcode->m_outline.m_yOffset + (dcode->m_outline.m_height>>1))>>LINE_GRID_HEIGHT_REDUCTION;
+			barcode.m_flags = j->m_object.m_state;
+			barcode.m_code = dcode->m_val;
+			barcode.m_index = j->m_object.m_index;
+			barcode.m_reserved = 0;
+			updateDeltaRecord(barcode, m_deltaCodes, &m_deltaCodeCount, LINE_DELTA_MAX_BARCODES, buf, &length, &plength, len);
+		}
+		if (plength>0)
+		{
+			*(uint8_t *)hbuf = LINE_FR_INDEXED_BARCODE;
+			*(uint8_t *)(hbuf+1) = plength;
+			length += 2;
+		}
+	}
+	return length;
+}
+
+void LineEngine::legoLineData(uint8_t *buf)
+{
+	SimpleListNode<Tracker<DecodedBarCode> > *j;
+	uint8_t codeVal;
+	uint16_t maxy;
+	Line2 *primary;
+	uint32_t x;
+
+	buf[2] = (uint8_t)-1;
+	
+	// only return primary line if we're tracking and primary line is in active (valid) state
+	if (m_lineState==LINE_STATE_TRACKING && m_primaryActive)
+	{
+		x = (m_goalPoint.m_x *128)/78; // scale to 0 to 128
+		buf[0] = x;
+		if (m_goalPoint.m_y > m_primaryPoint.m_y)
+			buf[3] = 1;
+		else
+			buf[3] = 0;
+	}
+	else
+	{
+		buf[0] = (uint8_t)-1;
+		buf[3] = 0;
+	}
+
+	for (j=m_barCodeTrackersList.m_first, maxy=0, codeVal=(uint8_t)-1; j!=NULL; j=j->m_next)
+	{
+		if (j->m_object.m_events&TR_EVENT_VALIDATED)
+		{
+			if (maxy < j->m_object.m_object.m_outline.m_yOffset)
+			{
+				maxy = j->m_object.m_object.m_outline.m_yOffset;
+				codeVal = j->m_object.m_object.m_val;
+			}
+		}
+	}
+	buf[1] = codeVal;
+	
+	
+	primary = findLine(m_primaryLineIndex);
+	if (primary)
+	{			
+		if (primary->m_i1)
+			buf[2] = primary->m_i1->m_object.m_n;
+		else if (primary->m_i0)
+			buf[2] = primary->m_i0->m_object.m_n;
+	}
+	if (m_newIntersection)
+		m_newIntersection = false;
+}
+
+// Returns the primary line with p1 as the goal point and the number of lines in the primary 
+// intersection, or false if there is no primary line. 
+bool LineEngine::getPrimaryVector(Point *p0, Point *p1, uint8_t *n)
+{
+	Line2 *primary=NULL;
+	
+	*n = 0;
+	if (m_lineState==LINE_STATE_TRACKING)
+	{	
+		primary = findTrackedLine(m_primaryLineIndex);
+		if (m_primaryIntersection.m_state!=TR_INVALID)
+			*n = m_primaryIntersection.m_object.m_n;
+	}
+	if (primary==NULL)
+		return false;
+	
+	if (m_goalPoint.equals(primary->m_p0))
+	{
+		*p0 = primary->m_p1;
+		*p1 = primary->m_p0;
+	}
+	else
+	{
+		*p0 = primary->m_p0;
+		*p1 = primary->m_p1;
+	}
+	return true;
+}
+
+void LineEngine::setMode(int8_t modeMap)
+{
+	m_params.m_delayedTurn = (modeMap & LINE_MODEMAP_TURN_DELAYED) ? true : false;
+	m_params.m_whiteLine = (modeMap & LINE_MODEMAP_WHITE_LINE) ? true : false;
+	m_params.m_manualVectorSelect = (modeMap & LINE_MODEMAP_MANUAL_SELECT_VECTOR) ? true : false;
+}
+
+void LineEngine::setNextTurnAngle(int16_t angle)
+{	
+	m_nextTurnAngle = angle;
+	m_newTurnAngle = true;
+}
+
+void LineEngine::setDefaultTurnAngle(int16_t angle)
+{	
+	m_params.m_defaultTurnAngle = angle;
+}
+
+void LineEngine::setVector(uint8_t index)
+{
+	m_manualVectorSelectActive = true;
+	m_manualVectorSelectIndex = index;
+}
+
+int LineEngine::reversePrimary()
+{
+	// can't reverse primary if it's not active
+	if (!m_primaryActive)
+		return -1;
+	
+	m_reversePrimary = true;
+	return 0;
+}
@@ -27,6 +27,7 @@
 #include "smlink.hpp"
 #include "button.h"
 #include "calc.h"
+#include <string.h>
 
 REGISTER_PROG(ProgBlobs, PROG_NAME_BLOBS, "perform color connected components analysis", PROG_BLOBS_MIN_TYPE, PROG_BLOBS_MAX_TYPE);
 
@@ -40,6 +41,7 @@ uint8_t ProgBlobs::renderState;
 #define VIEW_BLOCKS                 0
 #define VIEW_BLOCKS_VIDEO           1
 #define VIEW_BLOCKS_VIDEO_PIXELS    2
+#define VIEW_BLOCKS_REGION          3
 
 #define SA_GAIN                     0.015f
 #define G_GAIN                      1.10f
@@ -48,7 +50,8 @@ const char *ProgBlobs::m_views[] =
 {
 	"Blocks",
 	"Blocks, video",
-	"Blocks, video, detected pixels"
+	"Blocks, video, detected pixels",
+	"Blocks, tracked region video"
 };
 
 const ActionScriptlet ProgBlobs::m_actions[]=
@@ -463,7 +466,10 @@ int ProgBlobs::staticLoop(char *status)
 		// wait for state==1
 		while(SM_OBJECT->streamState==0);
 		// send frame over USB 
-		cam_sendFrame(g_chirpUsb, CAM_RES2_WIDTH, CAM_RES2_HEIGHT, RENDER_FLAG_BLEND, FOURCC('B','A','8','1'));
+		if (m_view==VIEW_BLOCKS_REGION)
+			sendRegion();
+		else
+			cam_sendFrame(g_chirpUsb, CAM_RES2_WIDTH, CAM_RES2_HEIGHT, RENDER_FLAG_BLEND, FOURCC('B','A','8','1'));
 		renderState = 1; // indicate that we've rendered backgound image
 		SM_OBJECT->streamState = 0;
 	}
@@ -471,6 +477,105 @@ int ProgBlobs::staticLoop(char *status)
 	return 0;
 }
 
+// Find the region for the "tracked region video" view: the bounding box of the tracked blocks, or
+// of the block with tracking index g_regionIndex, padded and clamped to the frame.  The region 
+// is in the coordinates of resolution g_regionRes, and if it has more than g_regionBytes pixels, 
+// it's shrunk about its center.  Returns false if there's nothing to follow.
+bool ProgBlobs::getRegion(RectA *region)
+{
+	SimpleListNode<Tracker<BlobA> > *i;
+	BlobA *blob;
+	int32_t left=CAM_RES2_WIDTH, right=0, top=CAM_RES2_HEIGHT, bottom=0;
+	int32_t cx, cy, width, height;
+	float scale;
+
+	for (i=g_blobs->getBlobs()->m_first; i!=NULL; i=i->m_next)
+	{
+		blob = i->m_object.get();
+		if (blob==NULL || (g_regionIndex!=0 && i->m_object.m_index!=g_regionIndex))
+			continue;
+		left = MIN(left, blob->m_left);
+		right = MAX(right, blob->m_right);
+		top = MIN(top, blob->m_top);
+		bottom = MAX(bottom, blob->m_bottom);
+	}
+	if (left>=right || top>=bottom)
+		return false;
+
+	left = MAX(left-g_regionPadding, 0);
+	right = MIN(right+g_regionPadding, CAM_RES2_WIDTH);
+	top = MAX(top-g_regionPadding, 0);
+	bottom = MIN(bottom+g_regionPadding, CAM_RES2_HEIGHT);
+
+	if (g_regionRes==CAM_RES1)
+	{
+		left = left*CAM_RES1_WIDTH/CAM_RES2_WIDTH;
+		right = right*CAM_RES1_WIDTH/CAM_RES2_WIDTH;
+		top = top*CAM_RES1_HEIGHT/CAM_RES2_HEIGHT;
+		bottom = bottom*CAM_RES1_HEIGHT/CAM_RES2_HEIGHT;
+	}
+	width = right-left;
+	height = bottom-top;
+
+	// shrinking about the center keeps the region inside the frame
+	if ((uint32_t)(width*height)>g_regionBytes)
+	{
+		scale = sqrt((float)g_regionBytes/(width*height));
+		cx = (left+right)>>1;
+		cy = (top+bottom)>>1;
+		width = (int32_t)(width*scale);
+		height = (int32_t)(height*scale);
+		left = cx - (width>>1);
+		top = cy - (height>>1);
+	}
+
+	// even offsets and sizes keep the Bayer pattern, and interpolation needs a few pixels 
+	left &= ~1;
+	top &= ~1;
+	width &= ~1;
+	height &= ~1;
+	if (width<4 || height<4)
+		return false;
+
+	region->m_xOffset = left;
+	region->m_yOffset = top;
+	region->m_width = width;
+	region->m_height = height;
+
+	return true;
+}
+
+// Send the region around the tracked blocks (BA8W) instead of the whole frame.  At standard 
+// resolution the region is cut out of the frame that the blocks came from, in place.  At high 
+// resolution it's grabbed, which takes another frame.  With nothing to follow, the whole frame 
+// is sent.
+void ProgBlobs::sendRegion()
+{
+	RectA region;
+	uint16_t i;
+	uint8_t *frame = (uint8_t *)SRAM1_LOC + CAM_PREBUF_LEN;
+
+	if (!getRegion(&region))
+	{
+		cam_sendFrame(g_chirpUsb, CAM_RES2_WIDTH, CAM_RES2_HEIGHT, RENDER_FLAG_BLEND, FOURCC('B','A','8','1'));
+		return;
+	}
+
+	if (g_regionRes==CAM_RES1)
+	{
+		if (cam_getFrame(frame, REGION_MAX_BYTES, CAM_GRAB_M1R1, region.m_xOffset, region.m_yOffset, region.m_width, region.m_height)<0)
+			return;
+		cam_sendWindow(g_chirpUsb, CAM_RES1_WIDTH, CAM_RES1_HEIGHT, region, RENDER_FLAG_BLEND);
+	}
+	else
+	{
+		// each row moves to an address that's lower or the same, so it's safe to go top-down
+		for (i=0; i<region.m_height; i++)
+			memmove(frame + i*region.m_width, frame + (region.m_yOffset+i)*CAM_RES2_WIDTH + region.m_xOffset, region.m_width);
+		cam_sendWindow(g_chirpUsb, CAM_RES2_WIDTH, CAM_RES2_HEIGHT, region, RENDER_FLAG_BLEND);
+	}
+}
+
 int ProgBlobs::staticGetView(uint16_t index, const char **name)
 {
 	uint16_t n = sizeof(m_views)/sizeof(char *);
@@ -525,6 +630,15 @@ int ProgBlobs::staticPacket(uint8_t type, const uint8_t *data, uint8_t len, bool
 			
 		return 0;
 	}
+	else if (type==TYPE_REQUEST_GETBLOBS_MOMENTS)
+	{
+		if (len==2)
+			blobsAssemble(data[0], data[1], checksum, true);
+		else
+			ser_sendError(SER_ERROR_INVALID_REQUEST, checksum);
+			
+		return 0;
+	}
 	
 	// nothing rings a bell, return error
 	return -1;
@@ -613,7 +727,7 @@ void ProgBlobs::handleRecv()
 
 
 
-void ProgBlobs::blobsAssemble(uint8_t sigmap, uint8_t n, bool checksum)
+void ProgBlobs::blobsAssemble(uint8_t sigmap, uint8_t n, bool checksum, bool moments)
 {
 	uint8_t *txData;
 	int res;
@@ -628,12 +742,12 @@ void ProgBlobs::blobsAssemble(uint8_t sigmap, uint8_t n, bool checksum)
 	
 	len = ser_getTx(&txData);
 	
-	res = g_blobs->getBlobs(sigmap, n, txData, len);
+	res = g_blobs->getBlobs(sigmap, n, txData, len, moments);
 
 	if (res<0)
 		ser_sendError(SER_ERROR_BUSY, checksum);
 	else
-		ser_setTx(TYPE_RESPONSE_GETBLOBS, res, checksum);
+		ser_setTx(moments ? TYPE_RESPONSE_GETBLOBS_MOMENTS : TYPE_RESPONSE_GETBLOBS, res, checksum);
 }
 
 
@@ -87,7 +87,9 @@ int ProgLine::packet(uint8_t type, const uint8_t *data, uint8_t len, bool checks
 	if (type==TYPE_REQUEST_GET_FEATURES)
 	{
 		if (len==2) // one byte in request
-			sendLineData(*(uint8_t *)data, *(uint8_t *)(data+1), checksum);
+			sendLineData(*(uint8_t *)data, *(uint8_t *)(data+1), 0, checksum);
+		else if (len==4 && *(uint8_t *)data==GET_ALL_FEATURES_DELTA)
+			sendLineData(*(uint8_t *)data, *(uint8_t *)(data+1), *(uint16_t *)(data+2), checksum);
 		else
 			ser_sendError(SER_ERROR_INVALID_REQUEST, checksum);
 			
@@ -155,7 +157,7 @@ void ProgLine::getResolution(uint16_t *width, uint16_t *height, uint8_t type)
 	*height = LINE_GRID_HEIGHT;
 }
 
-void ProgLine::sendLineData(uint8_t requestType, uint8_t typeMap, bool checksum)
+void ProgLine::sendLineData(uint8_t requestType, uint8_t typeMap, uint16_t ack, bool checksum)
 {
 	uint8_t *txData;
 	uint32_t len;
@@ -165,6 +167,8 @@ void ProgLine::sendLineData(uint8_t requestType, uint8_t typeMap, bool checksum)
 	
 	if (requestType==GET_PRIMARY_FEATURES)
 		res = line_getPrimaryFrame(typeMap, txData, len);
+	else if (requestType==GET_ALL_FEATURES_DELTA)
+		res = line_getDeltaFrame(typeMap, ack, txData, len);
 	else //if (requestType==GET_ALL_FEATURES)
 		res = line_getAllFrame(typeMap, txData, len);
 	
@@ -26,9 +26,39 @@
 #include "pixyvals.h"
 #include "serial.h"
 #include "calc.h"
+#include "qqueue.h"
 #include <string.h>
 
 static uint8_t g_rgbSize = VIDEO_RGB_SIZE;
+static uint8_t g_tileThresh = VIDEO_TILE_THRESH_DEFAULT;
+static uint16_t g_tileKeyframe = VIDEO_TILE_KEYFRAME_DEFAULT;
+
+static const char *g_views[] =
+{
+	"Raw",
+	"Changed tiles"
+};
+
+static void video_shadowCallback(const char *id, const void *val)
+{
+	if (strcmp(id, "Tile change threshold")==0)
+		g_tileThresh = *(uint8_t *)val;
+	else if (strcmp(id, "Tile keyframe period")==0)
+		g_tileKeyframe = *(uint16_t *)val;
+}
+
+static void video_loadParams(uint8_t progIndex)
+{
+	prm_add("Tile change threshold", PROG_FLAGS(progIndex) | PRM_FLAG_SLIDER, PRM_PRIORITY_4,
+		"@c Expert @m 1 @M 64 Sets how much a 4x4 pixel cell of a tile has to change (in brightness) for the tile to be sent in the \"changed tiles\" view (default " STRINGIFY(VIDEO_TILE_THRESH_DEFAULT) ")", UINT8(VIDEO_TILE_THRESH_DEFAULT), END);
+	prm_setShadowCallback("Tile change threshold", (ShadowCallback)video_shadowCallback);
+	prm_add("Tile keyframe period", PROG_FLAGS(progIndex) | PRM_FLAG_SLIDER, PRM_PRIORITY_4,
+		"@c Expert @m 1 @M 300 Sets how often (in frames) the whole frame is sent in the \"changed tiles\" view (default " STRINGIFY(VIDEO_TILE_KEYFRAME_DEFAULT) ")", UINT16(VIDEO_TILE_KEYFRAME_DEFAULT), END);
+	prm_setShadowCallback("Tile keyframe period", (ShadowCallback)video_shadowCallback);
+
+	prm_get("Tile change threshold", &g_tileThresh, END);
+	prm_get("Tile keyframe period", &g_tileKeyframe, END);
+}
 
 REGISTER_PROG(ProgVideo, PROG_NAME_VIDEO, "continuous stream of raw camera frames", PROG_VIDEO_MIN_TYPE, PROG_VIDEO_MAX_TYPE);
 ProgVideo::ProgVideo(uint8_t progIndex)
@@ -38,6 +68,17 @@ ProgVideo::ProgVideo(uint8_t progIndex)
 	else
 		cam_setMode(CAM_MODE1);
 
+	video_loadParams(progIndex);
+	m_signatures = new (std::nothrow) uint8_t[VIDEO_TILES*VIDEO_TILE_CELLS];
+	m_band = new (std::nothrow) uint8_t[VIDEO_TILE_BAND_LEN];
+	m_keyframeCount = 0;
+	m_rgbsState = VIDEO_RGBS_IDLE;
+	m_rgbsLen = 0;
+
+	// if m_view is invalid, set default view
+	if (m_view<0)
+		m_view = VIDEO_VIEW_RAW;
+
 	// run m0 
 	exec_runM0(1);
 	SM_OBJECT->currentLine = 0;
@@ -47,6 +88,30 @@ ProgVideo::ProgVideo(uint8_t progIndex)
 ProgVideo::~ProgVideo()
 {
 	exec_stopM0();
+	delete [] m_signatures;
+	delete [] m_band;
+	// the summed-area tables may have overwritten the queue
+	g_qqueue->reset();
+}
+
+int ProgVideo::getView(uint16_t index, const char **name)
+{
+	if (index>=sizeof(g_views)/sizeof(char *))
+		return -1;
+
+	*name = g_views[index];
+
+	return index==m_view; // return 1 if it's the current view, 0 otherwise
+}
+
+int ProgVideo::setView(uint16_t index)
+{
+	if (index>=sizeof(g_views)/sizeof(char *))
+		return -1;
+
+	m_keyframeCount = 0; // start with a whole frame
+
+	return 0;
 }
 
 int ProgVideo::loop(char *status)
@@ -58,8 +123,21 @@ int ProgVideo::loop(char *status)
 	}
 	SM_OBJECT->stream = 0; // pause after frame grab is finished
 	
+	// An answer the client didn't come back for during the whole frame is stale.  A new request 
+	// is answered from this frame, which stays put until streaming resumes. 
+	if (m_rgbsState==VIDEO_RGBS_READY)
+		m_rgbsState = VIDEO_RGBS_IDLE;
+	else if (m_rgbsState==VIDEO_RGBS_PENDING)
+	{
+		m_rgbsState = VIDEO_RGBS_ANSWERING;
+		answerRGBs();
+		m_rgbsState = VIDEO_RGBS_READY;
+	}
+
 	// send over USB 
-	if (g_execArg==0)
+	if (g_execArg==0 && m_view==VIDEO_VIEW_TILES && m_signatures && m_band)
+		sendTiles();
+	else if (g_execArg==0)
 		cam_sendFrame(g_chirpUsb, CAM_RES2_WIDTH, CAM_RES2_HEIGHT);
 	else
 		sendCustom();
@@ -70,19 +148,41 @@ int ProgVideo::loop(char *status)
 	return 0;
 }
 
+// Add the sums of each channel over x0..x1-1, y0..y1-1 to r, g and b, interpolating each pixel 
+// from its neighbors.
+static void rgbSum(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1, uint32_t *r, uint32_t *g, uint32_t *b)
+{
+	uint8_t *frame = (uint8_t *)SRAM1_LOC + CAM_PREBUF_LEN;
+	uint16_t x, y;
+	uint8_t rp, gp, bp;
+
+	for (y=y0; y<y1; y++)
+	{
+		for (x=x0; x<x1; x++)
+		{
+			interpolate(frame, x, y, CAM_RES2_WIDTH, &rp, &gp, &bp);
+			*r += rp;
+			*g += gp;
+			*b += bp;
+		}
+	}
+}
+
 uint32_t getRGB(uint16_t x, uint16_t y, uint8_t sat)
 {
-	uint32_t rgb;
-	uint8_t r, g, b;
-	uint16_t i, j, rsum, gsum, bsum, d;
+	uint32_t rgb, rsum=0, gsum=0, bsum=0, d;
 	int16_t x0, x1, y0, y1;
-	uint8_t *p = (uint8_t *)SRAM1_LOC + CAM_PREBUF_LEN;
 	// average a square of size W
 	
+	// the first column and row can't be interpolated, so the patch would be empty
 	if (x>=CAM_RES2_WIDTH)
 		x = CAM_RES2_WIDTH-1;
+	else if (x==0)
+		x = 1;
 	if (y>=CAM_RES2_HEIGHT)
 		y = CAM_RES2_HEIGHT-1;
+	else if (y==0)
+		y = 1;
 	
 	x0 = x-g_rgbSize;
 	if (x0<=0)
@@ -98,22 +198,10 @@ uint32_t getRGB(uint16_t x, uint16_t y, uint8_t sat)
 	if (y1>=CAM_RES2_HEIGHT)
 		y1 = CAM_RES2_HEIGHT-1;
 	
-	for (i=y0, rsum=gsum=bsum=0; i<=y1; i++)
-	{
-		for (j=x0; j<=x1; j++)
-		{
-			interpolate(p, j, i, CAM_RES2_WIDTH, &r, &g, &b);
-			rsum += r;
-			gsum += g;
-			bsum += b;
-		}
-	}
+	rgbSum(x0, y0, x1+1, y1+1, &rsum, &gsum, &bsum);
 	d = (y1-y0+1)*(x1-x0+1);
-	rsum /= d;
-	gsum /= d;
-	bsum /= d;
 	
-	rgb = rgbPack(r, g, b); 
+	rgb = rgbPack(rsum/d, gsum/d, bsum/d); 
 	if (sat)
 		return saturate(rgb);
 	else
@@ -143,12 +231,279 @@ int ProgVideo::packet(uint8_t type, const uint8_t *data, uint8_t len, bool check
 		
 		return 0;
 	}
+	else if (type==TYPE_REQUEST_GETRGBS)
+		return sendRGBs(data, len, checksum);
 	
 	// nothing rings a bell, return error
 	return -1;
 }
 
 
+// Sum of a channel over the whole cells cx0..cx1-1, cy0..cy1-1.
+static uint32_t satSum(const uint32_t *sat, uint16_t cx0, uint16_t cy0, uint16_t cx1, uint16_t cy1)
+{
+	return sat[cy1*VIDEO_SAT_COLS + cx1] - sat[cy1*VIDEO_SAT_COLS + cx0] - sat[cy0*VIDEO_SAT_COLS + cx1] + sat[cy0*VIDEO_SAT_COLS + cx0];
+}
+
+// Sums of each channel over x0..x1-1, y0..y1-1, the same as rgbSum().  The whole cells inside the 
+// patch come from the tables, the partial cells around them (or the whole patch if it doesn't 
+// cover a cell) are summed from the pixels.
+static void satRect(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1, uint32_t *r, uint32_t *g, uint32_t *b)
+{
+	const uint32_t *satr = VIDEO_SAT_MEMORY, *satg = satr + VIDEO_SAT_SIZE, *satb = satg + VIDEO_SAT_SIZE;
+	uint16_t cx0, cy0, cx1, cy1, xa, ya, xb, yb;
+
+	*r = *g = *b = 0;
+	cx0 = (x0+VIDEO_SAT_CELL-1)/VIDEO_SAT_CELL;
+	cy0 = (y0+VIDEO_SAT_CELL-1)/VIDEO_SAT_CELL;
+	// the last column and row of cells can be narrower
+	cx1 = x1==CAM_RES2_WIDTH ? VIDEO_SAT_COLS-1 : x1/VIDEO_SAT_CELL;
+	cy1 = y1==CAM_RES2_HEIGHT ? VIDEO_SAT_ROWS-1 : y1/VIDEO_SAT_CELL;
+	if (cx0>=cx1 || cy0>=cy1)
+	{
+		rgbSum(x0, y0, x1, y1, r, g, b);
+		return;
+	}
+
+	*r = satSum(satr, cx0, cy0, cx1, cy1);
+	*g = satSum(satg, cx0, cy0, cx1, cy1);
+	*b = satSum(satb, cx0, cy0, cx1, cy1);
+
+	xa = cx0*VIDEO_SAT_CELL;
+	ya = cy0*VIDEO_SAT_CELL;
+	xb = MIN(cx1*VIDEO_SAT_CELL, CAM_RES2_WIDTH);
+	yb = MIN(cy1*VIDEO_SAT_CELL, CAM_RES2_HEIGHT);
+	rgbSum(x0, y0, x1, ya, r, g, b); // above
+	rgbSum(x0, yb, x1, y1, r, g, b); // below
+	rgbSum(x0, ya, xa, yb, r, g, b); // left
+	rgbSum(xb, ya, x1, yb, r, g, b); // right
+}
+
+// Build the summed-area tables of the frame, one for each channel.  Entry (cx, cy) is the sum 
+// of the interpolated pixels above and to the left of pixel (cx, cy)*VIDEO_SAT_CELL.  The first 
+// row and column are left out, like in getRGB(), they have no neighbors to interpolate from.
+void ProgVideo::buildSat()
+{
+	uint32_t *satr = VIDEO_SAT_MEMORY, *satg = satr + VIDEO_SAT_SIZE, *satb = satg + VIDEO_SAT_SIZE;
+	uint32_t i, r, g, b, rowr, rowg, rowb;
+	uint16_t cx, cy;
+
+	for (i=0; i<VIDEO_SAT_COLS; i++)
+		satr[i] = satg[i] = satb[i] = 0;
+
+	for (cy=0; cy<VIDEO_SAT_ROWS-1; cy++)
+	{
+		satr[i] = satg[i] = satb[i] = 0;
+		i++;
+		for (cx=0, rowr=rowg=rowb=0; cx<VIDEO_SAT_COLS-1; cx++, i++)
+		{
+			r = g = b = 0;
+			rgbSum(MAX(cx*VIDEO_SAT_CELL, 1), MAX(cy*VIDEO_SAT_CELL, 1), 
+				MIN((cx+1)*VIDEO_SAT_CELL, CAM_RES2_WIDTH), MIN((cy+1)*VIDEO_SAT_CELL, CAM_RES2_HEIGHT), &r, &g, &b);
+			rowr += r;
+			rowg += g;
+			rowb += b;
+			satr[i] = satr[i-VIDEO_SAT_COLS] + rowr;
+			satg[i] = satg[i-VIDEO_SAT_COLS] + rowg;
+			satb[i] = satb[i-VIDEO_SAT_COLS] + rowb;
+		}
+	}
+}
+
+// Work out the average color of each patch of the recorded batch request, with the same patches 
+// as getRGB(), into m_rgbsResult.  Summing a patch directly costs a pixel per pixel of it, so the 
+// summed-area tables are only built if the patches add up to more pixels than the frame.  Then 
+// each patch costs its partial cells at the edges, about 8 pixels per pixel of perimeter. 
+void ProgVideo::answerRGBs()
+{
+	const uint8_t *data;
+	uint8_t flags, size, n, i;
+	uint16_t x, y, x0, y0, x1, y1;
+	uint32_t r, g, b, d, rgb, area;
+	bool sat;
+
+	flags = m_rgbsRequest[0];
+	n = (m_rgbsLen-1)/VIDEO_RGBS_PATCH_LEN;
+
+	for (i=0, area=0, data=m_rgbsRequest+1; i<n; i++, data+=VIDEO_RGBS_PATCH_LEN)
+		area += (2*data[4]+1)*(2*data[4]+1);
+	sat = area>CAM_RES2_WIDTH*CAM_RES2_HEIGHT;
+	if (sat)
+		buildSat();
+
+	for (i=0, data=m_rgbsRequest+1; i<n; i++, data+=VIDEO_RGBS_PATCH_LEN)
+	{
+		x = *(uint16_t *)(data+0);
+		y = *(uint16_t *)(data+2);
+		size = data[4];
+		// same patch as getRGB()
+		if (x>=CAM_RES2_WIDTH)
+			x = CAM_RES2_WIDTH-1;
+		else if (x==0)
+			x = 1;
+		if (y>=CAM_RES2_HEIGHT)
+			y = CAM_RES2_HEIGHT-1;
+		else if (y==0)
+			y = 1;
+		x0 = x>size ? x-size : 1;
+		y0 = y>size ? y-size : 1;
+		x1 = MIN(x+size+1, CAM_RES2_WIDTH);
+		y1 = MIN(y+size+1, CAM_RES2_HEIGHT);
+
+		if (sat)
+			satRect(x0, y0, x1, y1, &r, &g, &b);
+		else
+		{
+			r = g = b = 0;
+			rgbSum(x0, y0, x1, y1, &r, &g, &b);
+		}
+		d = (x1-x0)*(y1-y0);
+		r /= d;
+		g /= d;
+		b /= d;
+		if (flags&VIDEO_RGBS_FLAG_SATURATE)
+		{
+			rgb = saturate(rgbPack(r, g, b));
+			rgbUnpack(rgb, &r, &g, &b);
+		}
+		m_rgbsResult[i*3+0] = r;
+		m_rgbsResult[i*3+1] = g;
+		m_rgbsResult[i*3+2] = b;
+	}
+}
+
+// Called from the serial interrupt.  Working out the patches can take milliseconds, and while the 
+// stream is running the M0 is writing the next frame over the one we'd read, so the request is 
+// only recorded here, and loop() answers it from the next frame.  Until the answer is ready the 
+// client gets busy and sends the same request again. 
+int ProgVideo::sendRGBs(const uint8_t *data, uint8_t len, bool checksum)
+{
+	uint8_t *txData, n;
+
+	if (len<1+VIDEO_RGBS_PATCH_LEN || len>VIDEO_RGBS_REQUEST_LEN || (len-1)%VIDEO_RGBS_PATCH_LEN)
+	{
+		ser_sendError(SER_ERROR_INVALID_REQUEST, checksum);
+		return 0;
+	}
+
+	if (m_rgbsState==VIDEO_RGBS_READY && len==m_rgbsLen && memcmp(data, m_rgbsRequest, len)==0)
+	{
+		n = (len-1)/VIDEO_RGBS_PATCH_LEN;
+		ser_getTx(&txData);
+		memcpy(txData, m_rgbsResult, n*3);
+		ser_setTx(TYPE_RESPONSE_GETRGBS, n*3, checksum);
+		m_rgbsState = VIDEO_RGBS_IDLE;
+		return 0;
+	}
+
+	// loop() is reading the request, so leave it be, the client will ask again
+	if (m_rgbsState!=VIDEO_RGBS_ANSWERING)
+	{
+		memcpy(m_rgbsRequest, data, len);
+		m_rgbsLen = len;
+		m_rgbsState = VIDEO_RGBS_PENDING;
+	}
+	ser_sendError(SER_ERROR_BUSY, checksum);
+
+	return 0;
+}
+
+// Find the signature of a tile, the mean of each of its 4x4 pixel cells, and compare it to the 
+// signature of the tile that was sent last.  Returns true if a cell has changed by more than 
+// thresh.  Comparing to what was sent (instead of the previous frame) means that slow changes 
+// add up and get sent eventually.
+static bool tileChanged(const uint8_t *tile, uint16_t width, const uint8_t *sig, uint8_t *newSig, uint8_t thresh)
+{
+	uint16_t cx, cy, y;
+	uint16_t sum;
+	const uint8_t *p;
+	bool changed = false;
+
+	for (cy=0; cy<VIDEO_TILE_SIZE; cy+=VIDEO_TILE_CELL_SIZE)
+	{
+		for (cx=0; cx<VIDEO_TILE_SIZE; cx+=VIDEO_TILE_CELL_SIZE, sig++, newSig++)
+		{
+			if (cx>=width) // partial tile at the right edge
+			{
+				*newSig = 0;
+				continue;
+			}
+			p = tile + cy*CAM_RES2_WIDTH + cx;
+			for (y=0, sum=0; y<VIDEO_TILE_CELL_SIZE; y++, p+=CAM_RES2_WIDTH)
+				sum += p[0] + p[1] + p[2] + p[3];
+			*newSig = sum/(VIDEO_TILE_CELL_SIZE*VIDEO_TILE_CELL_SIZE);
+			if (*newSig>*sig+thresh || *newSig+thresh<*sig)
+				changed = true;
+		}
+	}
+
+	return changed;
+}
+
+// Send the frame as 16x16 tiles (TL81), only the tiles that have changed, except for every 
+// g_tileKeyframe'th frame, which is sent whole (BA81).  The frame goes out a band (row of tiles) 
+// at a time.  A band's changed tiles are packed into m_band in order, each tile's rows one after 
+// another, followed by a map with a bit for each tile of the band (bit col&7 of byte col/8).  
+// Tiles at the right edge are narrower (CAM_RES2_WIDTH%16).  Bands without changed tiles aren't 
+// sent, except for the last one, which flushes the frame.  The frame itself isn't touched, so 
+// getRGB() still reads pixels from it. 
+void ProgVideo::sendTiles()
+{
+	uint8_t *frame = (uint8_t *)SRAM1_LOC + CAM_PREBUF_LEN;
+	uint8_t *data = m_band + VIDEO_TILE_HEADER_LEN, *out, *tile;
+	uint8_t sig[VIDEO_TILE_CELLS], map[VIDEO_TILE_BAND_MAP_LEN];
+	uint16_t row, col, width, y, i;
+	int32_t len;
+	bool keyframe = m_keyframeCount==0;
+
+	if (++m_keyframeCount>=g_tileKeyframe)
+		m_keyframeCount = 0;
+
+	if (keyframe)
+	{
+		// update all of the signatures, then send the whole frame
+		for (row=0, i=0; row<VIDEO_TILE_ROWS; row++)
+		{
+			for (col=0; col<VIDEO_TILE_COLS; col++, i++)
+			{
+				width = MIN(VIDEO_TILE_SIZE, CAM_RES2_WIDTH-col*VIDEO_TILE_SIZE);
+				tileChanged(frame + row*VIDEO_TILE_SIZE*CAM_RES2_WIDTH + col*VIDEO_TILE_SIZE, width, 
+					m_signatures + i*VIDEO_TILE_CELLS, m_signatures + i*VIDEO_TILE_CELLS, 0);
+			}
+		}
+		cam_sendFrame(g_chirpUsb, CAM_RES2_WIDTH, CAM_RES2_HEIGHT);
+		return;
+	}
+
+	for (row=0, i=0; row<VIDEO_TILE_ROWS; row++)
+	{
+		memset(map, 0, VIDEO_TILE_BAND_MAP_LEN);
+		for (col=0, out=data; col<VIDEO_TILE_COLS; col++, i++)
+		{
+			width = MIN(VIDEO_TILE_SIZE, CAM_RES2_WIDTH-col*VIDEO_TILE_SIZE);
+			tile = frame + row*VIDEO_TILE_SIZE*CAM_RES2_WIDTH + col*VIDEO_TILE_SIZE;
+			if (!tileChanged(tile, width, m_signatures + i*VIDEO_TILE_CELLS, sig, g_tileThresh))
+				continue;
+
+			memcpy(m_signatures + i*VIDEO_TILE_CELLS, sig, VIDEO_TILE_CELLS);
+			map[col>>3] |= 1<<(col&7);
+			for (y=0; y<VIDEO_TILE_SIZE; y++, out+=width)
+				memcpy(out, tile + y*CAM_RES2_WIDTH, width);
+		}
+		if (out==data && row<VIDEO_TILE_ROWS-1)
+			continue;
+		memcpy(out, map, VIDEO_TILE_BAND_MAP_LEN);
+		out += VIDEO_TILE_BAND_MAP_LEN;
+
+		// fill buffer contents manually for return data 
+		len = Chirp::serialize(g_chirpUsb, m_band, VIDEO_TILE_BAND_LEN, HTYPE(FOURCC('T','L','8','1')), HINT8(row==VIDEO_TILE_ROWS-1 ? RENDER_FLAG_FLUSH : 0), 
+			UINT16(CAM_RES2_WIDTH), UINT16(CAM_RES2_HEIGHT), UINT16(row), UINTS8_NO_COPY(out-data), END);
+		if (len!=VIDEO_TILE_HEADER_LEN)
+			return;
+		g_chirpUsb->useBuffer(m_band, VIDEO_TILE_HEADER_LEN+out-data);
+	}
+}
+
 void ProgVideo::sendCustom(uint8_t renderFlags)
 {
 	uint32_t fourcc;
@@ -30,6 +30,7 @@
 #include "line.h"
 #include "progvideo.h"
 #include "calc.h"
+#include "misc.h"
 
 static const ProcModule g_module[] =
 {
@@ -51,6 +52,16 @@ struct BrightnessQ
 	uint8_t m_brightness;
 };
 
+struct Subscription
+{
+	bool m_valid;
+	bool m_checksum;
+	uint8_t m_flags;
+	uint8_t m_type;
+	uint8_t m_len;
+	uint8_t m_data[SER_SUBSCRIBE_MAX_LEN];
+};
+
 int8_t g_interface = -1;
 int8_t g_angle = 0;
 bool g_oldProtocol = false;
@@ -60,9 +71,18 @@ static uint8_t g_txBuf[SER_TXBUF_SIZE];
 static uint8_t *g_tx;
 static uint16_t g_txReadIndex; // current read index
 static uint16_t g_txLen; // current length
+static bool g_txPush = false; // g_tx holds a push
+static uint8_t g_txQBuf[SER_TXBUF_SIZE]; // a response that's waiting for a push to go out
+static uint8_t *g_txQ = NULL; // start of the waiting response, NULL if there isn't one
+static uint16_t g_txQLen;
+static uint8_t *g_txResp = g_txBuf; // start of the last response, for ser_packetChirp()
 static bool g_newPacket = false; 
 static BrightnessQ g_brightnessQ;
 static bool g_ready = false;
+static Subscription g_subscription;
+static bool g_pushing = false; // ser_push() is running the subscribed request
+static bool g_pushed;
+static uint16_t g_pushSeq;
 
 uint16_t lego_getData(uint8_t *buf, uint32_t buflen)
 {
@@ -365,6 +385,35 @@ void ser_sendError(int8_t error, bool checksum)
 }
 
 
+static void unsubscribe()
+{
+	if (g_subscription.m_valid && g_subscription.m_flags&SER_SUBSCRIBE_FLAG_PULSE)
+		LPC_SGPIO->GPIO_OENREG &= ~(1<<14); // let go of SS
+	g_subscription.m_valid = false;
+}
+
+static void subscribe(const uint8_t *rxData, uint8_t len, bool checksum)
+{
+	unsubscribe();
+	// flags, request type, request data
+	g_subscription.m_flags = rxData[0];
+	g_subscription.m_type = rxData[1];
+	g_subscription.m_len = len-2;
+	memcpy(g_subscription.m_data, rxData+2, len-2);
+	g_subscription.m_checksum = checksum;
+	// SS is only free when we're using the UART
+	if (g_interface!=SER_INTERFACE_UART)
+		g_subscription.m_flags &= ~SER_SUBSCRIBE_FLAG_PULSE;
+	if (g_subscription.m_flags&SER_SUBSCRIBE_FLAG_PULSE)
+	{
+		LPC_SGPIO->OUT_MUX_CFG14 = 4;
+		LPC_SGPIO->GPIO_OUTREG &= ~(1<<14);
+		LPC_SGPIO->GPIO_OENREG |= 1<<14;
+	}
+	g_pushSeq = 0;
+	g_subscription.m_valid = true;
+}
+
 void ser_packet(uint8_t type, const uint8_t *rxData, uint8_t len, bool checksum)
 {
 	uint8_t *txData;
@@ -472,6 +521,23 @@ void ser_packet(uint8_t type, const uint8_t *rxData, uint8_t len, bool checksum)
 		uint32_t val = (uint32_t)fps; // convert to int, round up or down
 		ser_sendResult(val, checksum);				
 	}
+	else if (type==SER_TYPE_REQUEST_SUBSCRIBE) // push results of a program request every frame
+	{
+		if (len==0) // cancel
+		{
+			unsubscribe();
+			ser_sendResult(0, checksum);
+		}
+		else if (len<2 || len-2>SER_SUBSCRIBE_MAX_LEN || rxData[1]<=SER_TYPE_REQUEST_NO_PROG_MAX)
+			ser_sendError(SER_ERROR_INVALID_REQUEST, checksum);
+		else if (g_interface!=SER_INTERFACE_UART && g_interface!=SER_INTERFACE_SS_SPI)
+			ser_sendError(SER_ERROR_TYPE_UNSUPPORTED, checksum);
+		else
+		{
+			subscribe(rxData, len, checksum);
+			ser_sendResult(0, checksum);
+		}
+	}
 	else // not able to find handler, return error
 		ser_sendError(SER_ERROR_TYPE_UNSUPPORTED, checksum);		
 }
@@ -481,9 +547,9 @@ int32_t ser_packetChirp(const uint8_t &type, const uint32_t &len, const uint8_t
 	// handle packet without checksum
 	ser_packet(type, request, len, false);
 	// send result data minus the header data, which we'll bring out explicitly (type, length, no sync)
-	CRP_RETURN(chirp, UINT8(g_tx[2]) /* type */, UINTS8(g_tx[3] /* len */, g_tx+SER_MIN_PACKET_HEADER) /* raw data */, END);
+	CRP_RETURN(chirp, UINT8(g_txResp[2]) /* type */, UINTS8(g_txResp[3] /* len */, g_txResp+SER_MIN_PACKET_HEADER) /* raw data */, END);
 	
-	// return 0 regardless.  Actual result is returned in the g_tx data.
+	// return 0 regardless.  Actual result is returned in the g_txResp data.
 	return 0;
 }
 
@@ -500,7 +566,17 @@ uint32_t txCallback(uint8_t *data, uint32_t len)
 uint8_t ser_getByte(uint8_t *c)
 {
 	if (g_txReadIndex>=g_txLen)
-		return 0;
+	{
+		if (g_txQ==NULL)
+			return 0;
+		// the push is out, move on to the response that was waiting for it
+		g_tx = g_txQ;
+		g_txLen = g_txQLen;
+		g_txReadIndex = 0;
+		g_txPush = false;
+		g_txQ = NULL;
+		g_newPacket = true;
+	}
 	*c = g_tx[g_txReadIndex++];
 	return 1;
 }
@@ -508,10 +584,11 @@ uint8_t ser_getByte(uint8_t *c)
 void ser_rxCallback()
 {
 	// parse, figure out if the message was intended for us, otherwise pass to currently running program
-	uint8_t i, a, oldState, buf[SPI2_RECEIVEBUF_SIZE];
+	uint8_t i, a, oldState;
 	uint16_t csCalc;
 	static uint16_t w, csStream;
 	static uint8_t lastByte, type, len;
+	static uint8_t buf[SER_MAXLEN]; // the receive queues hold this much, so any len fits
 	
 	while(1)
 	{
@@ -560,34 +637,24 @@ void ser_rxCallback()
 			break;
 
 		case 3:
-			if (len<=SPI2_RECEIVEBUF_SIZE)
+			if (g_serial->receiveLen()>=len)
 			{
-				if (g_serial->receiveLen()>=len)
-				{
-					g_serial->receive(buf, len);
-					g_state = 5;
-				}
+				g_serial->receive(buf, len);
+				g_state = 5;
 			}
-			else
-				g_state = 0;
 			break;
 			
 		case 4:
-			if (len<=SPI2_RECEIVEBUF_SIZE)
+			if (g_serial->receiveLen()>=len)
 			{
-				if (g_serial->receiveLen()>=len)
-				{
-					g_serial->receive(buf, len);
-					for (i=0, csCalc=0; i<len; i++)
-						csCalc += buf[i];
-					if (csCalc==csStream)
-						g_state = 5;
-					else 
-						g_state = 0;
-				}
+				g_serial->receive(buf, len);
+				for (i=0, csCalc=0; i<len; i++)
+					csCalc += buf[i];
+				if (csCalc==csStream)
+					g_state = 5;
+				else 
+					g_state = 0;
 			}
-			else
-				g_state = 0;
 			break;
 			
 		case 5:
@@ -604,41 +671,115 @@ void ser_rxCallback()
 	}
 }
 
+// A push that's still going out (or, with SPI, that the client hasn't clocked out yet).  A response 
+// can't write over it, so it waits in g_txQBuf until ser_getByte() gets to the end of the push. 
+static bool pushInFlight()
+{
+	return g_txPush && g_txReadIndex<g_txLen;
+}
+
 // These routines (getTx and setTx) are expected to be called from within an ISR, otherwise there will be a race condition between writing to 
 // the tx buffer and the txCallback reading the tx buffer. 
 uint8_t ser_getTx(uint8_t **data)
 {
-	*data = g_txBuf+SER_MAX_PACKET_HEADER; // make room for header
+	if (g_pushing) // make room for the push header too
+	{
+		*data = g_txBuf+SER_MAX_PACKET_HEADER+SER_PUSH_HEADER_SIZE;
+		return SER_TXBUF_SIZE-SER_MAX_PACKET_HEADER-SER_PUSH_HEADER_SIZE;
+	}
+	if (pushInFlight())
+		*data = g_txQBuf+SER_MAX_PACKET_HEADER;
+	else
+		*data = g_txBuf+SER_MAX_PACKET_HEADER; // make room for header
 	return SER_TXBUF_SIZE-SER_MAX_PACKET_HEADER;
 }
 
-void ser_setTx(uint8_t type, uint8_t len, bool checksum)
+// Fill in the header in front of the len bytes of data at buf+SER_MAX_PACKET_HEADER.  Returns the 
+// start of the packet, its length goes in *txLen.
+static uint8_t *setHeader(uint8_t *buf, uint8_t type, uint8_t len, bool checksum, uint16_t *txLen)
 {
-	uint8_t i;
+	uint8_t i, *tx;
 	uint16_t cs;
-	
-	g_txReadIndex = 0;
-	g_txLen = SER_MIN_PACKET_HEADER + len;
+
+	*txLen = SER_MIN_PACKET_HEADER + len;
 	if (checksum)
 	{	
-		g_tx = g_txBuf;
-		*(uint16_t *)g_tx = SER_SYNC_CHECKSUM;
+		tx = buf;
+		*(uint16_t *)tx = SER_SYNC_CHECKSUM;
 		for (i=0, cs=0; i<len; i++)
-			cs += g_txBuf[SER_MAX_PACKET_HEADER + i];
-		*(uint16_t *)(g_tx+4) = cs;
-		g_txLen += SER_PACKET_HEADER_CS_SIZE;
+			cs += buf[SER_MAX_PACKET_HEADER + i];
+		*(uint16_t *)(tx+4) = cs;
+		*txLen += SER_PACKET_HEADER_CS_SIZE;
 	}
 	else
 	{
-		g_tx = g_txBuf + SER_PACKET_HEADER_CS_SIZE;
-		*(uint16_t *)g_tx = SER_SYNC_NO_CHECKSUM;
+		tx = buf + SER_PACKET_HEADER_CS_SIZE;
+		*(uint16_t *)tx = SER_SYNC_NO_CHECKSUM;
 	}
-	g_tx[2] = type;
-	g_tx[3] = len;
+	tx[2] = type;
+	tx[3] = len;
+	return tx;
+}
+
+void ser_setTx(uint8_t type, uint8_t len, bool checksum)
+{
+	if (g_pushing)
+	{
+		if (type==SER_TYPE_RESPONSE_ERROR) // nothing new (busy), or the request can't be served, so nothing to push
+			return;
+		*(uint16_t *)(g_txBuf+SER_MAX_PACKET_HEADER) = g_pushSeq++;
+		g_txBuf[SER_MAX_PACKET_HEADER+2] = type;
+		type = SER_TYPE_RESPONSE_PUSH;
+		len += SER_PUSH_HEADER_SIZE;
+		g_pushed = true;
+	}
+	else if (pushInFlight()) 
+	{
+		// queue it behind the push, ser_getByte() picks it up (ser_getTx() put the data in g_txQBuf) 
+		g_txQ = g_txResp = setHeader(g_txQBuf, type, len, checksum, &g_txQLen);
+		return;
+	}
+	g_tx = setHeader(g_txBuf, type, len, checksum, &g_txLen);
+	if (!g_pushing)
+		g_txResp = g_tx;
+	g_txPush = g_pushing;
+	g_txReadIndex = 0;
 	g_newPacket = true;
 	g_serial->startTransmit();
 }
 
+void ser_push()
+{
+	bool pulse;
+	
+	// don't push a request the running program doesn't handle, it would switch programs
+	if (!g_subscription.m_valid || !exec_progHandlesType(g_subscription.m_type))
+		return;
+	
+	// The receive interrupt writes its responses into the same tx buffer, so keep it out while we 
+	// build ours.  And don't write over a packet that's still going out (or, with SPI, that the 
+	// client hasn't clocked out yet), or get ahead of a response that's queued behind one. 
+	__disable_irq();
+	if (g_txReadIndex<g_txLen || g_txQ)
+	{
+		__enable_irq();
+		return;
+	}
+	g_pushing = true;
+	g_pushed = false;
+	ser_packet(g_subscription.m_type, g_subscription.m_data, g_subscription.m_len, g_subscription.m_checksum);
+	g_pushing = false;
+	pulse = g_pushed && g_subscription.m_flags&SER_SUBSCRIBE_FLAG_PULSE;
+	__enable_irq();
+
+	if (pulse)
+	{
+		LPC_SGPIO->GPIO_OUTREG |= 1<<14;
+		delayus(SER_PUSH_PULSE_US);
+		LPC_SGPIO->GPIO_OUTREG &= ~(1<<14);
+	}
+}
+
 bool ser_newPacket()
 {
 	bool result = g_newPacket;
@@ -694,6 +835,7 @@ int ser_setInterface(uint8_t interface)
 	
 	if (g_serial!=NULL)
 		g_serial->close();
+	unsubscribe();
 
 	// get g_oldProtocol after we close to prevent race condition with spi interrupt routine
 	prm_get("Pixy 1.0 compatibility mode", &g_oldProtocol, END);
@@ -704,6 +846,9 @@ int ser_setInterface(uint8_t interface)
 	g_txReadIndex = 0; 
 	g_txLen = 0; 
 	g_tx = g_txBuf;
+	g_txResp = g_txBuf;
+	g_txPush = false;
+	g_txQ = NULL;
 	g_brightnessQ.m_valid = false;
 
 	switch (interface)
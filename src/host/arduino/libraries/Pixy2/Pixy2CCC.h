@@ -24,6 +24,8 @@
 
 #define CCC_RESPONSE_BLOCKS                 0x21
 #define CCC_REQUEST_BLOCKS                  0x20
+#define CCC_REQUEST_BLOCKS_MOMENTS          0x22
+#define CCC_RESPONSE_BLOCKS_MOMENTS         0x23
 
 // Defines for sigmap:
 // You can bitwise "or" these together to make a custom sigmap.
@@ -78,6 +80,26 @@ struct Block
   uint8_t m_age;
 };
 
+// A Block with the centroid and orientation Pixy works out from the blob's moments, see 
+// getBlocks(..., moments).  m_cx and m_cy are in 1/8 pixel units (divide by 8 for pixels), they 
+// follow the blob's shape instead of the middle of its bounding box.  m_orientation is the angle 
+// of the blob's long axis in degrees (-90 to 90), in the same sense as m_angle.
+struct MomentBlock : public Block
+{
+  void print()
+  {
+    char buf[64];
+    
+    Block::print();
+    sprintf(buf, "  centroid: (%d.%03d %d.%03d) orientation: %d", m_cx>>3, (m_cx&7)*125, m_cy>>3, (m_cy&7)*125, m_orientation);
+    Serial.println(buf);
+  }
+  
+  uint16_t m_cx;
+  uint16_t m_cy;
+  int16_t m_orientation;
+};
+
 template <class LinkType> class TPixy2;
 
 template <class LinkType> class Pixy2CCC
@@ -88,18 +110,47 @@ public:
     m_pixy = pixy;
   }
   
-  int8_t getBlocks(bool wait=true, uint8_t sigmap=CCC_SIG_ALL, uint8_t maxBlocks=0xff);
+  // With moments, the blocks are MomentBlocks and they're in momentBlocks instead of blocks 
+  // (which is NULL). 
+  int8_t getBlocks(bool wait=true, uint8_t sigmap=CCC_SIG_ALL, uint8_t maxBlocks=0xff, bool moments=false);
+  // Have Pixy send the blocks after every frame, instead of asking with getBlocks() (UART and 
+  // SPI with SS only).  flags can be PIXY_PUSH_PULSE. 
+  int8_t subscribeBlocks(uint8_t sigmap=CCC_SIG_ALL, uint8_t maxBlocks=0xff, uint8_t flags=0, bool moments=false);
+  // get the blocks Pixy pushed, same return values as getBlocks()
+  int8_t getPushedBlocks(bool wait=true);
   
   uint8_t numBlocks;
   Block *blocks;
+  MomentBlock *momentBlocks;
 
 private:
+  int8_t setBlocks();
+  
   TPixy2<LinkType> *m_pixy;
 };
 
-template <class LinkType> int8_t Pixy2CCC<LinkType>::getBlocks(bool wait, uint8_t sigmap, uint8_t maxBlocks)
+// point blocks or momentBlocks at the response in the buffer
+template <class LinkType> int8_t Pixy2CCC<LinkType>::setBlocks()
+{
+  if (m_pixy->m_type==CCC_RESPONSE_BLOCKS)
+  {
+    blocks = (Block *)m_pixy->m_buf;
+    numBlocks = m_pixy->m_length/sizeof(Block);
+  }
+  else if (m_pixy->m_type==CCC_RESPONSE_BLOCKS_MOMENTS)
+  {
+    momentBlocks = (MomentBlock *)m_pixy->m_buf;
+    numBlocks = m_pixy->m_length/sizeof(MomentBlock);
+  }
+  else
+    return PIXY_RESULT_ERROR;
+  return numBlocks;
+}
+
+template <class LinkType> int8_t Pixy2CCC<LinkType>::getBlocks(bool wait, uint8_t sigmap, uint8_t maxBlocks, bool moments)
 {
   blocks = NULL;
+  momentBlocks = NULL;
   numBlocks = 0;
   
   while(1)
@@ -108,18 +159,14 @@ template <class LinkType> int8_t Pixy2CCC<LinkType>::getBlocks(bool wait, uint8_
     m_pixy->m_bufPayload[0] = sigmap;
     m_pixy->m_bufPayload[1] = maxBlocks;
     m_pixy->m_length = 2;
-    m_pixy->m_type = CCC_REQUEST_BLOCKS;
+    m_pixy->m_type = moments ? CCC_REQUEST_BLOCKS_MOMENTS : CCC_REQUEST_BLOCKS;
   
     // send request
     m_pixy->sendPacket();
     if (m_pixy->recvPacket()==0)
     {
-      if (m_pixy->m_type==CCC_RESPONSE_BLOCKS)
-      {
-        blocks = (Block *)m_pixy->m_buf;
-        numBlocks = m_pixy->m_length/sizeof(Block);
-        return numBlocks;
-      }
+      if (m_pixy->m_type==(moments ? CCC_RESPONSE_BLOCKS_MOMENTS : CCC_RESPONSE_BLOCKS))
+        return setBlocks();
 	  // deal with busy and program changing states from Pixy (we'll wait)
       else if (m_pixy->m_type==PIXY_TYPE_RESPONSE_ERROR)
       {
@@ -141,4 +188,27 @@ template <class LinkType> int8_t Pixy2CCC<LinkType>::getBlocks(bool wait, uint8_
   }
 }
 
+template <class LinkType> int8_t Pixy2CCC<LinkType>::subscribeBlocks(uint8_t sigmap, uint8_t maxBlocks, uint8_t flags, bool moments)
+{
+  uint8_t request[2];
+  
+  request[0] = sigmap;
+  request[1] = maxBlocks;
+  return m_pixy->subscribe(moments ? CCC_REQUEST_BLOCKS_MOMENTS : CCC_REQUEST_BLOCKS, request, 2, flags);
+}
+
+template <class LinkType> int8_t Pixy2CCC<LinkType>::getPushedBlocks(bool wait)
+{
+  int8_t res;
+  
+  blocks = NULL;
+  momentBlocks = NULL;
+  numBlocks = 0;
+  
+  res = m_pixy->recvPush(wait);
+  if (res<0)
+    return res;
+  return setBlocks();
+}
+
 #endif
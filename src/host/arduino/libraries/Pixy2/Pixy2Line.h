@@ -30,6 +30,7 @@
 
 #define LINE_GET_MAIN_FEATURES                   0x00
 #define LINE_GET_ALL_FEATURES                    0x01
+#define LINE_GET_ALL_FEATURES_DELTA              0x02
 
 #define LINE_MODE_TURN_DELAYED                   0x01
 #define LINE_MODE_MANUAL_SELECT_VECTOR           0x02
@@ -41,6 +42,18 @@
 #define LINE_BARCODE                             0x04
 #define LINE_ALL_FEATURES                        (LINE_VECTOR | LINE_INTERSECTION | LINE_BARCODE)
 
+// delta response sections
+#define LINE_DELTA                               0x08
+#define LINE_REMOVED                             0x10
+#define LINE_INDEXED_BARCODE                     0x20
+
+#define LINE_DELTA_FULL                          0x01
+
+// these need to match Pixy's limits
+#define LINE_DELTA_MAX_VECTORS                   24
+#define LINE_DELTA_MAX_BARCODES                  16
+#define LINE_DELTA_MAX_INTERSECTIONS             4
+
 #define LINE_FLAG_INVALID                        0x02
 #define LINE_FLAG_INTERSECTION_PRESENT           0x04
 
@@ -108,6 +121,18 @@ struct Barcode
   uint8_t m_code;
 };
 
+// features reconstructed by getAllFeaturesDelta()
+struct LineDeltaState
+{
+  Vector vectors[LINE_DELTA_MAX_VECTORS];
+  Intersection intersections[LINE_DELTA_MAX_INTERSECTIONS];
+  Barcode barcodes[LINE_DELTA_MAX_BARCODES];
+  uint8_t barcodeIndexes[LINE_DELTA_MAX_BARCODES];
+  uint8_t numVectors;
+  uint8_t numIntersections;
+  uint8_t numBarcodes;
+};
+
 template <class LinkType> class TPixy2;
 
 template <class LinkType> class Pixy2Line
@@ -116,7 +141,14 @@ public:
   Pixy2Line(TPixy2<LinkType> *pixy)
   {
     m_pixy = pixy;
+    m_delta = NULL;
+    m_deltaFrame = 0;
   }	  
+
+  ~Pixy2Line()
+  {
+    free(m_delta);
+  }
  
   int8_t getMainFeatures(uint8_t features=LINE_ALL_FEATURES, bool wait=true)
   {
@@ -127,6 +159,23 @@ public:
   {
     return getFeatures(LINE_GET_ALL_FEATURES, features, wait);   
   }
+
+  // Like getAllFeatures(), but Pixy only sends the features that changed since the last call 
+  // and the vectors, intersections and barcodes are kept here.  Returns the features that 
+  // changed.  Vectors and barcodes are limited to LINE_DELTA_MAX_VECTORS and 
+  // LINE_DELTA_MAX_BARCODES, and the barcodes' m_flags are their tracking state, as with vectors. 
+  int8_t getAllFeaturesDelta(uint8_t features=LINE_ALL_FEATURES, bool wait=true);
+  // Have Pixy send the features after every frame, instead of asking with getMainFeatures() 
+  // or getAllFeatures() (UART and SPI with SS only).  type is LINE_GET_MAIN_FEATURES or 
+  // LINE_GET_ALL_FEATURES, flags can be PIXY_PUSH_PULSE. 
+  int8_t subscribeFeatures(uint8_t type=LINE_GET_MAIN_FEATURES, uint8_t features=LINE_ALL_FEATURES, uint8_t flags=0);
+  // get the features Pixy pushed, same return values as getMainFeatures()
+  int8_t getPushedFeatures(bool wait=true);
+  // have the next getAllFeaturesDelta() get everything again
+  void resync()
+  {
+    m_deltaFrame = 0;
+  }
   
   int8_t setMode(uint8_t mode);
   int8_t setNextTurn(int16_t angle);
@@ -145,16 +194,104 @@ public:
 
 private:
   int8_t getFeatures(uint8_t type, uint8_t features, bool wait);
+  int8_t parseFeatures();
+  int8_t applyDelta();
   TPixy2<LinkType> *m_pixy;
+  LineDeltaState *m_delta;
+  uint16_t m_deltaFrame; // last delta frame applied, 0 if none
   
 };
 
 
 template <class LinkType> int8_t Pixy2Line<LinkType>::getFeatures(uint8_t type,  uint8_t features, bool wait)
+{
+  vectors = NULL;
+  numVectors = 0;
+  intersections = NULL;
+  numIntersections = 0;
+  barcodes = NULL;
+  numBarcodes = 0;
+  
+  while(1)
+  {
+    // fill in request data
+    m_pixy->m_length = 2;
+    m_pixy->m_type = LINE_REQUEST_GET_FEATURES;
+    m_pixy->m_bufPayload[0] = type;
+    m_pixy->m_bufPayload[1] = features;
+ 
+    // send request
+    m_pixy->sendPacket();
+    if (m_pixy->recvPacket()==0)
+    {     
+      if (m_pixy->m_type==LINE_RESPONSE_GET_FEATURES)
+        return parseFeatures();
+      else if (m_pixy->m_type==PIXY_TYPE_RESPONSE_ERROR)
+      {
+		    // if it's not a busy response, return the error
+        if ((int8_t)m_pixy->m_buf[0]!=PIXY_RESULT_BUSY)
+		      return m_pixy->m_buf[0];
+	      else if (!wait) // we're busy
+          return PIXY_RESULT_BUSY; // new data not available yet
+      }
+    }
+    else
+      return PIXY_RESULT_ERROR;  // some kind of bitstream error
+  
+    // If we're waiting for frame data, don't thrash Pixy with requests.
+    // We can give up half a millisecond of latency (worst case)	
+    delayMicroseconds(500);
+  }
+}
+
+template <class LinkType> int8_t Pixy2Line<LinkType>::parseFeatures()
 {
   int8_t res;
   uint8_t offset, fsize, ftype, *fdata;
   
+  // parse line response
+  for (offset=0, res=0; m_pixy->m_length>offset; offset+=fsize+2)
+  {
+    ftype = m_pixy->m_buf[offset];
+    fsize = m_pixy->m_buf[offset+1];
+    fdata = &m_pixy->m_buf[offset+2]; 
+    if (ftype==LINE_VECTOR)
+    {
+      vectors = (Vector *)fdata;
+      numVectors = fsize/sizeof(Vector);
+      res |= LINE_VECTOR;
+    }
+    else if (ftype==LINE_INTERSECTION)
+    {
+      intersections = (Intersection *)fdata;
+      numIntersections = fsize/sizeof(Intersection);
+      res |= LINE_INTERSECTION;
+    }
+    else if (ftype==LINE_BARCODE)
+    {
+      barcodes = (Barcode *)fdata;
+      numBarcodes = fsize/sizeof(Barcode);
+      res |= LINE_BARCODE;
+    }
+    else
+      break; // parse error
+  }
+  return res;
+}
+
+template <class LinkType> int8_t Pixy2Line<LinkType>::subscribeFeatures(uint8_t type, uint8_t features, uint8_t flags)
+{
+  uint8_t request[2];
+  
+  request[0] = type;
+  request[1] = features;
+  return m_pixy->subscribe(LINE_REQUEST_GET_FEATURES, request, 2, flags);
+}
+
+template <class LinkType> int8_t Pixy2Line<LinkType>::getPushedFeatures(bool wait)
+{
+  int8_t res;
+  
   vectors = NULL;
   numVectors = 0;
   intersections = NULL;
@@ -162,13 +299,35 @@ template <class LinkType> int8_t Pixy2Line<LinkType>::getFeatures(uint8_t type,
   barcodes = NULL;
   numBarcodes = 0;
   
+  res = m_pixy->recvPush(wait);
+  if (res<0)
+    return res;
+  if (m_pixy->m_type!=LINE_RESPONSE_GET_FEATURES)
+    return PIXY_RESULT_ERROR;
+  return parseFeatures();
+}
+
+template <class LinkType> int8_t Pixy2Line<LinkType>::getAllFeaturesDelta(uint8_t features, bool wait)
+{
+  int8_t res;
+
+  if (m_delta==NULL)
+  {
+    m_delta = (LineDeltaState *)malloc(sizeof(LineDeltaState));
+    if (m_delta==NULL)
+      return PIXY_RESULT_ERROR;
+    m_delta->numVectors = m_delta->numIntersections = m_delta->numBarcodes = 0;
+    m_deltaFrame = 0;
+  }
+  
   while(1)
   {
     // fill in request data
-    m_pixy->m_length = 2;
+    m_pixy->m_length = 4;
     m_pixy->m_type = LINE_REQUEST_GET_FEATURES;
-    m_pixy->m_bufPayload[0] = type;
+    m_pixy->m_bufPayload[0] = LINE_GET_ALL_FEATURES_DELTA;
     m_pixy->m_bufPayload[1] = features;
+    *(uint16_t *)(m_pixy->m_bufPayload + 2) = m_deltaFrame;
  
     // send request
     m_pixy->sendPacket();
@@ -176,41 +335,21 @@ template <class LinkType> int8_t Pixy2Line<LinkType>::getFeatures(uint8_t type,
     {     
       if (m_pixy->m_type==LINE_RESPONSE_GET_FEATURES)
       {
-        // parse line response
-		    for (offset=0, res=0; m_pixy->m_length>offset; offset+=fsize+2)
-        {
-          ftype = m_pixy->m_buf[offset];
-          fsize = m_pixy->m_buf[offset+1];
-          fdata = &m_pixy->m_buf[offset+2]; 
-          if (ftype==LINE_VECTOR)
-          {
-            vectors = (Vector *)fdata;
-            numVectors = fsize/sizeof(Vector);
-            res |= LINE_VECTOR;
-		      }
-		      else if (ftype==LINE_INTERSECTION)
-          {
-            intersections = (Intersection *)fdata;
-            numIntersections = fsize/sizeof(Intersection);
-            res |= LINE_INTERSECTION;
-          }
- 		      else if (ftype==LINE_BARCODE)
-          {
-            barcodes = (Barcode *)fdata;
-            numBarcodes = fsize/sizeof(Barcode);;
-            res |= LINE_BARCODE;
-          }
-          else
-            break; // parse error
-        }
+        res = applyDelta();
+        vectors = m_delta->vectors;
+        numVectors = m_delta->numVectors;
+        intersections = m_delta->intersections;
+        numIntersections = m_delta->numIntersections;
+        barcodes = m_delta->barcodes;
+        numBarcodes = m_delta->numBarcodes;
         return res;
       }
       else if (m_pixy->m_type==PIXY_TYPE_RESPONSE_ERROR)
       {
-		    // if it's not a busy response, return the error
+        // if it's not a busy response, return the error
         if ((int8_t)m_pixy->m_buf[0]!=PIXY_RESULT_BUSY)
-		      return m_pixy->m_buf[0];
-	      else if (!wait) // we're busy
+          return m_pixy->m_buf[0];
+        else if (!wait) // we're busy
           return PIXY_RESULT_BUSY; // new data not available yet
       }
     }
@@ -223,6 +362,101 @@ template <class LinkType> int8_t Pixy2Line<LinkType>::getFeatures(uint8_t type,
   }
 }
 
+template <class LinkType> int8_t Pixy2Line<LinkType>::applyDelta()
+{
+  int8_t res;
+  uint8_t offset, fsize, ftype, *fdata, i, j, n;
+  LineDeltaState *d = m_delta;
+
+  // the response starts with the frame number and flags
+  if (m_pixy->m_length<6 || m_pixy->m_buf[0]!=LINE_DELTA)
+  {
+    m_deltaFrame = 0;
+    return PIXY_RESULT_ERROR;
+  }
+  if (m_pixy->m_buf[4]&LINE_DELTA_FULL)
+    d->numVectors = d->numIntersections = d->numBarcodes = 0;
+  
+  for (offset=6, res=0; m_pixy->m_length>offset; offset+=fsize+2)
+  {
+    ftype = m_pixy->m_buf[offset];
+    fsize = m_pixy->m_buf[offset+1];
+    fdata = &m_pixy->m_buf[offset+2]; 
+    if (ftype==LINE_REMOVED) // (type, index) pairs
+    {
+      for (i=0; i<fsize; i+=2)
+      {
+        if (fdata[i]==LINE_VECTOR)
+        {
+          for (j=0; j<d->numVectors && d->vectors[j].m_index!=fdata[i+1]; j++);
+          if (j<d->numVectors)
+            d->vectors[j] = d->vectors[--d->numVectors];
+          res |= LINE_VECTOR;
+        }
+        else if (fdata[i]==LINE_INDEXED_BARCODE)
+        {
+          for (j=0; j<d->numBarcodes && d->barcodeIndexes[j]!=fdata[i+1]; j++);
+          if (j<d->numBarcodes)
+          {
+            d->numBarcodes--;
+            d->barcodes[j] = d->barcodes[d->numBarcodes];
+            d->barcodeIndexes[j] = d->barcodeIndexes[d->numBarcodes];
+          }
+          res |= LINE_BARCODE;
+        }
+      }
+    }
+    else if (ftype==LINE_VECTOR) // new or moved vectors
+    {
+      for (i=0; i<fsize; i+=sizeof(Vector))
+      {
+        n = ((Vector *)(fdata+i))->m_index;
+        for (j=0; j<d->numVectors && d->vectors[j].m_index!=n; j++);
+        if (j==d->numVectors)
+        {
+          if (j==LINE_DELTA_MAX_VECTORS)
+            continue;
+          d->numVectors++;
+        }
+        memcpy(&d->vectors[j], fdata+i, sizeof(Vector));
+      }
+      res |= LINE_VECTOR;
+    }
+    else if (ftype==LINE_INTERSECTION) // all intersections, whenever they change
+    {
+      d->numIntersections = fsize/sizeof(Intersection);
+      if (d->numIntersections>LINE_DELTA_MAX_INTERSECTIONS)
+        d->numIntersections = LINE_DELTA_MAX_INTERSECTIONS;
+      memcpy(d->intersections, fdata, d->numIntersections*sizeof(Intersection));
+      res |= LINE_INTERSECTION;
+    }
+    else if (ftype==LINE_INDEXED_BARCODE) // new or moved barcodes, x, y, flags, code, index, reserved
+    {
+      for (i=0; i<fsize; i+=6)
+      {
+        n = fdata[i+4];
+        for (j=0; j<d->numBarcodes && d->barcodeIndexes[j]!=n; j++);
+        if (j==d->numBarcodes)
+        {
+          if (j==LINE_DELTA_MAX_BARCODES)
+            continue;
+          d->numBarcodes++;
+        }
+        memcpy(&d->barcodes[j], fdata+i, sizeof(Barcode));
+        d->barcodeIndexes[j] = n;
+      }
+      res |= LINE_BARCODE;
+    }
+    else // parse error, start over next time
+    {
+      m_deltaFrame = 0;
+      return PIXY_RESULT_ERROR;
+    }
+  }
+  m_deltaFrame = *(uint16_t *)(m_pixy->m_buf + 2);
+  return res;
+}
+
 template <class LinkType> int8_t Pixy2Line<LinkType>::setMode(uint8_t mode)
 {
   uint32_t res;
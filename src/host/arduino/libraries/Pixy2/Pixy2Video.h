@@ -21,6 +21,21 @@
 #define _PIXY2VIDEO_H
 
 #define VIDEO_REQUEST_GET_RGB   0x70
+#define VIDEO_REQUEST_GET_RGBS  0x72
+#define VIDEO_RESPONSE_GET_RGBS 0x73
+#define VIDEO_MAX_PATCHES       50
+
+// A patch for getRGBs(), the square around m_x, m_y out to m_size pixels.  m_r, m_g, m_b are 
+// filled in with its average color.
+struct RGBPatch
+{
+  uint16_t m_x;
+  uint16_t m_y;
+  uint8_t m_size;
+  uint8_t m_r;
+  uint8_t m_g;
+  uint8_t m_b;
+};
 
 template <class LinkType> class TPixy2;
 
@@ -33,6 +48,9 @@ public:
   }	  
  
   int8_t getRGB(uint16_t x, uint16_t y, uint8_t *r, uint8_t *g, uint8_t *b, bool saturate=true);
+  // Up to VIDEO_MAX_PATCHES patches in one request.  Pixy answers from the next frame, so this 
+  // waits up to a frame period.
+  int8_t getRGBs(RGBPatch *patches, uint8_t n, bool saturate=true);
   
 private:
   TPixy2<LinkType> *m_pixy;
@@ -69,4 +87,46 @@ template <class LinkType> int8_t Pixy2Video<LinkType>::getRGB(uint16_t x, uint16
   }
 }
 
+template <class LinkType> int8_t Pixy2Video<LinkType>::getRGBs(RGBPatch *patches, uint8_t n, bool saturate)
+{
+  uint8_t i;
+  
+  if (n==0 || n>VIDEO_MAX_PATCHES)
+    return PIXY_RESULT_ERROR;
+
+  while(1)
+  {
+    *(m_pixy->m_bufPayload + 0) = saturate;
+    for (i=0; i<n; i++)
+    {
+      *(int16_t *)(m_pixy->m_bufPayload + 1 + i*5) = patches[i].m_x;
+      *(int16_t *)(m_pixy->m_bufPayload + 3 + i*5) = patches[i].m_y;
+      *(m_pixy->m_bufPayload + 5 + i*5) = patches[i].m_size;
+    }
+    m_pixy->m_length = 1 + n*5;
+    m_pixy->m_type = VIDEO_REQUEST_GET_RGBS;
+    m_pixy->sendPacket();
+    if (m_pixy->recvPacket()==0)
+    {
+      if (m_pixy->m_type==VIDEO_RESPONSE_GET_RGBS && m_pixy->m_length==n*3)
+      {
+        for (i=0; i<n; i++)
+        {
+          patches[i].m_r = *(m_pixy->m_buf + i*3 + 0);
+          patches[i].m_g = *(m_pixy->m_buf + i*3 + 1);
+          patches[i].m_b = *(m_pixy->m_buf + i*3 + 2);
+        }
+        return 0;
+      }
+      // deal with busy (the answer isn't ready yet) and program changing 
+      else if (m_pixy->m_type==PIXY_TYPE_RESPONSE_ERROR && ((int8_t)m_pixy->m_buf[0]==PIXY_RESULT_BUSY || (int8_t)m_pixy->m_buf[0]==PIXY_RESULT_PROG_CHANGING))
+      {
+        delayMicroseconds(500); // don't be a drag
+        continue;
+      }
+    }
+    return PIXY_RESULT_ERROR;     
+  }
+}
+
 #endif
@@ -41,6 +41,8 @@
 #define PIXY_TYPE_REQUEST_LED                0x14
 #define PIXY_TYPE_REQUEST_LAMP               0x16
 #define PIXY_TYPE_REQUEST_FPS                0x18
+#define PIXY_TYPE_REQUEST_SUBSCRIBE          0x1a
+#define PIXY_TYPE_RESPONSE_PUSH              0x1b
 
 #define PIXY_RESULT_OK                       0
 #define PIXY_RESULT_ERROR                    -1
@@ -50,6 +52,10 @@
 #define PIXY_RESULT_BUTTON_OVERRIDE          -5
 #define PIXY_RESULT_PROG_CHANGING            -6
 
+// subscription flags
+#define PIXY_PUSH_PULSE                      0x01 // Pixy pulses SS (I/O connector pin 7) after each push, UART only
+#define PIXY_PUSH_HEADER_SIZE                3
+
 // RC-servo values
 #define PIXY_RCS_MIN_POS                     0
 #define PIXY_RCS_MAX_POS                     1000L
@@ -92,10 +98,13 @@ public:
   int8_t setLamp(uint8_t upper, uint8_t lower);
   int8_t getResolution();
   int8_t getFPS();
+  // stop the results Pixy pushes after ccc.subscribeBlocks() or line.subscribeFeatures()
+  int8_t unsubscribe();
   
   Version *version;
   uint16_t frameWidth;
   uint16_t frameHeight; 
+  uint16_t pushSeq; // sequence number of the last pushed result, gaps mean results were missed
   
   // Color connected components, color codes
   Pixy2CCC<LinkType> ccc;
@@ -112,9 +121,11 @@ public:
   LinkType m_link;
   
 private:
-  int16_t getSync();
-  int16_t recvPacket();
+  int16_t getSync(bool quiet=false);
+  int16_t recvPacket(bool quiet=false, bool push=false);
   int16_t sendPacket();
+  int8_t subscribe(uint8_t type, const uint8_t *data, uint8_t len, uint8_t flags);
+  int8_t recvPush(bool wait);
 
   uint8_t *m_buf;
   uint8_t *m_bufPayload;
@@ -131,6 +142,7 @@ template <class LinkType> TPixy2<LinkType>::TPixy2() : ccc(this), line(this), vi
   // shifted buffer is used for sending, so we have space to write header information
   m_bufPayload = m_buf + PIXY_SEND_HEADER_SIZE;
   frameWidth = frameHeight = 0;
+  pushSeq = 0;
   version = NULL;
 }
 
@@ -166,7 +178,7 @@ template <class LinkType> int8_t TPixy2<LinkType>::init(uint32_t arg)
 }
 
 
-template <class LinkType> int16_t TPixy2<LinkType>::getSync()
+template <class LinkType> int16_t TPixy2<LinkType>::getSync(bool quiet)
 {
   uint8_t i, j, c, cprev;
   int16_t res;
@@ -202,7 +214,8 @@ template <class LinkType> int16_t TPixy2<LinkType>::getSync()
       if (j>=4)
       {
 #ifdef PIXY_DEBUG
-        Serial.println("error: no response");
+        if (!quiet)
+          Serial.println("error: no response");
 #endif		  
         return PIXY_RESULT_ERROR;
       }
@@ -214,12 +227,15 @@ template <class LinkType> int16_t TPixy2<LinkType>::getSync()
 }
 
 
-template <class LinkType> int16_t TPixy2<LinkType>::recvPacket()
+// Receives the next packet.  Unless push is set, pushed packets are skipped -- a response waits for 
+// a push that's already going out, so the push can come first. 
+template <class LinkType> int16_t TPixy2<LinkType>::recvPacket(bool quiet, bool push)
 {
   uint16_t csCalc, csSerial;
   int16_t res;
   
-  res = getSync();
+next:
+  res = getSync(quiet);
   if (res<0)
     return res;
 
@@ -259,6 +275,8 @@ template <class LinkType> int16_t TPixy2<LinkType>::recvPacket()
     if (res<0)
       return res;
   }
+  if (m_type==PIXY_TYPE_RESPONSE_PUSH && !push)
+    goto next;
   return PIXY_RESULT_OK;
 }
 
@@ -433,4 +451,51 @@ template <class LinkType> int8_t TPixy2<LinkType>::getFPS()
       return PIXY_RESULT_ERROR;  // some kind of bitstream error	
 }
 
+template <class LinkType> int8_t TPixy2<LinkType>::subscribe(uint8_t type, const uint8_t *data, uint8_t len, uint8_t flags)
+{
+  uint8_t i;
+  
+  m_bufPayload[0] = flags;
+  m_bufPayload[1] = type;
+  memcpy(m_bufPayload + 2, data, len);
+  m_length = type ? len + 2 : 0; // an empty request cancels
+  m_type = PIXY_TYPE_REQUEST_SUBSCRIBE;
+  sendPacket();
+  // skip over anything that was already being pushed 
+  for (i=0; i<4; i++)
+  {
+    if (recvPacket()!=0)
+      break;
+    if (m_type==PIXY_TYPE_RESPONSE_RESULT && m_length==4)
+      return (int8_t)*(uint32_t *)m_buf;
+    if (m_type==PIXY_TYPE_RESPONSE_ERROR)
+      return (int8_t)m_buf[0];
+  }
+  return PIXY_RESULT_ERROR;  // some kind of bitstream error	
+}
+
+template <class LinkType> int8_t TPixy2<LinkType>::unsubscribe()
+{
+  return subscribe(0, NULL, 0, 0);
+}
+
+// Receives the next pushed result and unwraps it, so m_type, m_length and m_buf are as if it 
+// were the response to the subscribed request. 
+template <class LinkType> int8_t TPixy2<LinkType>::recvPush(bool wait)
+{
+  while(1)
+  {
+    if (recvPacket(true, true)==0 && m_type==PIXY_TYPE_RESPONSE_PUSH && m_length>=PIXY_PUSH_HEADER_SIZE)
+    {
+      pushSeq = *(uint16_t *)m_buf;
+      m_type = m_buf[2];
+      m_length -= PIXY_PUSH_HEADER_SIZE;
+      memmove(m_buf, m_buf + PIXY_PUSH_HEADER_SIZE, m_length);
+      return PIXY_RESULT_OK;
+    }
+    else if (!wait)
+      return PIXY_RESULT_BUSY; // new data not available yet
+  }
+}
+
 #endif
@@ -0,0 +1,185 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+// Benchmarks the firmware's JPEG encoder (main_m4's jpegmain.cpp, dct.cpp and jpegenc.cpp, built 
+// for the host with the SIMD intrinsics emulated, see simd.h).  The input is raw 8-bit Bayer 
+// frames, e.g. frames saved with get_raw_frame, or a synthetic frame if no file is given.  It 
+// prints the encoded output rate in MB/s, which is mostly a measure of the Huffman coder, and 
+// the frame rate.  By default the frames are encoded with jpeg_encode(), like on the camera.  
+// With -t they are encoded by libjpegenc, in slices of -s MCU rows spread over the threads.  
+// With -o the JPEGs of the last repeat are saved, one after another (MJPEG), so the output can 
+// be checked and compared between versions of the encoder. 
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include "pixytypes.h"
+#include "jpegenc.h"
+#include "libjpegenc.h"
+
+static double seconds()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+// gradients, some hard edges and a little noise, so all of the coder's paths get used
+static void synthFrame(uint8_t *frame, uint16_t width, uint16_t height)
+{
+	uint32_t x, y, r=1;
+	uint8_t v;
+
+	for (y=0; y<height; y++)
+	{
+		for (x=0; x<width; x++)
+		{
+			r = r*1103515245 + 12345;
+			v = (x + 2*y)/3 + ((r>>16)&7);
+			if (((x/40)^(y/40))&1)
+				v ^= 0x60;
+			frame[y*width + x] = v;
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	FILE *file;
+	const char *filename=NULL, *outname=NULL;
+	uint32_t i, f, frameSize, frames, repeats=100, width=316, height=208, quality=50, threads=0, sliceRows=1, size, total=0;
+	uint8_t *pixels;
+	std::vector<uint8_t> data, out, mjpeg;
+	JpegEncoder encoder;
+	bool sliced=false;
+	double start, secs;
+
+	for (i=1; i<(uint32_t)argc; i++)
+	{
+		if (strcmp(argv[i], "-w")==0 && i+1<(uint32_t)argc)
+			width = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-h")==0 && i+1<(uint32_t)argc)
+			height = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-q")==0 && i+1<(uint32_t)argc)
+			quality = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-r")==0 && i+1<(uint32_t)argc)
+			repeats = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-t")==0 && i+1<(uint32_t)argc)
+		{
+			threads = atoi(argv[++i]);
+			sliced = true;
+		}
+		else if (strcmp(argv[i], "-s")==0 && i+1<(uint32_t)argc)
+			sliceRows = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-o")==0 && i+1<(uint32_t)argc)
+			outname = argv[++i];
+		else if (argv[i][0]!='-' && filename==NULL)
+			filename = argv[i];
+		else
+		{
+			printf("usage: jpeg_bench [raw Bayer frame file] [-w width] [-h height] [-q quality] [-r repeats] [-t threads] [-s slice rows] [-o output jpeg]\n");
+			printf("  frames are %ux%u by default, and a synthetic frame is used if there's no file\n", width, height);
+			printf("  -t 0 uses a thread per core, -s is in MCU rows (16 pixel rows)\n");
+			return -1;
+		}
+	}
+	if (width<16 || height<16 || quality<1 || quality>100 || sliceRows<1)
+	{
+		fprintf(stderr, "bad frame size or quality\n");
+		return -1;
+	}
+
+	// The encoder interpolates from the pixels around each one, so leave a row (and a bit) of 
+	// slack before and after each frame, like the frame buffer on the camera.
+	frameSize = width*height;
+	if (filename)
+	{
+		file = fopen(filename, "rb");
+		if (file==NULL)
+		{
+			fprintf(stderr, "unable to open %s\n", filename);
+			return -1;
+		}
+		fseek(file, 0, SEEK_END);
+		frames = ftell(file)/frameSize;
+		fseek(file, 0, SEEK_SET);
+		if (frames==0)
+		{
+			fprintf(stderr, "%s is smaller than a %ux%u frame\n", filename, width, height);
+			return -1;
+		}
+		data.resize((frames + 2)*frameSize);
+		if (fread(&data[frameSize], frameSize, frames, file)!=frames)
+		{
+			fprintf(stderr, "unable to read %s\n", filename);
+			return -1;
+		}
+		fclose(file);
+	}
+	else
+	{
+		frames = 1;
+		data.resize(3*frameSize);
+		synthFrame(&data[frameSize], width, height);
+	}
+	// the output can't be bigger than this, even at quality 100
+	out.resize(frameSize*2 + 0x400);
+	if (sliced)
+		encoder.open(threads);
+
+	start = seconds();
+	for (i=0; i<repeats; i++)
+	{
+		for (f=0; f<frames; f++)
+		{
+			pixels = &data[(f + 1)*frameSize];
+			Frame8 frame(pixels, width, height);
+			if (sliced)
+			{
+				encoder.encode(&frame, quality, &out, sliceRows);
+				size = out.size();
+			}
+			else
+			{
+				size = out.size();
+				jpeg_encode(&frame, quality, &out[0], &size);
+			}
+			total += size;
+			if (i==repeats-1)
+				mjpeg.insert(mjpeg.end(), out.begin(), out.begin() + size);
+		}
+	}
+	secs = seconds() - start;
+
+	printf("%u frames, %u bytes per frame on average\n", repeats*frames, total/(repeats*frames));
+	printf("%.2f MB/s of JPEG, %.1f frames/s\n", total/secs/1e6, repeats*frames/secs);
+
+	if (outname)
+	{
+		file = fopen(outname, "wb");
+		if (file==NULL)
+		{
+			fprintf(stderr, "unable to open %s\n", outname);
+			return -1;
+		}
+		fwrite(&mjpeg[0], 1, mjpeg.size(), file);
+		fclose(file);
+	}
+
+	return 0;
+}
@@ -0,0 +1,74 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+#ifndef _LIBJPEGENC_H
+#define _LIBJPEGENC_H
+
+#include <stdint.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include "pixytypes.h"
+#include "jpegenc.h"
+
+// Encodes raw Bayer frames (Frame8) to JPEG with the firmware's encoder (main_m4's jpegmain.cpp,
+// dct.cpp and jpegenc.cpp), split across threads.  The frame is cut into slices of whole 16-row
+// MCU rows, each slice is encoded by itself, and the slices are put back together with restart
+// markers (DRI/RSTn) between them, so the result is a single baseline JPEG that any decoder can
+// read.  Writing the encoded frames one after another gives an MJPEG stream.
+class JpegEncoder
+{
+public:
+	JpegEncoder();
+	~JpegEncoder();
+
+	// threads is the number of threads encoding, including the one calling encode(), 0 for one
+	// per core.  Without open(), encode() runs on the calling thread only.
+	int open(unsigned threads=0);
+	void close();
+
+	// sliceRows is the number of MCU rows (16 pixel rows) in each slice.  Smaller slices balance
+	// the threads better, but each restart marker costs 2 bytes and up to a byte of padding.
+	// Returns 0, or -1 if the frame is smaller than an MCU.
+	int encode(const Frame8 *frame, uint8_t quality, std::vector<uint8_t> *out, uint16_t sliceRows=1);
+
+private:
+	void worker();
+	void encodeSlices();
+	void encodeSlice(unsigned slice);
+
+	std::vector<std::thread> m_threads;
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+	std::condition_variable m_doneCond;
+	uint32_t m_gen;
+	unsigned m_busy;
+	bool m_quit;
+
+	// the current frame, padded, see encode()
+	std::vector<uint8_t> m_pixels;
+	Frame8 m_frame;
+	jpeg_t m_ctx;
+	uint16_t m_sliceRows;
+	unsigned m_slices;
+	std::atomic<unsigned> m_next;
+	unsigned m_done;
+	std::vector<std::vector<uint8_t> > m_sliceOut;
+	std::vector<uint32_t> m_sliceSize;
+};
+
+#endif
@@ -0,0 +1,209 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+#include <string.h>
+#include "libjpegenc.h"
+
+// the headers (SOI, APP0, DQT, SOF0, DHT, DRI and SOS) are about 620 bytes
+#define JPEG_HEADER_SIZE   0x400
+// rows and bytes of slack around the frame, for the interpolation at the edges
+#define JPEG_PAD_ROWS      2
+#define JPEG_PAD_BYTES     16
+
+JpegEncoder::JpegEncoder()
+{
+	m_gen = 0;
+	m_busy = 0;
+	m_quit = false;
+	m_sliceRows = 1;
+	m_slices = 0;
+	m_next = 0;
+	m_done = 0;
+}
+
+JpegEncoder::~JpegEncoder()
+{
+	close();
+}
+
+int JpegEncoder::open(unsigned threads)
+{
+	unsigned i;
+
+	close();
+
+	if (threads==0)
+		threads = std::thread::hardware_concurrency();
+	// the calling thread is one of them
+	for (i=1; i<threads; i++)
+		m_threads.push_back(std::thread(&JpegEncoder::worker, this));
+
+	return 0;
+}
+
+void JpegEncoder::close()
+{
+	unsigned i;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_quit = true;
+	}
+	m_cond.notify_all();
+	for (i=0; i<m_threads.size(); i++)
+		m_threads[i].join();
+	m_threads.clear();
+	m_quit = false;
+}
+
+void JpegEncoder::worker()
+{
+	uint32_t gen = 0;
+
+	while(1)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_cond.wait(lock, [&]{ return m_quit || m_gen!=gen; });
+			if (m_quit)
+				return;
+			gen = m_gen;
+			m_busy++;
+		}
+
+		encodeSlices();
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_busy--;
+		}
+		m_doneCond.notify_all();
+	}
+}
+
+// Take slices until there are none left.  The frame and the slice buffers only change while
+// no worker is busy, see encode().
+void JpegEncoder::encodeSlices()
+{
+	unsigned slice;
+
+	while ((slice=m_next++)<m_slices)
+	{
+		encodeSlice(slice);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_done++;
+	}
+}
+
+void JpegEncoder::encodeSlice(unsigned slice)
+{
+	jpeg_t ctx;
+	std::vector<uint8_t> &out = m_sliceOut[slice];
+	uint16_t y0 = slice*m_sliceRows*16;
+	int res;
+
+	// Each slice starts with the DC predictions reset, like after a restart marker, so it only
+	// needs its own copy of the context.  If the buffer is too small, double it and try again.
+	// The buffers are kept, so this only happens for the first few frames.
+	while(1)
+	{
+		ctx = m_ctx;
+		jpeg_setOutput(&ctx, &out[0], out.size());
+		res = jpeg_encodeRows(&ctx, &m_frame, y0, y0 + m_sliceRows*16);
+		if (res>=0)
+			break;
+		out.resize(out.size()*2);
+	}
+	m_sliceSize[slice] = res;
+}
+
+int JpegEncoder::encode(const Frame8 *frame, uint8_t quality, std::vector<uint8_t> *out, uint16_t sliceRows)
+{
+	uint8_t header[JPEG_HEADER_SIZE];
+	int16_t width = frame->m_width, height = frame->m_height;
+	uint32_t i, index, size, mcuRows;
+	uint8_t *pixels;
+
+	if (width<16 || height<16)
+		return -1;
+	if (sliceRows==0)
+		sliceRows = 1;
+	mcuRows = height/16;
+
+	// A worker that woke up late for the last frame may still be looking for slices, so wait
+	// for it before changing anything.
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_doneCond.wait(lock, [&]{ return m_busy==0; });
+
+	// The encoder interpolates from the pixels around each one, so copy the frame with a couple
+	// of rows mirrored above and below it (keeping the Bayer pattern), like the frame buffer on
+	// the camera, which has a row of slack before and after the frame.
+	m_pixels.resize((height + 2*JPEG_PAD_ROWS)*width + 2*JPEG_PAD_BYTES);
+	pixels = &m_pixels[JPEG_PAD_ROWS*width + JPEG_PAD_BYTES];
+	memcpy(pixels, frame->m_pixels, height*width);
+	for (i=1; i<=JPEG_PAD_ROWS; i++)
+	{
+		memcpy(pixels - i*width, pixels + i*width, width);
+		memcpy(pixels + (height - 1 + i)*width, pixels + (height - 1 - i)*width, width);
+	}
+	m_frame = Frame8(pixels, width, height);
+
+	m_sliceRows = sliceRows;
+	m_slices = (mcuRows + sliceRows - 1)/sliceRows;
+	// one restart interval per slice, or none if it's all one slice
+	jpeg_init(&m_ctx, quality, m_slices>1 ? (width/16)*sliceRows : 0);
+	jpeg_setOutput(&m_ctx, header, sizeof(header));
+	huffman_start(&m_ctx, height&-16, width&-16);
+
+	if (m_sliceOut.size()<m_slices)
+	{
+		m_sliceOut.resize(m_slices);
+		m_sliceSize.resize(m_slices);
+	}
+	for (i=0; i<m_slices; i++)
+	{
+		if (m_sliceOut[i].size()==0)
+			m_sliceOut[i].resize(width*sliceRows*16/4 + JPEG_HEADER_SIZE);
+	}
+
+	// start the workers and do our share
+	m_done = 0;
+	m_next = 0;
+	m_gen++;
+	lock.unlock();
+	m_cond.notify_all();
+	encodeSlices();
+	lock.lock();
+	m_doneCond.wait(lock, [&]{ return m_done==m_slices; });
+	lock.unlock();
+
+	// header, slice 0, RST0, slice 1, RST1, ..., RST7, RST0, ..., last slice, EOI
+	size = m_ctx.outIndex;
+	for (i=0; i<m_slices; i++)
+		size += m_sliceSize[i] + 2;
+	out->resize(size);
+	memcpy(&(*out)[0], header, m_ctx.outIndex);
+	index = m_ctx.outIndex;
+	for (i=0; i<m_slices; i++)
+	{
+		memcpy(&(*out)[index], &m_sliceOut[i][0], m_sliceSize[i]);
+		index += m_sliceSize[i];
+		(*out)[index++] = 0xff;
+		(*out)[index++] = i<m_slices-1 ? 0xd0 + (i&7) : 0xd9;
+	}
+
+	return 0;
+}
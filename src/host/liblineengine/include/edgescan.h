@@ -0,0 +1,72 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+#ifndef _EDGESCAN_H
+#define _EDGESCAN_H
+
+#include <stdint.h>
+#include "cameravals.h"
+
+// worst case edge stream length for one frame: one edge every 3 pixels for horizontal scans, 
+// one every 4 for vertical scans, plus line codes and EQ_FRAME_END 
+#define EDGESCAN_MAX_FRAME_LEN(width, height)  ((uint32_t)(height)*((width)/3 + (width)/4 + 4) + 1)
+
+// Host version of the M0 edge detector (hScan() and vScan() in libpixy_m0/src/frame_m0.c).  It 
+// turns frames of 8-bit luma (e.g. the 4014 frames the firmware sends in line mode) into the same 
+// edge stream the M0 produces, so the line engine can be run on recorded video.  The 
+// differences and thresholds are computed 16 (SSE2) or 32 (AVX2) pixels at a time into bit 
+// masks, and the hysteresis state machine then jumps from edge to edge through the masks.  The 
+// output is identical to the M0 code, which is kept here as hScanRef()/vScanRef() for checking. 
+class EdgeScanner
+{
+public:
+	EdgeScanner(uint16_t width=CAM_RES3_WIDTH, uint16_t height=CAM_RES3_HEIGHT);
+	~EdgeScanner();
+
+	// same as the M0's setEdgeParams(), hThresh is usually thresh*LINE_HTHRESH_RATIO
+	void setParams(uint16_t dist, uint16_t thresh, uint16_t hThresh);
+
+	// scan a whole frame (width*height bytes) into edges, terminated by EQ_FRAME_END.  Returns the 
+	// number of values written, or -1 if len is less than EDGESCAN_MAX_FRAME_LEN() or we're out 
+	// of memory.
+	int scanFrame(const uint8_t *luma, uint16_t *edges, uint32_t len, bool ref=false);
+
+	// scan one line, returns the number of values written, including the line code 
+	uint32_t hScan(const uint8_t *row, uint16_t *edges);
+	uint32_t vScan(const uint8_t *row, const uint8_t *prev, uint16_t *edges);
+	uint32_t hScanRef(const uint8_t *row, uint16_t *edges);
+	uint32_t vScanRef(const uint8_t *row, const uint8_t *prev, uint16_t *edges);
+
+	// "sse2", "avx2" or "none"
+	const char *simd();
+
+private:
+	void masks(const uint8_t *a, const uint8_t *b, uint16_t n);
+
+	uint16_t m_width;
+	uint16_t m_height;
+	uint16_t m_dist;
+	uint16_t m_thresh;
+	uint16_t m_hThresh;
+	bool m_avx2;
+
+	// one bit per pixel, 64 pixels per word
+	uint16_t m_words;
+	uint64_t *m_neg;   // diff<=-thresh
+	uint64_t *m_pos;   // diff>=thresh
+	uint64_t *m_hNeg;  // diff<=-hThresh
+	uint64_t *m_hPos;  // diff>=hThresh
+};
+
+#endif
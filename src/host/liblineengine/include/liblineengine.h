@@ -0,0 +1,30 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+#ifndef _LIBLINEENGINE_H
+#define _LIBLINEENGINE_H
+
+#include "lineengine.h"
+
+// The trackers use the millisecond timer (getTimerMs()) to decide when a line, intersection or 
+// barcode becomes valid or invalid.  On the host this timer is a virtual clock, one per thread, 
+// so recorded edge streams can be replayed faster than real time and still be tracked as if they 
+// were arriving at the camera's frame rate.  Advance it once per frame, e.g. by 16 ms for 60 fps. 
+// (The microsecond timer, which is used for the stage times, is the real monotonic clock.)
+void lineengine_setTimeMs(uint16_t ms);
+void lineengine_advanceTimeMs(uint16_t ms);
+uint16_t lineengine_getTimeMs();
+
+#endif
@@ -0,0 +1,366 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+#include <new>
+#include <string.h>
+#include "equeue.h"
+#include "lineengine.h"
+#include "edgescan.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define EDGESCAN_X86
+#include <emmintrin.h>
+#include <immintrin.h>
+#endif
+
+EdgeScanner::EdgeScanner(uint16_t width, uint16_t height)
+{
+	m_width = width;
+	m_height = height;
+	setParams(LINE_EDGE_DIST_DEFAULT, LINE_EDGE_THRESH_DEFAULT, LINE_EDGE_THRESH_DEFAULT*LINE_HTHRESH_RATIO);
+
+	m_words = (width+63)>>6;
+	m_neg = new (std::nothrow) uint64_t[m_words*4];
+	m_pos = m_neg ? m_neg + m_words : NULL;
+	m_hNeg = m_neg ? m_pos + m_words : NULL;
+	m_hPos = m_neg ? m_hNeg + m_words : NULL;
+
+#ifdef EDGESCAN_X86
+	m_avx2 = __builtin_cpu_supports("avx2");
+#else
+	m_avx2 = false;
+#endif
+}
+
+EdgeScanner::~EdgeScanner()
+{
+	delete [] m_neg;
+}
+
+void EdgeScanner::setParams(uint16_t dist, uint16_t thresh, uint16_t hThresh)
+{
+	m_dist = dist;
+	m_thresh = thresh;
+	m_hThresh = hThresh;
+}
+
+const char *EdgeScanner::simd()
+{
+#ifdef EDGESCAN_X86
+	return m_avx2 ? "avx2" : "sse2";
+#else
+	return "none";
+#endif
+}
+
+#ifdef EDGESCAN_X86
+// a>=b for unsigned bytes
+#define GE_EPU8(a, b)      _mm_cmpeq_epi8(_mm_max_epu8(a, b), a)
+#define GE_EPU8_256(a, b)  _mm256_cmpeq_epi8(_mm256_max_epu8(a, b), a)
+
+// the masks are uint64_t arrays, write them with memcpy to stay within the aliasing rules 
+#define STORE_MASK(dest, index, val) \
+	{ \
+		mask = val; \
+		memcpy((uint8_t *)(dest) + (index)*sizeof(mask), &mask, sizeof(mask)); \
+	}
+
+__attribute__((target("avx2")))
+static uint16_t masksAvx2(const uint8_t *a, const uint8_t *b, uint16_t n, uint8_t thresh, uint8_t hThresh, 
+	uint64_t *neg, uint64_t *pos, uint64_t *hNeg, uint64_t *hPos)
+{
+	uint16_t i, k;
+	uint32_t mask;
+	__m256i va, vb, dn, dp;
+	__m256i t = _mm256_set1_epi8(thresh);
+	__m256i h = _mm256_set1_epi8(hThresh);
+
+	for (i=0, k=0; i+32<=n; i+=32, k++)
+	{
+		va = _mm256_loadu_si256((const __m256i *)(a+i));
+		vb = _mm256_loadu_si256((const __m256i *)(b+i));
+		dn = _mm256_subs_epu8(va, vb); // -diff, 0 if diff is positive
+		dp = _mm256_subs_epu8(vb, va); // diff, 0 if diff is negative
+		STORE_MASK(neg, k, _mm256_movemask_epi8(GE_EPU8_256(dn, t)));
+		STORE_MASK(pos, k, _mm256_movemask_epi8(GE_EPU8_256(dp, t)));
+		STORE_MASK(hNeg, k, _mm256_movemask_epi8(GE_EPU8_256(dn, h)));
+		STORE_MASK(hPos, k, _mm256_movemask_epi8(GE_EPU8_256(dp, h)));
+	}
+	return i;
+}
+
+static uint16_t masksSse2(const uint8_t *a, const uint8_t *b, uint16_t n, uint8_t thresh, uint8_t hThresh, 
+	uint64_t *neg, uint64_t *pos, uint64_t *hNeg, uint64_t *hPos)
+{
+	uint16_t i, k, mask;
+	__m128i va, vb, dn, dp;
+	__m128i t = _mm_set1_epi8(thresh);
+	__m128i h = _mm_set1_epi8(hThresh);
+
+	for (i=0, k=0; i+16<=n; i+=16, k++)
+	{
+		va = _mm_loadu_si128((const __m128i *)(a+i));
+		vb = _mm_loadu_si128((const __m128i *)(b+i));
+		dn = _mm_subs_epu8(va, vb);
+		dp = _mm_subs_epu8(vb, va);
+		STORE_MASK(neg, k, _mm_movemask_epi8(GE_EPU8(dn, t)));
+		STORE_MASK(pos, k, _mm_movemask_epi8(GE_EPU8(dp, t)));
+		STORE_MASK(hNeg, k, _mm_movemask_epi8(GE_EPU8(dn, h)));
+		STORE_MASK(hPos, k, _mm_movemask_epi8(GE_EPU8(dp, h)));
+	}
+	return i;
+}
+#endif
+
+// Set the mask bits for diff = b[i]-a[i], 0<=i<n.  Bits at n and above are 0.  The SIMD code 
+// writes the masks 16 or 32 bits at a time, which assumes a little-endian host (x86). 
+void EdgeScanner::masks(const uint8_t *a, const uint8_t *b, uint16_t n)
+{
+	uint16_t i = 0;
+	int16_t diff;
+	uint64_t bit;
+
+#ifdef EDGESCAN_X86
+	if (m_avx2)
+		i = masksAvx2(a, b, n, m_thresh, m_hThresh, m_neg, m_pos, m_hNeg, m_hPos);
+	else
+		i = masksSse2(a, b, n, m_thresh, m_hThresh, m_neg, m_pos, m_hNeg, m_hPos);
+#endif
+	// clear what the SIMD code didn't write (i is a multiple of 16) 
+	memset((uint8_t *)m_neg + (i>>3), 0, m_words*sizeof(uint64_t) - (i>>3));
+	memset((uint8_t *)m_pos + (i>>3), 0, m_words*sizeof(uint64_t) - (i>>3));
+	memset((uint8_t *)m_hNeg + (i>>3), 0, m_words*sizeof(uint64_t) - (i>>3));
+	memset((uint8_t *)m_hPos + (i>>3), 0, m_words*sizeof(uint64_t) - (i>>3));
+	for (; i<n; i++)
+	{
+		diff = b[i]-a[i];
+		bit = 1ULL<<(i&0x3f);
+		if (-m_thresh>=diff)
+			m_neg[i>>6] |= bit;
+		if (diff>=m_thresh)
+			m_pos[i>>6] |= bit;
+		if (-m_hThresh>=diff)
+			m_hNeg[i>>6] |= bit;
+		if (diff>=m_hThresh)
+			m_hPos[i>>6] |= bit;
+	}
+}
+
+// index of the first set bit at or after i in (mask0 | mask1), or end if there isn't one.  If 
+// invert is set, look for the first clear bit in mask0 instead. 
+static inline uint16_t nextBit(const uint64_t *mask0, const uint64_t *mask1, uint16_t i, uint16_t end, bool invert=false)
+{
+	uint16_t w = i>>6;
+	uint64_t word;
+
+	if (i>=end)
+		return end;
+	word = invert ? ~mask0[w] : mask0[w] | (mask1 ? mask1[w] : 0);
+	word &= ~0ULL<<(i&0x3f);
+	while (word==0)
+	{
+		if ((++w<<6)>=end)
+			return end;
+		word = invert ? ~mask0[w] : mask0[w] | (mask1 ? mask1[w] : 0);
+	}
+	i = (w<<6) + __builtin_ctzll(word);
+	return i<end ? i : end;
+}
+
+uint32_t EdgeScanner::hScan(const uint8_t *row, uint16_t *edges)
+{
+	uint16_t i, end;
+	uint32_t n = 0;
+
+	// The byte compares can't express a threshold of 0 or more than 255.  Neither is useful, 
+	// but fall back to the reference code so the output still matches.
+	if (m_thresh==0 || m_hThresh==0 || m_thresh>255 || m_hThresh>255 || m_neg==NULL || m_dist>=m_width)
+		return hScanRef(row, edges);
+
+	edges[n++] = EQ_HSCAN_LINE_START;
+	end = m_width - m_dist;
+	masks(row, row+m_dist, end);
+
+	// Same state machine as the M0 code.  After an edge we skip 2 pixels, and a run of pixels 
+	// above hThresh (the edge itself) ends on the first pixel below hThresh, which is skipped.  
+	for (i=0; true; )
+	{
+		// state 0, looking for either edge
+		i = nextBit(m_neg, m_pos, i, end);
+		if (i>=end)
+			break;
+		if (m_neg[i>>6]&(1ULL<<(i&0x3f)))
+		{
+			edges[n++] = i | EQ_NEGATIVE;
+			// state 1, looking for end of negative edge
+			i = nextBit(m_hNeg, NULL, i+3, end, true);
+		}
+		else
+		{
+			edges[n++] = i;
+			// state 2, looking for end of positive edge
+			i = nextBit(m_hPos, NULL, i+3, end, true);
+		}
+		if (i>=end)
+			break;
+		i++;
+	}
+	return n;
+}
+
+uint32_t EdgeScanner::vScan(const uint8_t *row, const uint8_t *prev, uint16_t *edges)
+{
+	uint16_t i, w;
+	uint32_t n = 0;
+	uint64_t word;
+
+	if (m_thresh==0 || m_thresh>255 || m_neg==NULL)
+		return vScanRef(row, prev, edges);
+
+	edges[n++] = EQ_VSCAN_LINE_START;
+	masks(prev, row, m_width);
+
+	// only every 4th column is scanned
+	for (w=0; w<m_words; w++)
+	{
+		word = (m_neg[w] | m_pos[w]) & 0x1111111111111111ULL;
+		while (word)
+		{
+			i = (w<<6) + __builtin_ctzll(word);
+			word &= word-1;
+			edges[n++] = m_neg[w]&(1ULL<<(i&0x3f)) ? i | EQ_NEGATIVE : i;
+		}
+	}
+	return n;
+}
+
+// The M0 code (frame_m0.c), unchanged except for writing to edges instead of the equeue. 
+uint32_t EdgeScanner::hScanRef(const uint8_t *row, uint16_t *edges)
+{
+	int16_t i;
+	int16_t end, diff;
+	const uint8_t *memy = row;
+	uint32_t n = 0;
+
+	edges[n++] = EQ_HSCAN_LINE_START;
+
+	i = -1;
+	end = m_width - m_dist;
+
+	// state 0, looking for either edge
+loop0:
+	i++;
+	if (i>=end)
+		goto loopex;
+	diff = memy[i+m_dist]-memy[i];
+	if (-m_thresh>=diff)
+		goto edge0;
+	if (diff>=m_thresh)
+		goto edge1;
+	goto loop0;
+
+	// found neg edge
+edge0:
+	edges[n++] = i | EQ_NEGATIVE;
+	i+=2;
+
+	// state 1, looking for end of edge or pos edge
+loop1:
+	i++;
+	if (i>=end)
+		goto loopex;
+	diff = memy[i+m_dist]-memy[i];
+	if (-m_hThresh<diff)
+		goto loop0;
+	if (diff>=m_thresh)
+		goto edge1;
+	goto loop1;
+
+	// found pos edge
+edge1:
+	edges[n++] = i;
+	i+=2;
+	
+	// state 2, looking for end of edge or neg edge
+loop2:
+	i++;
+	if (i>=end)
+		goto loopex;
+	diff = memy[i+m_dist]-memy[i];
+	if (diff<m_hThresh)
+		goto loop0;
+	if (-m_thresh>=diff)	
+		goto edge0;
+	goto loop2;
+
+loopex:
+	return n;
+}
+
+uint32_t EdgeScanner::vScanRef(const uint8_t *row, const uint8_t *prev, uint16_t *edges)
+{
+	int16_t i;
+	int16_t diff;
+	const uint8_t *memy = row, *line0 = prev;
+	uint32_t n = 0;
+
+	edges[n++] = EQ_VSCAN_LINE_START;
+
+	i = -4;
+
+loop:
+	i+=4;
+	if (i>=m_width)
+		goto loopex;
+	diff = memy[i]-line0[i];
+	if (-m_thresh>=diff)
+		goto edge0;
+	if (diff>=m_thresh)
+		goto edge1;
+
+	goto loop;
+
+edge0:
+	edges[n++] = i | EQ_NEGATIVE;
+	goto loop;
+
+edge1:
+	edges[n++] = i;
+	goto loop;
+
+loopex:
+	return n;
+}
+
+int EdgeScanner::scanFrame(const uint8_t *luma, uint16_t *edges, uint32_t len, bool ref)
+{
+	uint16_t line, vdist;
+	uint32_t n = 0;
+	const uint8_t *row;
+
+	if (len<EDGESCAN_MAX_FRAME_LEN(m_width, m_height) || m_neg==NULL)
+		return -1;
+
+	// same order as grabM0R3(): vertical scans compare against the line (dist+5)/4 lines up 
+	vdist = (m_dist+5)>>2;
+	for (line=0, row=luma; line<m_height; line++, row+=m_width)
+	{
+		n += ref ? hScanRef(row, edges+n) : hScan(row, edges+n);
+		if (line>=vdist)
+			n += ref ? vScanRef(row, row-vdist*m_width, edges+n) : vScan(row, row-vdist*m_width, edges+n);
+	}
+	edges[n++] = EQ_FRAME_END;
+
+	return n;
+}
@@ -0,0 +1,96 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <time.h>
+#include "pixy_init.h"
+#include "misc.h"
+#include "pixyvals.h"
+#include "liblineengine.h"
+
+static thread_local uint16_t g_timeMs = 0;
+
+void cprintf(uint32_t flags, const char *format, ...)
+{
+	va_list args;
+
+	va_start(args, format);
+	vprintf(format, args);
+	va_end(args);
+}
+
+static uint32_t usecs()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec*1000000 + ts.tv_nsec/1000;
+}
+
+void setTimer(uint32_t *timer)
+{
+	*timer = usecs();
+}
+
+uint32_t getTimer(uint32_t timer)
+{
+	return usecs() - timer;
+}
+
+// the "cycle" timer counts at the firmware's CPU clock rate (CLKFREQ), so stage profiles from 
+// the host and from Pixy can be read the same way 
+static uint32_t cycles()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec*CLKFREQ + (uint64_t)ts.tv_nsec*CLKFREQ_US/1000;
+}
+
+void setCycleTimer(uint32_t *timer)
+{
+	*timer = cycles();
+}
+
+uint32_t getCycleTimer(uint32_t timer)
+{
+	return cycles() - timer;
+}
+
+void setTimerMs(uint16_t *timer)
+{
+	*timer = g_timeMs;
+}
+
+uint16_t getTimerMs(uint16_t timer)
+{
+	return (uint16_t)(g_timeMs - timer);
+}
+
+void lineengine_setTimeMs(uint16_t ms)
+{
+	g_timeMs = ms;
+}
+
+void lineengine_advanceTimeMs(uint16_t ms)
+{
+	g_timeMs += ms;
+}
+
+uint16_t lineengine_getTimeMs()
+{
+	return g_timeMs;
+}
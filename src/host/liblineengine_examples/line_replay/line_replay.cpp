@@ -0,0 +1,267 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+// Replays a recorded edge stream through the line engine.  The stream is the raw little-endian 
+// uint16 output of the M0 edge detector (EQ_HSCAN_LINE_START/EQ_VSCAN_LINE_START lines, each 
+// frame terminated by EQ_FRAME_END), i.e. the concatenated EDGS data that the firmware sends 
+// when the "debug layers" debug flag is set.  Each thread runs its own engine over the whole 
+// stream, so this can be used to benchmark the engine and to check that instances don't 
+// interfere with each other.  With -y the input is raw 8-bit luma frames instead (the 4014 
+// frames that the firmware sends in line mode), which are turned into edges with EdgeScanner 
+// first. 
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <thread>
+#include <vector>
+#include "pixyvals.h"
+#include "liblineengine.h"
+#include "edgescan.h"
+
+#define FRAME_BUFSIZE   0x200
+
+struct Replay
+{
+	uint32_t m_index;
+	const uint8_t *m_data;
+	uint32_t m_size; // bytes
+	uint32_t m_repeats;
+	uint16_t m_periodMs;
+	bool m_whiteLine;
+	bool m_print;
+	bool m_luma;
+	uint16_t m_dist;
+	uint16_t m_thresh;
+
+	uint32_t m_frames;
+	uint32_t m_errors;
+	double m_seconds;
+	double m_scanSeconds;
+	uint32_t m_stats[LINE_STAGES*LINE_PROFILE_STATS];
+};
+
+static double seconds()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+static void printFrame(uint32_t frame, const uint8_t *buf, int len)
+{
+	int i, j;
+	uint8_t type, plen;
+
+	printf("frame %u:\n", frame);
+	for (i=0; i+2<=len; i+=2+plen)
+	{
+		type = buf[i];
+		plen = buf[i+1];
+		if (type==LINE_FR_VECTOR_LINES)
+		{
+			const FrameLine *lines = (const FrameLine *)(buf+i+2);
+			for (j=0; j<plen/(int)sizeof(FrameLine); j++)
+				printf("  line %d: (%d %d)-(%d %d) flags=0x%x\n", lines[j].m_index, lines[j].m_x0, lines[j].m_y0, 
+					lines[j].m_x1, lines[j].m_y1, lines[j].m_flags);
+		}
+		else if (type==LINE_FR_INTERSECTION)
+		{
+			const FrameIntersection *intersections = (const FrameIntersection *)(buf+i+2);
+			for (j=0; j<plen/(int)sizeof(FrameIntersection); j++)
+				printf("  intersection: (%d %d) n=%d\n", intersections[j].m_x, intersections[j].m_y, intersections[j].m_n);
+		}
+		else if (type==LINE_FR_BARCODE)
+		{
+			const FrameCode *codes = (const FrameCode *)(buf+i+2);
+			for (j=0; j<plen/(int)sizeof(FrameCode); j++)
+				printf("  barcode %d: (%d %d) flags=0x%x\n", codes[j].m_code, codes[j].m_x, codes[j].m_y, codes[j].m_flags);
+		}
+	}
+}
+
+static void replay(Replay *r)
+{
+	uint32_t i, len, consumed, rep, frameSize=CAM_RES3_WIDTH*CAM_RES3_HEIGHT;
+	uint32_t edgesLen=EDGESCAN_MAX_FRAME_LEN(CAM_RES3_WIDTH, CAM_RES3_HEIGHT);
+	int res;
+	uint8_t buf[FRAME_BUFSIZE];
+	double start, scanStart;
+	const uint16_t *edges;
+	std::vector<uint16_t> scanned;
+	EdgeScanner scanner;
+	LineEngine engine;
+
+	r->m_frames = r->m_errors = 0;
+	r->m_scanSeconds = 0;
+	if (engine.open()<0)
+	{
+		fprintf(stderr, "engine %u: unable to allocate memory\n", r->m_index);
+		return;
+	}
+	engine.m_params.m_whiteLine = r->m_whiteLine;
+	engine.m_params.m_edgeDist = r->m_dist;
+	engine.updateParams();
+	scanner.setParams(r->m_dist, r->m_thresh, r->m_thresh*LINE_HTHRESH_RATIO);
+	if (r->m_luma)
+		scanned.resize(edgesLen);
+	len = r->m_luma ? r->m_size : r->m_size/sizeof(uint16_t);
+
+	lineengine_setTimeMs(0);
+	start = seconds();
+	for (rep=0; rep<r->m_repeats; rep++)
+	{
+		for (i=0; i<len; i+=consumed)
+		{
+			lineengine_advanceTimeMs(r->m_periodMs);
+			if (r->m_luma)
+			{
+				if (len-i<frameSize)
+					break;
+				scanStart = seconds();
+				res = scanner.scanFrame(r->m_data+i, &scanned[0], edgesLen);
+				r->m_scanSeconds += seconds() - scanStart;
+				res = engine.processFrame(&scanned[0], res);
+				consumed = frameSize;
+			}
+			else
+			{
+				edges = (const uint16_t *)r->m_data;
+				res = engine.processFrame(edges+i, len-i, &consumed);
+			}
+			if (res<0)
+				r->m_errors++;
+			else
+			{
+				if (r->m_print && rep==0)
+				{
+					res = engine.getAllFrame(LINE_FR_VECTOR_LINES | LINE_FR_INTERSECTION | LINE_FR_BARCODE, buf, FRAME_BUFSIZE);
+					printFrame(r->m_frames, buf, res);
+				}
+			}
+			r->m_frames++;
+			if (consumed==0)
+				break;
+		}
+	}
+	r->m_seconds = seconds() - start;
+	engine.getProfile(r->m_stats);
+	engine.close();
+}
+
+int main(int argc, char *argv[])
+{
+	FILE *file;
+	long size;
+	uint8_t *data;
+	uint32_t i, j, threads=1, repeats=1, period=16, dist=LINE_EDGE_DIST_DEFAULT, thresh=LINE_EDGE_THRESH_DEFAULT;
+	uint32_t *stats;
+	char names[sizeof(LINE_STAGE_NAMES)];
+	const char *name;
+	bool whiteLine=false, quiet=false, luma=false;
+	std::vector<Replay> replays;
+	std::vector<std::thread> workers;
+
+	if (argc<2)
+	{
+		printf("usage: line_replay <edge stream file> [-t threads] [-r repeats] [-p frame period ms] [-w] [-q]\n");
+		printf("                   [-y] [-d edge distance] [-e edge threshold]\n");
+		printf("  -w  white line on dark background\n");
+		printf("  -q  don't print the features of each frame\n");
+		printf("  -y  input is %dx%d 8-bit luma frames, find edges first\n", CAM_RES3_WIDTH, CAM_RES3_HEIGHT);
+		return -1;
+	}
+	for (i=2; i<(uint32_t)argc; i++)
+	{
+		if (strcmp(argv[i], "-t")==0 && i+1<(uint32_t)argc)
+			threads = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-r")==0 && i+1<(uint32_t)argc)
+			repeats = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-p")==0 && i+1<(uint32_t)argc)
+			period = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-w")==0)
+			whiteLine = true;
+		else if (strcmp(argv[i], "-q")==0)
+			quiet = true;
+		else if (strcmp(argv[i], "-y")==0)
+			luma = true;
+		else if (strcmp(argv[i], "-d")==0 && i+1<(uint32_t)argc)
+			dist = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-e")==0 && i+1<(uint32_t)argc)
+			thresh = atoi(argv[++i]);
+	}
+	if (threads<1)
+		threads = 1;
+
+	file = fopen(argv[1], "rb");
+	if (file==NULL)
+	{
+		fprintf(stderr, "unable to open %s\n", argv[1]);
+		return -1;
+	}
+	fseek(file, 0, SEEK_END);
+	size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	data = (uint8_t *)malloc(size);
+	if (data==NULL || fread(data, 1, size, file)!=(size_t)size)
+	{
+		fprintf(stderr, "unable to read %s\n", argv[1]);
+		fclose(file);
+		return -1;
+	}
+	fclose(file);
+
+	replays.resize(threads);
+	for (i=0; i<threads; i++)
+	{
+		replays[i].m_index = i;
+		replays[i].m_data = data;
+		replays[i].m_size = size;
+		replays[i].m_repeats = repeats;
+		replays[i].m_periodMs = period;
+		replays[i].m_whiteLine = whiteLine;
+		replays[i].m_print = !quiet && i==0;
+		replays[i].m_luma = luma;
+		replays[i].m_dist = dist;
+		replays[i].m_thresh = thresh;
+	}
+	for (i=1; i<threads; i++)
+		workers.push_back(std::thread(replay, &replays[i]));
+	replay(&replays[0]);
+	for (i=0; i<workers.size(); i++)
+		workers[i].join();
+
+	for (i=0; i<threads; i++)
+	{
+		Replay &r = replays[i];
+		printf("engine %u: %u frames, %u errors, %.3f s, %.1f fps\n", i, r.m_frames, r.m_errors, r.m_seconds, 
+			r.m_seconds>0 ? r.m_frames/r.m_seconds : 0.0);
+		if (luma)
+			printf("  edge scan: %.1f us/frame\n", r.m_frames ? r.m_scanSeconds*1000000/r.m_frames : 0.0);
+		strcpy(names, LINE_STAGE_NAMES);
+		printf("  %-18s %8s %8s %8s %8s %8s (us)\n", "stage", "frames", "min", "mean", "p99", "max");
+		for (j=0, name=strtok(names, ","); j<LINE_STAGES; j++, name=strtok(NULL, ","))
+		{
+			stats = r.m_stats + j*LINE_PROFILE_STATS;
+			printf("  %-18s %8u %8.1f %8.1f %8.1f %8.1f\n", name, stats[0], (double)stats[1]/CLKFREQ_US, (double)stats[2]/CLKFREQ_US, 
+				(double)stats[3]/CLKFREQ_US, (double)stats[4]/CLKFREQ_US);
+		}
+	}
+	free(data);
+
+	return 0;
+}
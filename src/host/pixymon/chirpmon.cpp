@@ -18,6 +18,7 @@
 #include <stdexcept>
 #include "chirpmon.h"
 #include "interpreter.h"
+#include "recorder.h"
 
 ChirpMon::ChirpMon(Interpreter *interpreter, USBLink *link)
 {
@@ -66,6 +67,10 @@ int ChirpMon::handleChirp(uint8_t type, ChirpProc proc, const void *args[])
 
 void ChirpMon::handleXdata(const void *data[])
 {
+    // record the message as it came, before anything looks at it
+    if (m_interpreter->m_recorder)
+        m_interpreter->m_recorder->write(m_buf+m_headerLen, m_len,
+            data[0] && getType(data[0])==CRP_TYPE_HINT ? *(uint32_t *)data[0] : 0);
     m_interpreter->handleData(data);
 }
 
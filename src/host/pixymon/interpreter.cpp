@@ -27,13 +27,17 @@
 #include "sleeper.h"
 #include "pixymon.h"
 #include "monmodule.h"
+#include "recorder.h"
 
 QString printType(uint32_t val, bool parens=false);
 
-Interpreter::Interpreter(ConsoleWidget *console, VideoWidget *video, MonParameterDB *data, const QString &initScript) :
+Interpreter::Interpreter(ConsoleWidget *console, VideoWidget *video, MonParameterDB *data, const QString &initScript,
+                         Recorder *recorder, bool headless) :
     m_mutexProg(QMutex::Recursive)
 {
     m_initScript = initScript;
+    m_recorder = recorder;
+    m_headless = headless;
     m_initScript.remove(QRegExp("^\\s+"));  // remove initial whitespace
     m_console = console;
     m_video = video;
@@ -84,6 +88,7 @@ void Interpreter::close()
     unwait(); // if we're waiting for input, unhang ourselves
 
     m_run = false;
+    m_link.wake();
 
     // save any parameters
     m_pixymonParameters->save();
@@ -332,7 +337,7 @@ void Interpreter::handleData(const void *args[])
                 uint32_t event = *(uint32_t *)args[1];
                 if (event==EVT_PARAM_CHANGE)
                     emit paramChange();
-                else if (event==EVT_RENDER_FLUSH)
+                else if (event==EVT_RENDER_FLUSH && !m_headless)
                     m_renderer->emitFlush();
                 else if (event==EVT_PROG_CHANGE)
                 {
@@ -346,7 +351,7 @@ void Interpreter::handleData(const void *args[])
                 flags |= TEXT_FLAG_BLUE;
                 m_print +=  (char *)args[2];
             }
-            else
+            else if (!m_headless)
             {
                 // check modules, see if they handle the fourcc
                 for (i=0; i<m_modules.size(); i++)
@@ -640,6 +645,7 @@ void Interpreter::queueCommand(CommandType type, const QVariant &arg0, const QVa
     m_commandQueue.removeAll(command);
     m_commandQueue.push_back(command);
     m_mutexQueue.unlock();
+    m_link.wake();
 }
 
 
@@ -649,6 +655,7 @@ void Interpreter::queueCommand(const QStringList &argv, bool interactive)
     m_mutexQueue.lock();
     m_commandQueue.push_back(command);
     m_mutexQueue.unlock();
+    m_link.wake();
 }
 
 int Interpreter::saveImage(const QString &filename)
@@ -674,7 +681,7 @@ void Interpreter::getProgs()
 
 void Interpreter::run()
 {
-    int res;
+    int res, period, wait;
     QTime time;
     QString paramScriptlet;
 
@@ -797,25 +804,41 @@ void Interpreter::run()
 
     while(m_run)
     {
+        period = m_fastPoll ? RUN_POLL_PERIOD_FAST : RUN_POLL_PERIOD_SLOW;
         // poll to see if we're still connected
-        if (!m_programming &&
-                ((m_fastPoll && time.elapsed()>RUN_POLL_PERIOD_FAST) ||
-                (!m_fastPoll && time.elapsed()>RUN_POLL_PERIOD_SLOW)))
+        if (!m_programming && time.elapsed()>period)
         {
             getRunning();
             time.start();
         }
         // service chirps -- but if we're running a local program it just slows things down
         else if (!m_localProgramRunning)
-            m_chirp->service(false);
+        {
+            // Sleep until Pixy sends something, a command is queued (queueCommand() wakes us) or
+            // it's time to poll.  An error means Pixy has gone away, so find out now.
+            wait = m_programming ? RUN_POLL_PERIOD_SLOW : period-time.elapsed();
+            res = m_link.waitReady(wait>0 ? wait : 1);
+            if (res>0)
+                m_chirp->service(false);
+            else if (res<0)
+            {
+                if (!m_programming)
+                {
+                    getRunning();
+                    time.start();
+                }
+                Sleeper::msleep(RUN_POLL_PERIOD_FAST);
+            }
+        }
         handlePendingCommand();
         handleLocalProgram();
         if (!m_running && !m_localProgramRunning)
-        {
             emit enableConsole(true);
-            Sleeper::msleep(10);
-        }
+        if (m_recorder)
+            m_recorder->flush();
     }
+    if (m_recorder)
+        m_recorder->flush(true);
     DBG("worker thread exiting");
 }
 
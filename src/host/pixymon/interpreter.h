@@ -47,6 +47,7 @@
 class ConsoleWidget;
 class Renderer;
 class MonModule;
+class Recorder;
 
 enum CommandType {STOP, RUN, STOP_LOCAL, RUN_LOCAL, LOAD_PARAMS, SAVE_PARAMS, UPDATE_PARAM, GET_ACTIONS_VIEWS, SET_VIEW, CLOSE, ARGV};
 
@@ -88,7 +89,8 @@ class Interpreter : public QThread
     Q_OBJECT
 
 public:
-    Interpreter(ConsoleWidget *console, VideoWidget *video, MonParameterDB *data, const QString &initScript="");
+    Interpreter(ConsoleWidget *console, VideoWidget *video, MonParameterDB *data, const QString &initScript="",
+                Recorder *recorder=NULL, bool headless=false);
     ~Interpreter();
 
     // local program business
@@ -127,6 +129,8 @@ public:
     VideoWidget *m_video;
     ParameterDB m_pixyParameters;
     MonParameterDB *m_pixymonParameters;
+    Recorder *m_recorder;
+    bool m_headless; // nobody's watching, so don't render
 
     friend class ChirpMon;
     friend class Renderer;
@@ -99,6 +99,11 @@ bool LineModule::render(uint32_t fourcc, const void *args[])
         handlePVI0(*(uint8_t *)args[0], *(uint16_t *)args[1], *(uint16_t *)args[2], *(uint8_t *)args[3], *(uint8_t *)args[4], *(uint8_t *)args[5], *(uint8_t *)args[6], *(uint8_t *)args[7]);
         return true;
     }
+    else if (fourcc==FOURCC('L', 'P', 'R', '0'))
+    {
+        handleLPR0(*(uint8_t *)args[0], *(uint16_t *)args[1], *(uint16_t *)args[2], *(uint32_t *)args[3], (const char *)args[4], *(uint32_t *)args[5], (uint32_t *)args[6]);
+        return true;
+    }
     return false;
 }
 
@@ -514,3 +519,58 @@ void LineModule::render4014(uint8_t renderFlags, uint16_t width, uint16_t height
     m_renderer->emitImage(img2, renderFlags, "Background");
 }
 
+// Stage profile panel, sent by the firmware when the "Debug" parameter has the profile bit set 
+// (LINE_DEBUG_PROFILE).  The bar is the mean, the orange mark is the 99th percentile.
+void LineModule::handleLPR0(uint8_t renderFlags, uint16_t width, uint16_t height, uint32_t clock, const char *names, uint32_t len, uint32_t *stats)
+{
+    uint i, stages, y, rowh, barx, barw;
+    float scale, full, clockUs;
+    uint32_t *s;
+    QStringList stageNames;
+    QPainter p;
+    QFont font("verdana");
+
+    stageNames = QString(names).split(',');
+    stages = MIN((uint)stageNames.size(), len/LINE_PROFILE_STATS);
+    if (stages==0 || clock==0)
+        return;
+    clockUs = clock/1000000.0;
+
+    scale = (float)m_renderer->m_video->activeWidth()/width;
+    QImage img(width*scale, height*scale, QImage::Format_ARGB32);
+    img.fill(0x00000000);
+    if (!p.begin(&img))
+        return;
+
+    // scale the bars to the largest 99th percentile, the max is often an outlier
+    for (i=0, full=1; i<stages; i++)
+    {
+        if (stats[i*LINE_PROFILE_STATS+3]>full)
+            full = stats[i*LINE_PROFILE_STATS+3];
+    }
+
+    rowh = img.height()/(stages+1);
+    barx = img.width()/4;
+    barw = img.width()/2;
+    font.setPixelSize(rowh*2/3);
+    p.setFont(font);
+    Renderer::drawRect(&p, QRect(0, 0, img.width(), rowh*(stages+1)), QColor(Qt::black), 0xa0);
+    p.setPen(QPen(QColor(Qt::white)));
+    p.drawText(QRect(4, 0, img.width()-8, rowh), Qt::AlignLeft | Qt::AlignVCenter,
+               QString("stage profile, %1 frames (mean / p99 / max us)").arg(stats[0]));
+
+    for (i=0; i<stages; i++)
+    {
+        s = stats + i*LINE_PROFILE_STATS;
+        y = rowh*(i+1);
+        p.fillRect(barx, y+rowh/4, barw*s[2]/full, rowh/2, m_colors[4]);
+        p.fillRect(barx+barw*s[3]/full-1, y+2, 3, rowh-4, m_colors[1]);
+        p.setPen(QPen(QColor(Qt::white)));
+        p.drawText(QRect(4, y, barx-8, rowh), Qt::AlignLeft | Qt::AlignVCenter, stageNames[i]);
+        p.drawText(QRect(barx+barw+4, y, img.width()-barx-barw-8, rowh), Qt::AlignLeft | Qt::AlignVCenter,
+                   QString("%1 / %2 / %3").arg(s[2]/clockUs, 0, 'f', 0).arg(s[3]/clockUs, 0, 'f', 0).arg(s[4]/clockUs, 0, 'f', 0));
+    }
+    p.end();
+
+    m_renderer->emitImage(img, renderFlags, "Stage profile");
+}
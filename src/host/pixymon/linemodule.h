@@ -22,6 +22,7 @@
 
 #define LINE_EDGE_DATA_SIZE       0x2000
 #define LINE_NUM_COLORS           8
+#define LINE_PROFILE_STATS        5 // count, min, mean, p99, max, see LineEngine::getProfile()
 
 // color connected components
 class LineModule : public MonModule
@@ -48,6 +49,7 @@ private:
     void handleBC0F(uint8_t renderFlags, const char *desc, uint16_t width, uint16_t height);
     void handleBC0S(uint8_t index, uint16_t val, uint16_t xoffset, uint16_t yoffset, uint16_t width, uint16_t height);
     void handlePVI0(uint8_t renderFlags, uint16_t width, uint16_t height, uint8_t xSrc, uint8_t ySrc, uint8_t xDest, uint8_t yDest, uint8_t intersectionDest);
+    void handleLPR0(uint8_t renderFlags, uint16_t width, uint16_t height, uint32_t clock, const char *names, uint32_t len, uint32_t *stats);
     void drawLine(uint index, int x1, int y1, int x2, int y2, Qt::PenStyle style=Qt::SolidLine, const QString &text="");
     void drawPoint(uint index, int x, int y, const QString &text="");
     QString lookup(uint16_t barcodeNum);
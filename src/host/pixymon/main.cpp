@@ -45,7 +45,8 @@ int main(int argc, char *argv[])
 #endif
 
     MainWindow w(argc, argv);
-    w.show();
+    if (!w.headless())
+        w.show();
 
     return a.exec();
 }
@@ -13,6 +13,8 @@
 // end license header
 //
 
+#include <stdio.h>
+#include <signal.h>
 #include <stdexcept>
 #include "debug.h"
 #include <QMessageBox>
@@ -33,6 +35,7 @@
 #include "ui_mainwindow.h"
 #include "configdialog.h"
 #include "dataexport.h"
+#include "recorder.h"
 #include "sleeper.h"
 #include "aboutdialog.h"
 #include "parameters.h"
@@ -40,6 +43,14 @@
 
 extern ChirpProc c_grabFrame;
 
+// set by SIGINT/SIGTERM -- the handler can't safely do more than this, so handleStopTimer() polls it
+static volatile sig_atomic_t g_stopRequested = 0;
+
+static void stopHandler(int)
+{
+    g_stopRequested = 1;
+}
+
 MainWindow::MainWindow(int argc, char *argv[], QWidget *parent) :
     QMainWindow(parent),
     m_ui(new Ui::MainWindow)
@@ -62,6 +73,9 @@ MainWindow::MainWindow(int argc, char *argv[], QWidget *parent) :
     m_versionIncompatibility = false;
     m_testCycle = false;
     m_waiting = WAIT_NONE;
+    m_recorder = NULL;
+    m_headless = false;
+    m_duration = 0;
 
     parseCommandline(argc, argv);
 
@@ -102,6 +116,31 @@ MainWindow::MainWindow(int argc, char *argv[], QWidget *parent) :
     m_parameters.add("Pixy start command", PT_STRING, "",
         "The command that is sent to Pixy upon initialization");
 
+    if (m_recordFile!="")
+    {
+        m_recorder = new Recorder;
+        if (m_recorder->open(m_recordFile)<0)
+        {
+            error("Unable to open " + m_recordFile + " for recording.\n");
+            delete m_recorder;
+            m_recorder = NULL;
+        }
+    }
+
+    // a headless run has no window to close, so stop (and close the recording) cleanly on
+    // Ctrl-C/kill or after -duration secs
+    if (m_headless)
+    {
+        signal(SIGINT, stopHandler);
+        signal(SIGTERM, stopHandler);
+    }
+    if (m_headless || m_duration)
+    {
+        m_runTime.start();
+        connect(&m_stopTimer, SIGNAL(timeout()), this, SLOT(handleStopTimer()));
+        m_stopTimer.start(100);
+    }
+
     // start looking for devices
     m_connect = new ConnectEvent(this);
     if (m_connect->getConnected()==NONE)
@@ -117,6 +156,13 @@ MainWindow::~MainWindow()
     // we don't delete any of the widgets because the parent deletes it's children upon deletion
 
     delete m_settings;
+    if (m_recorder)
+        delete m_recorder;
+}
+
+bool MainWindow::headless()
+{
+    return m_headless;
 }
 
 void MainWindow::parseCommandline(int argc, char *argv[])
@@ -145,6 +191,22 @@ void MainWindow::parseCommandline(int argc, char *argv[])
             m_pixyflash = argv[i];
             m_pixyflash.remove(QRegExp("[\"']"));
         }
+        else if (!strcmp("-record", argv[i]) && i+1<argc)
+        {
+            i++;
+            m_recordFile = argv[i];
+            m_recordFile.remove(QRegExp("[\"']"));
+        }
+        // no window, no rendering -- for recording unattended, e.g.
+        // pixymon -headless -record run1.pxr -duration 60 -initscript "runprog 2" -platform offscreen
+        // stop it with Ctrl-C or SIGTERM, or let -duration do it
+        else if (!strcmp("-headless", argv[i]))
+            m_headless = true;
+        else if (!strcmp("-duration", argv[i]) && i+1<argc)
+        {
+            i++;
+            m_duration = QString(argv[i]).toUInt();
+        }
     }
 }
 
@@ -257,6 +319,12 @@ void MainWindow::closeEvent(QCloseEvent *event)
 
 void MainWindow::handleText(QString text, uint flags)
 {
+    if (m_headless)
+    {
+        fputs(text.toUtf8().constData(), stdout);
+        fflush(stdout);
+        return;
+    }
     // only popup important messages, and only if console isn't visible
     if (!m_console->isVisible() && (flags&TEXT_FLAG_PRIORITY_HIGH))
         QMessageBox::information(NULL, PIXYMON_TITLE, text);
@@ -367,7 +435,7 @@ void MainWindow::connectPixy(bool state)
             {
                 m_console->clear();
                 m_console->print("Pixy detected.\n");
-                m_interpreter = new Interpreter(m_console, m_video, &m_parameters, m_initScript);
+                m_interpreter = new Interpreter(m_console, m_video, &m_parameters, m_initScript, m_recorder, m_headless);
 
                 connect(m_interpreter, SIGNAL(error(QString)), this, SLOT(error(QString)));
                 connect(m_interpreter, SIGNAL(textOut(QString,uint)), this, SLOT(handleText(QString,uint)));
@@ -470,6 +538,8 @@ void MainWindow::addProg(const QString &name, const QString &desc, uint index)
 
 void MainWindow::error(QString message)
 {
+    if (m_headless)
+        fputs(message.toUtf8().constData(), stderr);
     m_console->error(message);
     status(message);
 }
@@ -857,6 +927,19 @@ void MainWindow::handleMouseLoc(int x, int y)
 }
 
 
+void MainWindow::handleStopTimer()
+{
+    if (g_stopRequested || (m_duration && (uint)m_runTime.elapsed()>=m_duration*1000))
+    {
+        DBG("stopping");
+        m_stopTimer.stop();
+        // if shutting down hangs, a second Ctrl-C still kills us
+        signal(SIGINT, SIG_DFL);
+        signal(SIGTERM, SIG_DFL);
+        on_actionExit_triggered();
+    }
+}
+
 void MainWindow::on_actionExit_triggered()
 {
     if (m_configDialog)
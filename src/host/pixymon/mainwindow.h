@@ -17,6 +17,8 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
+#include <QTimer>
+#include <QTime>
 #include <vector>
 #include "monparameterdb.h"
 
@@ -35,6 +37,7 @@ class Interpreter;
 class Flash;
 class ConnectEvent;
 class ConfigDialog;
+class Recorder;
 class QSettings;
 class QMessageBox;
 
@@ -48,6 +51,8 @@ public:
     explicit MainWindow(int argc, char *argv[], QWidget *parent = 0);
     ~MainWindow();
 
+    bool headless();
+
     friend class VideoWidget;
     friend class ConsoleWidget;
 
@@ -68,6 +73,7 @@ private slots:
     void handleConfigDialogFinished();
     void handleMouseLoc(int x, int y);
     void interpreterFinished();
+    void handleStopTimer();
     void handleVersion(ushort major, ushort minor, ushort build, QString type, ushort hwMajor, ushort hwMinor, ushort hwBuild);
     void on_actionAbout_triggered();
     void on_actionPlay_Pause_triggered();
@@ -118,6 +124,12 @@ private:
     QString m_argvFirmwareFile;
     QString m_initScript;
     QString m_pixyflash;
+    QString m_recordFile;
+    Recorder *m_recorder;
+    bool m_headless;
+    uint m_duration; // secs, 0 runs until closed
+    QTimer m_stopTimer;
+    QTime m_runTime;
     bool m_versionIncompatibility;
     QSettings *m_settings;
     MonParameterDB m_parameters;
@@ -30,6 +30,7 @@ SOURCES += main.cpp\
     parameters.cpp \
     paramfile.cpp \
     dataexport.cpp \
+    recorder.cpp \
     monmodule.cpp \
     monparameterdb.cpp \
     cccmodule.cpp \
@@ -62,6 +63,7 @@ HEADERS  += mainwindow.h \
     parameters.h \
     paramfile.h \
     dataexport.h \
+    recorder.h \
     monmodule.h \
     monparameterdb.h \
     cccmodule.h \
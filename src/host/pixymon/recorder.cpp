@@ -0,0 +1,106 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+#include <QDateTime>
+#include "recorder.h"
+#include "debug.h"
+
+Recorder::Recorder()
+{
+    m_flushTime = 0;
+    m_records = 0;
+}
+
+Recorder::~Recorder()
+{
+    close();
+}
+
+int Recorder::open(const QString &filename)
+{
+    RecorderFileHeader header;
+
+    close();
+
+    m_file.setFileName(filename);
+    if (!m_file.open(QIODevice::WriteOnly))
+        return -1;
+
+    header.m_magic = RECORDER_MAGIC;
+    header.m_version = RECORDER_VERSION;
+    header.m_reserved = 0;
+    header.m_startTime = QDateTime::currentMSecsSinceEpoch();
+    if (m_file.write((const char *)&header, sizeof(header))!=sizeof(header))
+    {
+        m_file.close();
+        return -1;
+    }
+
+    m_timer.start();
+    m_flushTime = 0;
+    m_records = 0;
+    return 0;
+}
+
+void Recorder::close()
+{
+    if (m_file.isOpen())
+    {
+        DBG("recorded %d messages to %s", m_records, m_file.fileName().toUtf8().constData());
+        m_file.close();
+    }
+}
+
+int Recorder::write(const uint8_t *data, uint32_t len, uint32_t fourcc)
+{
+    RecorderHeader header;
+
+    if (!m_file.isOpen())
+        return -1;
+
+    header.m_timestamp = m_timer.nsecsElapsed()/1000;
+    header.m_fourcc = fourcc;
+    header.m_len = len;
+    if (m_file.write((const char *)&header, sizeof(header))!=sizeof(header) ||
+            m_file.write((const char *)data, len)!=(qint64)len)
+    {
+        qWarning("recording failed: %s", m_file.errorString().toUtf8().constData());
+        m_file.close();
+        return -1;
+    }
+    m_records++;
+
+    return 0;
+}
+
+void Recorder::flush(bool now)
+{
+    int64_t time;
+
+    if (!m_file.isOpen())
+        return;
+
+    time = m_timer.nsecsElapsed()/1000;
+    if (now || time-m_flushTime>RECORDER_FLUSH_PERIOD*1000)
+    {
+        m_file.flush();
+        m_flushTime = time;
+    }
+}
+
+uint32_t Recorder::records()
+{
+    return m_records;
+}
@@ -0,0 +1,71 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <stdint.h>
+#include <QFile>
+#include <QString>
+#include <QElapsedTimer>
+
+#define RECORDER_MAGIC          0x31525850 // "PXR1"
+#define RECORDER_VERSION        1
+#define RECORDER_FLUSH_PERIOD   1000 // msecs
+
+// A recording is a RecorderFileHeader followed by one record per XDATA message from Pixy (BA81
+// frames, CCB1/CCB2 blocks, LISG lines, CODE barcodes, TEXT, EVT1 events, etc.)  Each record is
+// a RecorderHeader followed by the message's arguments, serialized by Chirp exactly as they
+// came over USB, so Chirp::deserialize() turns them back into what the MonModules are passed.
+struct RecorderFileHeader
+{
+    uint32_t m_magic;
+    uint16_t m_version;
+    uint16_t m_reserved;
+    int64_t m_startTime; // msecs since the epoch (UTC)
+};
+
+struct RecorderHeader
+{
+    uint64_t m_timestamp; // usecs since the recording started
+    uint32_t m_fourcc; // the message's type hint, 0 if it doesn't have one
+    uint32_t m_len; // of the arguments that follow
+};
+
+class Recorder
+{
+public:
+    Recorder();
+    ~Recorder();
+
+    int open(const QString &filename);
+    void close();
+    // called from the interpreter thread as each message arrives
+    int write(const uint8_t *data, uint32_t len, uint32_t fourcc);
+    // Push what QFile has buffered out to the file, if it's been RECORDER_FLUSH_PERIOD since the
+    // last time (or now).  The interpreter thread calls this every time around its loop, so the
+    // file keeps up even when Pixy goes quiet.
+    void flush(bool now=false);
+
+    uint32_t records();
+
+private:
+    QFile m_file;
+    QElapsedTimer m_timer;
+    int64_t m_flushTime;
+    uint32_t m_records;
+};
+
+#endif // RECORDER_H
@@ -17,6 +17,9 @@
 #include <QFont>
 #include "debug.h"
 #include <QFile>
+#include <QRunnable>
+#include <QThread>
+#include <QSemaphore>
 #include "renderer.h"
 #include "videowidget.h"
 #include "interpreter.h"
@@ -25,6 +28,9 @@
 #include <chirp.hpp>
 #include "calc.h"
 #include <math.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 const uint32_t Renderer::m_defaultPalette[PALETTE_SIZE] =
 {
@@ -51,8 +57,16 @@ Renderer::Renderer(VideoWidget *video, Interpreter *interpreter) : MonModule(int
     m_interpreter->m_pixymonParameters->addCheckbox("Highlight overexposure", false,
         "Highlighting overexposure will overlay black pixels ontop of overexposed pixels in raw and cooked modes");
 
+    m_imageIndex = 0;
+    m_tileImage = NULL;
+    m_pendingValid = false;
+    m_pendingFlags = 0;
+    // this thread renders a band too
+    m_threadPool.setMaxThreadCount(qMax(QThread::idealThreadCount()-1, 1));
+
     connect(this, SIGNAL(image(QImage, uchar, QString)), m_video, SLOT(handleImage(QImage, uchar, QString))); //, Qt::BlockingQueuedConnection);
     connect(this, SIGNAL(flush()), m_video, SLOT(flush()));
+    connect(this, SIGNAL(backgroundReady()), this, SLOT(handleBackground()), Qt::QueuedConnection);
 }
 
 
@@ -62,211 +76,171 @@ Renderer::~Renderer()
 }
 
 
-inline void Renderer::interpolateBayer(unsigned int width, unsigned int x, unsigned int y, unsigned char *pixel, unsigned int &r, unsigned int &g, unsigned int &b)
+#define BAYER_PACK(r, g, b)  (0xff000000 | (r)<<16 | (g)<<8 | (b))
+
+#ifdef __SSE2__
+// 8 pixels, w holds the center, left, right, up, up-left, up-right, down, down-left and 
+// down-right neighbors as 16-bit values
+static inline void bayer8(const __m128i *w, bool oddRow, __m128i *r, __m128i *g, __m128i *b)
 {
-#if 0
-    if (y&1)
-    {
-        if (x&1)
-        {
-            r = (*(pixel-1)+*(pixel+1))>>1;
-            g = *pixel;
-            b = (*(pixel-width)+*(pixel+width))>>1;
-        }
-        else
-        {
-            r = *pixel;
-            g = (*(pixel-1)+*(pixel+1)+*(pixel+width)+*(pixel-width))>>2;
-            b = (*(pixel-width-1)+*(pixel-width+1)+*(pixel+width-1)+*(pixel+width+1))>>2;
-        }
-    }
-    else
+    const __m128i even = _mm_set1_epi32(0x0000ffff); // even lanes, odd columns
+    __m128i c, h, v, x, dg;
+
+    c = w[0];
+    h = _mm_add_epi16(w[1], w[2]);
+    v = _mm_add_epi16(w[3], w[6]);
+    x = _mm_srli_epi16(_mm_add_epi16(h, v), 2);
+    dg = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(w[4], w[5]), _mm_add_epi16(w[7], w[8])), 2);
+    h = _mm_srli_epi16(h, 1);
+    v = _mm_srli_epi16(v, 1);
+    if (oddRow) // red, green, red, green...
     {
-        if (x&1)
-        {
-            r = (*(pixel-width-1)+*(pixel-width+1)+*(pixel+width-1)+*(pixel+width+1))>>2;
-            g = (*(pixel-1)+*(pixel+1)+*(pixel+width)+*(pixel-width))>>2;
-            b = *pixel;
-        }
-        else
-        {
-            r = (*(pixel-width)+*(pixel+width))>>1;
-            g = *pixel;
-            b = (*(pixel-1)+*(pixel+1))>>1;
-        }
+        *r = _mm_or_si128(_mm_and_si128(even, c), _mm_andnot_si128(even, h));
+        *g = _mm_or_si128(_mm_and_si128(even, x), _mm_andnot_si128(even, c));
+        *b = _mm_or_si128(_mm_and_si128(even, dg), _mm_andnot_si128(even, v));
     }
-#endif
-#if 1 // normal
-    if (y&1)
+    else // green, blue, green, blue...
     {
-        if (x&1)
-        {
-            r = *pixel;
-            g = (*(pixel-1)+*(pixel+1)+*(pixel+width)+*(pixel-width))>>2;
-            b = (*(pixel-width-1)+*(pixel-width+1)+*(pixel+width-1)+*(pixel+width+1))>>2;
-        }
-        else
-        {
-            r = (*(pixel-1)+*(pixel+1))>>1;
-            g = *pixel;
-            b = (*(pixel-width)+*(pixel+width))>>1;
-        }
+        *r = _mm_or_si128(_mm_and_si128(even, v), _mm_andnot_si128(even, dg));
+        *g = _mm_or_si128(_mm_and_si128(even, c), _mm_andnot_si128(even, x));
+        *b = _mm_or_si128(_mm_and_si128(even, h), _mm_andnot_si128(even, c));
     }
-    else
+}
+
+// 16 pixels of a row, starting at an odd column.  Every lane gets both kinds of interpolation,
+// and the even and odd lanes pick the ones for their kind of pixel.  Same results as the scalar
+// code.
+static inline void bayer16(const uint8_t *p, const uint8_t *u, const uint8_t *d, bool oddRow, uint32_t *line)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alpha = _mm_set1_epi8((char)0xff);
+    const uint8_t *src[9] = {p, p-1, p+1, u, u-1, u+1, d, d-1, d+1};
+    __m128i in, lo[9], hi[9], r[2], g[2], b[2];
+    int j;
+
+    for (j=0; j<9; j++)
     {
-        if (x&1)
-        {
-            r = (*(pixel-width)+*(pixel+width))>>1;
-            g = *pixel;
-            b = (*(pixel-1)+*(pixel+1))>>1;
-        }
-        else
-        {
-            r = (*(pixel-width-1)+*(pixel-width+1)+*(pixel+width-1)+*(pixel+width+1))>>2;
-            g = (*(pixel-1)+*(pixel+1)+*(pixel+width)+*(pixel-width))>>2;
-            b = *pixel;
-        }
+        in = _mm_loadu_si128((const __m128i *)src[j]);
+        lo[j] = _mm_unpacklo_epi8(in, zero);
+        hi[j] = _mm_unpackhi_epi8(in, zero);
     }
+    bayer8(lo, oddRow, &r[0], &g[0], &b[0]);
+    bayer8(hi, oddRow, &r[1], &g[1], &b[1]);
+
+    // pack to bytes and interleave into B, G, R, A
+    __m128i r8 = _mm_packus_epi16(r[0], r[1]);
+    __m128i g8 = _mm_packus_epi16(g[0], g[1]);
+    __m128i b8 = _mm_packus_epi16(b[0], b[1]);
+    __m128i bg = _mm_unpacklo_epi8(b8, g8), ra = _mm_unpacklo_epi8(r8, alpha);
+    _mm_storeu_si128((__m128i *)line, _mm_unpacklo_epi16(bg, ra));
+    _mm_storeu_si128((__m128i *)(line+4), _mm_unpackhi_epi16(bg, ra));
+    bg = _mm_unpackhi_epi8(b8, g8);
+    ra = _mm_unpackhi_epi8(r8, alpha);
+    _mm_storeu_si128((__m128i *)(line+8), _mm_unpacklo_epi16(bg, ra));
+    _mm_storeu_si128((__m128i *)(line+12), _mm_unpackhi_epi16(bg, ra));
+}
 #endif
-#if 0 // green only
-    if (y&1)
-    {
-        if (x&1)
-        {
-            r = (*(pixel-1)+*(pixel+1))>>1;
-            g = (*(pixel-1)+*(pixel+1))>>1;
-            b = (*(pixel-1)+*(pixel+1))>>1;
-        }
-        else
-        {
-            r = *pixel;
-            g = *pixel;
-            b = *pixel;
-        }
-    }
-    else
+
+// Interpolate pixels xa..xb-1 of row y, which can't be on the edge of the frame.  The rows and 
+// columns alternate between 2 kinds of pixels, so the pixels are done in pairs, without 
+// branches.
+static void bayerRow(const uint8_t *frame, unsigned int width, unsigned int y, unsigned int xa, unsigned int xb, uint32_t *line)
+{
+    const uint8_t *p = frame + y*width, *u = p - width, *d = p + width;
+    unsigned int x = xa;
+
+    if (y&1) // red on odd columns, green on even columns
     {
-        if (x&1)
-        {
-            r = *pixel;
-            g = *pixel;
-            b = *pixel;
-        }
-        else
+        if ((x&1)==0 && x<xb)
         {
-            r = (*(pixel-1)+*(pixel+1))>>1;
-            g = (*(pixel-1)+*(pixel+1))>>1;
-            b = (*(pixel-1)+*(pixel+1))>>1;
+            line[x] = BAYER_PACK((p[x-1]+p[x+1])>>1, p[x], (u[x]+d[x])>>1);
+            x++;
         }
-    }
+#ifdef __SSE2__
+        for (; x+16<=xb; x+=16)
+            bayer16(p+x, u+x, d+x, true, line+x);
 #endif
-#if 0
-    if (y&1)
-    {
-        if (x&1)
-        {
-            r = *pixel;
-            g = (*(pixel-1)+*(pixel+1))>>1;
-            b = (*(pixel-width-1)+*(pixel-width+1))>>1;
-        }
-        else
+        for (; x+1<xb; x+=2)
         {
-            r = (*(pixel-1)+*(pixel+1))>>1;
-            g = *pixel;
-            b = *(pixel-width);
+            line[x] = BAYER_PACK(p[x], (p[x-1]+p[x+1]+u[x]+d[x])>>2, (u[x-1]+u[x+1]+d[x-1]+d[x+1])>>2);
+            line[x+1] = BAYER_PACK((p[x]+p[x+2])>>1, p[x+1], (u[x+1]+d[x+1])>>1);
         }
+        if (x<xb)
+            line[x] = BAYER_PACK(p[x], (p[x-1]+p[x+1]+u[x]+d[x])>>2, (u[x-1]+u[x+1]+d[x-1]+d[x+1])>>2);
     }
-    else
+    else // green on odd columns, blue on even columns
     {
-        if (x&1)
+        if ((x&1)==0 && x<xb)
         {
-            r = *(pixel+width);
-            g = *pixel;
-            b = (*(pixel-1)+*(pixel+1))>>1;
+            line[x] = BAYER_PACK((u[x-1]+u[x+1]+d[x-1]+d[x+1])>>2, (p[x-1]+p[x+1]+u[x]+d[x])>>2, p[x]);
+            x++;
         }
-        else
-        {
-            r = (*(pixel+width-1)+*(pixel+width+1))>>1;
-            g = (*(pixel-1)+*(pixel+1))>>1;
-            b = *pixel;
-        }
-    }
+#ifdef __SSE2__
+        for (; x+16<=xb; x+=16)
+            bayer16(p+x, u+x, d+x, false, line+x);
 #endif
-#if 0
-    if (y&1)
-    {
-        if (x&1)
-        {
-            r = *pixel;
-            g = (*(pixel-1)+*(pixel+1))>>1;
-            b = (*(pixel-width-1)+*(pixel-width+1))>>1;
-        }
-        else
+        for (; x+1<xb; x+=2)
         {
-            r = (*(pixel-1)+*(pixel+1))>>1;
-            g = *pixel;
-            b = *(pixel-width);
+            line[x] = BAYER_PACK((u[x]+d[x])>>1, p[x], (p[x-1]+p[x+1])>>1);
+            line[x+1] = BAYER_PACK((u[x]+u[x+2]+d[x]+d[x+2])>>2, (p[x]+p[x+2]+u[x+1]+d[x+1])>>2, p[x+1]);
         }
+        if (x<xb)
+            line[x] = BAYER_PACK((u[x]+d[x])>>1, p[x], (p[x-1]+p[x+1])>>1);
     }
-    else
+}
+
+// Interpolate rows ya..yb-1, pixels xa..xb-1 of each, none of them on the edge of the frame.
+static void bayerRows(const uint8_t *frame, unsigned int width, uchar *bits, int bpl, unsigned int xa, unsigned int xb,
+                      unsigned int ya, unsigned int yb, bool highlightOverexp)
+{
+    unsigned int x, y;
+    uint32_t *line, pixel;
+
+    for (y=ya; y<yb; y++)
     {
-        if (x&1)
-        {
-            r = *(pixel-width);
-            g = *pixel;
-            b = (*(pixel-1)+*(pixel+1))>>1;
-        }
-        else
+        line = (uint32_t *)(bits + y*bpl);
+        bayerRow(frame, width, y, xa, xb, line);
+        if (highlightOverexp)
         {
-            r = (*(pixel-width-1)+*(pixel-width+1))>>1;
-            g = (*(pixel-1)+*(pixel+1))>>1;
-            b = *pixel;
+            for (x=xa; x<xb; x++)
+            {
+                pixel = line[x];
+                if (((pixel>>16)&0xff)>0xf4 || ((pixel>>8)&0xff)>0xf4 || (pixel&0xff)>0xf4)
+                    line[x] = 0xff000000;
+            }
         }
     }
-#endif
-#if 0
-    if (y&1)
+}
+
+// A band of rows, rendered on the thread pool
+class BayerBand : public QRunnable
+{
+public:
+    BayerBand(QSemaphore *done, const uint8_t *frame, unsigned int width, uchar *bits, int bpl, unsigned int xa, unsigned int xb,
+              unsigned int ya, unsigned int yb, bool highlightOverexp) :
+        m_done(done), m_frame(frame), m_width(width), m_bits(bits), m_bpl(bpl), m_xa(xa), m_xb(xb),
+        m_ya(ya), m_yb(yb), m_highlightOverexp(highlightOverexp)
     {
-        if (x&1)
-        {
-            r = *pixel;
-            g = *(pixel-1);
-            b = *(pixel-width-1);
-        }
-        else
-        {
-            r = *(pixel-1);
-            g = *pixel;
-            b = *(pixel-width);
-        }
     }
-    else
+
+    virtual void run()
     {
-        if (x&1)
-        {
-            r = *(pixel-width);
-            g = *pixel;
-            b = *(pixel-1);
-        }
-        else
-        {
-            r = *(pixel-width-1);
-            g = *(pixel-1);
-            b = *pixel;
-        }
+        bayerRows(m_frame, m_width, m_bits, m_bpl, m_xa, m_xb, m_ya, m_yb, m_highlightOverexp);
+        m_done->release();
     }
-#endif
-}
-
 
+private:
+    QSemaphore *m_done;
+    const uint8_t *m_frame;
+    unsigned int m_width;
+    uchar *m_bits;
+    int m_bpl;
+    unsigned int m_xa, m_xb, m_ya, m_yb;
+    bool m_highlightOverexp;
+};
 
 int Renderer::renderBA81(uint8_t renderFlags, uint16_t width, uint16_t height, uint32_t frameLen, uint8_t *frame)
 {
-    uint16_t x, xx, y, yy;
-    uint32_t *line;
-    uint32_t r, g, b;
-    uint8_t *frame0;
-
     if (width*height>RAWFRAME_SIZE)
     {
         m_rawFrame.m_width = 0;
@@ -278,58 +252,233 @@ int Renderer::renderBA81(uint8_t renderFlags, uint16_t width, uint16_t height, u
         m_rawFrame.m_width = width;
         m_rawFrame.m_height = height;
     }
+    m_tileImage = NULL; // bands of changed tiles start over from this frame
+
+    QImage *img = nextImage(width, height);
+    bayerRect(img, frame, 0, 0, width, height);
+    m_background = *img;
+
+    // send image to ourselves across threads
+    // from chirp thread to gui thread
+    emitBackground(m_background, renderFlags);
+
+    return 0;
+}
+
+// BA8W is a window of a frame, e.g. the region around a tracked object.  It's drawn in place on 
+// a black frame, so whatever is rendered on top of it in frame coordinates lines up.
+int Renderer::renderBA8W(uint8_t renderFlags, uint16_t frameWidth, uint16_t frameHeight, uint16_t xOffset, uint16_t yOffset,
+                         uint16_t width, uint16_t height, uint32_t frameLen, uint8_t *frame)
+{
+    QPainter p;
+    QImage img(frameWidth, frameHeight, QImage::Format_RGB32);
+
+    if (width<3 || height<3 || frameLen<(uint32_t)width*height)
+        return -1;
+
+    // the raw frame is just the window, so there's nothing to take pixels or signatures from
+    m_rawFrame.m_width = 0;
+    m_rawFrame.m_height = 0;
+    m_tileImage = NULL;
+
+    img.fill(0xff000000);
+    if (!p.begin(&img))
+        return -1;
+    p.drawImage(xOffset, yOffset, bayerImage(width, height, frame));
+    p.end();
+
+    emitBackground(img, renderFlags);
+
+    m_background = img;
+
+    return 0;
+}
+
+// TL81 is a band (row of 16x16 tiles) of a frame, only the tiles that have changed since they
+// were last sent.  The tiles are packed in order, followed by a map with a bit for each tile of
+// the band.  The tiles are patched into the last raw frame and interpolated into a copy of the
+// last frame, which is shown when the band with RENDER_FLAG_FLUSH (the last one) comes in.  If
+// there isn't a raw frame (of the same size), the band is dropped -- the camera sends a whole
+// frame (BA81) every so often.
+int Renderer::renderTL81(uint8_t renderFlags, uint16_t width, uint16_t height, uint16_t row, uint32_t frameLen, uint8_t *frame)
+{
+    uint16_t cols = (width+TILE_SIZE-1)/TILE_SIZE;
+    uint16_t col, x0, y0 = row*TILE_SIZE, tileWidth, tileHeight, y;
+    uint32_t index, mapLen = (cols+7)/8;
+    uint8_t *map;
+
+    if (m_rawFrame.m_width!=width || m_rawFrame.m_height!=height || m_background.width()!=width ||
+            m_background.height()!=height || m_background.format()!=QImage::Format_RGB32 || y0>=height || frameLen<mapLen)
+        return -1;
+
+    if (m_tileImage==NULL) // first band of the frame
+    {
+        m_tileImage = nextImage(width, height);
+        memcpy(m_tileImage->bits(), m_background.constBits(), m_tileImage->bytesPerLine()*height);
+    }
+
+    map = frame + frameLen - mapLen;
+    tileHeight = qMin(TILE_SIZE, height-y0);
+    for (col=0, index=0; col<cols; col++)
+    {
+        if ((map[col>>3]&(1<<(col&7)))==0)
+            continue;
+        x0 = col*TILE_SIZE;
+        tileWidth = qMin(TILE_SIZE, width-x0);
+        if (index+tileWidth*tileHeight>frameLen-mapLen)
+            return -1;
+        for (y=0; y<tileHeight; y++, index+=tileWidth)
+            memcpy(m_rawFrame.m_pixels + (y0+y)*width + x0, frame+index, tileWidth);
+        // The pixels around the tile are interpolated from its edges too.  The ones in tiles that
+        // haven't been patched yet are done again when they are.
+        bayerRect(m_tileImage, m_rawFrame.m_pixels, qMax(x0-1, 0), qMax(y0-1, 0),
+                  qMin(x0+TILE_SIZE+1, (int)width), qMin(y0+TILE_SIZE+1, (int)height));
+    }
+
+    if (renderFlags&RENDER_FLAG_FLUSH)
+    {
+        m_background = *m_tileImage;
+        m_tileImage = NULL;
+        emitBackground(m_background, renderFlags);
+    }
 
-    // don't render top and bottom rows, and left and rightmost columns because of color
-    // interpolation
+    return 0;
+}
+
+QImage Renderer::bayerImage(uint16_t width, uint16_t height, uint8_t *frame)
+{
     QImage img(width, height, QImage::Format_RGB32);
 
+    bayerRect(&img, frame, 0, 0, width, height);
+
+    return img;
+}
+
+// Interpolate the pixels from x0, y0 up to (not including) x1, y1 of a raw frame the size of img,
+// into img.  Big rectangles are split into bands of rows, which are rendered in parallel.
+void Renderer::bayerRect(QImage *img, uint8_t *frame, uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1)
+{
+    uint16_t width = img->width(), height = img->height();
+    uint16_t xa = qMax((int)x0, 1), xb = qMin((int)x1, width-1);
+    uint16_t ya = qMax((int)y0, 1), yb = qMin((int)y1, height-1);
+    uint16_t y, i, bands;
+    uint32_t *line;
+    uchar *bits;
+    int bpl;
+
+    if (width<3 || height<3 || x0>=x1 || y0>=y1)
+        return;
+
+    // get the bits here, because it detaches the image, which the render threads shouldn't do
+    bits = img->bits();
+    bpl = img->bytesPerLine();
+
+    bands = qMin((int)(yb-ya)/RENDER_MIN_BAND_ROWS, m_threadPool.maxThreadCount()+1);
+    if (bands<=1)
+        bayerRows(frame, width, bits, bpl, xa, xb, ya, yb, m_highlightOverexp);
+    else
+    {
+        for (i=1; i<bands; i++)
+            m_threadPool.start(new BayerBand(&m_bandsDone, frame, width, bits, bpl, xa, xb,
+                                             ya + (yb-ya)*i/bands, ya + (yb-ya)*(i+1)/bands, m_highlightOverexp));
+        bayerRows(frame, width, bits, bpl, xa, xb, ya, ya + (yb-ya)/bands, m_highlightOverexp);
+        m_bandsDone.acquire(bands-1);
+    }
+
+    // The top and bottom rows, and the left and rightmost columns can't be interpolated, so
+    // they're copies of their neighbors.
+    for (y=ya; y<yb; y++)
+    {
+        line = (uint32_t *)(bits + y*bpl);
+        if (x0==0)
+            line[0] = line[1];
+        if (x1==width)
+            line[width-1] = line[width-2];
+    }
+    if (y0==0)
+        memcpy(bits + x0*4, bits + bpl + x0*4, (x1-x0)*4);
+    if (y1==height)
+        memcpy(bits + (height-1)*bpl + x0*4, bits + (height-2)*bpl + x0*4, (x1-x0)*4);
+
 #ifdef DEBUG_NOISE
     int32_t noise=0, prev=0, bw;
     static float avg = 1.0;
     static uint32_t n = 1;
-#endif
+    uint16_t x;
 
-    for (y=0; y<height; y++)
+    for (y=y0; y<y1; y++)
     {
-        yy = y;
-        if (yy==0)
-            yy++;
-        else if (yy==height-1)
-            yy--;
-        frame0 = frame + yy*width;
-        line = (unsigned int *)img.scanLine(y);
-        for (x=0; x<width; x++)
+        line = (uint32_t *)(bits + y*bpl);
+        for (x=x0; x<x1; x++)
         {
-            xx = x;
-            if (xx==0)
-                xx++;
-            else if (xx==width-1)
-                xx--;
-            interpolateBayer(width, xx, yy, frame0+xx, r, g, b);
-            if (m_highlightOverexp && (r>0xf4 || g>0xf4 || b>0xf4))
-                *line++ = (0xff<<24); // | 0xff0000;
-            else
-                *line++ = (0xff<<24) | (r<<16) | (g<<8) | (b<<0);
-
-#ifdef DEBUG_NOISE
-            bw = (r+g+b)/3;
+            bw = (((line[x]>>16)&0xff)+((line[x]>>8)&0xff)+(line[x]&0xff))/3;
             noise += abs(bw - prev);
             prev = bw;
-#endif
         }
     }
-#ifdef DEBUG_NOISE
     avg = (float)avg*(n-1)/n + (float)noise/n; // n0/1 n0+n1/2 n0+n1+n3/3
     n++;
     qDebug("%d %f", n, avg/1000.0);
 #endif
-    // send image to ourselves across threads
-    // from chirp thread to gui thread
-    emit image(img, renderFlags, "Background");
+}
 
-    m_background = img;
+// Images are recycled from a small pool instead of being allocated for every frame.  If one is
+// still being used, e.g. the GUI is still drawing it, writing to it detaches it (makes a copy),
+// so it never changes under anyone.
+QImage *Renderer::nextImage(uint16_t width, uint16_t height)
+{
+    QImage *img = &m_images[m_imageIndex];
 
-    return 0;
+    m_imageIndex = (m_imageIndex+1)%RENDER_POOL_IMAGES;
+    if (img->width()!=width || img->height()!=height)
+        *img = QImage(width, height, QImage::Format_RGB32);
+
+    return img;
+}
+
+// A background that's rendered by itself (flushed) is handed to the GUI thread through a double
+// buffer.  If the GUI hasn't taken the last one yet, it's replaced, so the GUI always gets the
+// newest frame, and frames don't queue up when it falls behind.  A background with more layers
+// to come goes through image() with them, in order.
+void Renderer::emitBackground(const QImage &img, uchar renderFlags)
+{
+    bool ready;
+
+    if ((renderFlags&RENDER_FLAG_FLUSH)==0)
+    {
+        emit image(img, renderFlags, "Background");
+        return;
+    }
+
+    m_pendingMutex.lock();
+    ready = !m_pendingValid;
+    m_pending = img;
+    m_pendingFlags = renderFlags;
+    m_pendingValid = true;
+    m_pendingMutex.unlock();
+
+    if (ready)
+        emit backgroundReady();
+}
+
+void Renderer::handleBackground()
+{
+    QImage img;
+    uchar renderFlags;
+
+    m_pendingMutex.lock();
+    if (!m_pendingValid)
+    {
+        m_pendingMutex.unlock();
+        return;
+    }
+    img = m_pending;
+    renderFlags = m_pendingFlags;
+    m_pending = QImage(); // don't hold on to it, so it can be recycled
+    m_pendingValid = false;
+    m_pendingMutex.unlock();
+
+    m_video->handleImage(img, renderFlags, "Background");
 }
 
 void Renderer::renderRects(const Points &points, uint32_t size)
@@ -498,6 +647,17 @@ bool Renderer::render(uint32_t fourcc, const void *args[])
         renderBA81(*(uint8_t *)args[0], *(uint16_t *)args[1], *(uint16_t *)args[2], *(uint32_t *)args[3], (uint8_t *)args[4]);
         return true;
     }
+    else if (fourcc==FOURCC('B','A','8','W'))
+    {
+        renderBA8W(*(uint8_t *)args[0], *(uint16_t *)args[1], *(uint16_t *)args[2], *(uint16_t *)args[3], *(uint16_t *)args[4],
+                *(uint16_t *)args[5], *(uint16_t *)args[6], *(uint32_t *)args[7], (uint8_t *)args[8]);
+        return true;
+    }
+    else if (fourcc==FOURCC('T','L','8','1'))
+    {
+        renderTL81(*(uint8_t *)args[0], *(uint16_t *)args[1], *(uint16_t *)args[2], *(uint16_t *)args[3], *(uint32_t *)args[4], (uint8_t *)args[5]);
+        return true;
+    }
     else if (fourcc==FOURCC('C','C','Q','1'))
     {
         renderCCQ1(*(uint8_t *)args[0], *(uint16_t *)args[1], *(uint16_t *)args[2], *(uint32_t *)args[3], (uint32_t *)args[4]);
@@ -19,6 +19,8 @@
 #include <QObject>
 #include <QImage>
 #include <QMutex>
+#include <QThreadPool>
+#include <QSemaphore>
 #include <QColor>
 #include "pixytypes.h"
 #include "monmodule.h"
@@ -30,6 +32,9 @@ typedef SimpleVector<Point16> Points;
 #define RAWFRAME_SIZE    0x12000
 #define PALETTE_SIZE     7
 #define TEXT_HEIGHT      12
+#define TILE_SIZE        16
+#define RENDER_POOL_IMAGES    3
+#define RENDER_MIN_BAND_ROWS  32
 class Interpreter;
 
 class VideoWidget;
@@ -52,6 +57,9 @@ public:
 
     int renderCCQ1(uint8_t renderFlags, uint16_t width, uint16_t height, uint32_t numVals, uint32_t *qVals);
     int renderBA81(uint8_t renderFlags, uint16_t width, uint16_t height, uint32_t frameLen, uint8_t *frame);
+    int renderTL81(uint8_t renderFlags, uint16_t width, uint16_t height, uint16_t row, uint32_t frameLen, uint8_t *frame);
+    int renderBA8W(uint8_t renderFlags, uint16_t frameWidth, uint16_t frameHeight, uint16_t xOffset, uint16_t yOffset,
+                   uint16_t width, uint16_t height, uint32_t frameLen, uint8_t *frame);
     int renderBLT1(uint8_t renderFlags, uint16_t width, uint16_t height,
                    uint16_t blockWidth, uint16_t blockHeight, uint32_t numPoints, uint16_t *points);
     int renderJPEG(uint16_t width, uint16_t height, uint32_t len, uint8_t *jpeg);
@@ -78,9 +86,16 @@ public:
 signals:
     void image(QImage image, uchar renderFlags, QString desc="");
     void flush();
+    void backgroundReady();
+
+private slots:
+    void handleBackground();
 
 private:
-    inline void interpolateBayer(unsigned int width, unsigned int x, unsigned int y, unsigned char *pixel, unsigned int &r, unsigned int &g, unsigned int &b);
+    QImage *nextImage(uint16_t width, uint16_t height);
+    void emitBackground(const QImage &img, uchar renderFlags);
+    QImage bayerImage(uint16_t width, uint16_t height, uint8_t *frame);
+    void bayerRect(QImage *img, uint8_t *frame, uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1);
 
     Interpreter *m_interpreter;
     QImage m_background;
@@ -89,6 +104,18 @@ private:
     static const unsigned int m_defaultPalette[PALETTE_SIZE];
 
     bool m_highlightOverexp;
+
+    QThreadPool m_threadPool;
+    QSemaphore m_bandsDone;
+    QImage m_images[RENDER_POOL_IMAGES];
+    uint m_imageIndex;
+    QImage *m_tileImage; // frame the TL81 bands are going into, NULL between frames
+
+    // double buffer between the render thread and the GUI thread, see emitBackground()
+    QMutex m_pendingMutex;
+    QImage m_pending;
+    uchar m_pendingFlags;
+    bool m_pendingValid;
 };
 
 #endif // RENDERER_H
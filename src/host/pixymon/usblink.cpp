@@ -13,6 +13,7 @@
 // end license header
 //
 
+#include <string.h>
 #include "debug.h"
 #include "usblink.h"
 #include "sleeper.h"
@@ -24,11 +25,17 @@ USBLink::USBLink()
     m_context = 0;
     m_blockSize = 64;
     m_flags = LINK_FLAG_ERROR_CORRECTED;
+    m_transfer = libusb_alloc_transfer(0);
+    m_pending = false;
+    m_wake = false;
+    m_readyLen = 0;
+    m_readyIndex = 0;
 }
 
 USBLink::~USBLink()
 {
     close();
+    libusb_free_transfer(m_transfer);
 }
 
 int USBLink::open()
@@ -125,6 +132,17 @@ int USBLink::receive(uint8_t *data, uint32_t len, uint16_t timeoutMs)
 {
     int res, transferred;
 
+    // hand over what waitReady() received first
+    if (m_readyIndex<m_readyLen)
+    {
+        transferred = m_readyLen-m_readyIndex;
+        if ((uint32_t)transferred>len)
+            transferred = len;
+        memcpy(data, m_readyBuf+m_readyIndex, transferred);
+        m_readyIndex += transferred;
+        return transferred;
+    }
+
     if (timeoutMs==0) // 0 equals infinity
         timeoutMs = 100;
 
@@ -141,6 +159,78 @@ int USBLink::receive(uint8_t *data, uint32_t len, uint16_t timeoutMs)
     return transferred;
 }
 
+void LIBUSB_CALL USBLink::readyCallback(libusb_transfer *transfer)
+{
+    *(int *)transfer->user_data = 1;
+}
+
+int USBLink::waitReady(uint16_t timeoutMs)
+{
+    int res, completed = 0;
+
+    if (m_readyIndex<m_readyLen)
+        return m_readyLen-m_readyIndex;
+    if (timeoutMs==0) // 0 would be infinity to libusb
+        timeoutMs = 1;
+
+    m_mutex.lock();
+    if (m_wake)
+    {
+        m_wake = false;
+        m_mutex.unlock();
+        return 0;
+    }
+    libusb_fill_bulk_transfer(m_transfer, m_handle, 0x82, m_readyBuf, USB_READY_LEN, readyCallback, &completed, timeoutMs);
+    res = libusb_submit_transfer(m_transfer);
+    m_pending = res==0;
+    m_mutex.unlock();
+    if (res<0)
+        return res;
+
+    // readyCallback() is called from in here when the transfer completes, times out or is cancelled by wake()
+    while (!completed)
+    {
+        if (libusb_handle_events_completed(m_context, &completed)<0)
+            libusb_cancel_transfer(m_transfer);
+    }
+
+    // a wake() since we started has been dealt with, the caller checks for what woke us next
+    m_mutex.lock();
+    m_pending = false;
+    m_wake = false;
+    m_mutex.unlock();
+
+    // keep anything that arrived, even if the transfer was cancelled part way
+    m_readyLen = m_transfer->actual_length;
+    m_readyIndex = 0;
+    if (m_readyLen>0)
+        return m_readyLen;
+
+    switch (m_transfer->status)
+    {
+    case LIBUSB_TRANSFER_NO_DEVICE:
+        return LIBUSB_ERROR_NO_DEVICE;
+    case LIBUSB_TRANSFER_ERROR:
+    case LIBUSB_TRANSFER_STALL:
+    case LIBUSB_TRANSFER_OVERFLOW:
+#ifdef __MACOS__
+        libusb_clear_halt(m_handle, 0x82);
+#endif
+        return LIBUSB_ERROR_IO;
+    default: // timed out or woken
+        return 0;
+    }
+}
+
+void USBLink::wake()
+{
+    m_mutex.lock();
+    m_wake = true;
+    if (m_pending)
+        libusb_cancel_transfer(m_transfer);
+    m_mutex.unlock();
+}
+
 void USBLink::setTimer()
 {
     m_time.start();
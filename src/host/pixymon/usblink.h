@@ -18,8 +18,12 @@
 
 #include <link.h>
 #include <QTime>
+#include <QMutex>
 #include "libusb.h"
 
+// one packet, which is what Chirp asks for when it starts receiving a message (CRP_MAX_HEADER_LEN)
+#define USB_READY_LEN   64
+
 class USBLink : public Link
 {
 public:
@@ -33,11 +37,27 @@ public:
     virtual void setTimer();
     virtual uint32_t getTimer();
 
+    // Wait up to timeoutMs for Pixy to send something, or until wake() is called from another
+    // thread.  Whatever arrives is handed to the next receive().  Returns the number of bytes
+    // received, 0 if woken or timed out, or a libusb error, e.g. if Pixy has been unplugged.
+    int waitReady(uint16_t timeoutMs);
+    void wake();
+
 private:
     int openDevice();
+    static void LIBUSB_CALL readyCallback(libusb_transfer *transfer);
+
     libusb_context *m_context;
     libusb_device_handle *m_handle;
     QTime m_time;
+
+    libusb_transfer *m_transfer;
+    QMutex m_mutex;
+    bool m_pending;
+    bool m_wake;
+    uint8_t m_readyBuf[USB_READY_LEN];
+    uint32_t m_readyLen;
+    uint32_t m_readyIndex;
 };
 #endif
 
@@ -43,6 +43,7 @@ VideoWidget::VideoWidget(MainWindow *main) : QWidget((QWidget *)main)
     m_aspectRatio = VW_ASPECT_RATIO;
     m_dialogTabs = NULL;
     m_resizeState = 0;
+    m_cacheValid = false;
 
     // set size policy--- preferred aspect ratio
     QSizePolicy policy = sizePolicy();
@@ -59,9 +60,19 @@ VideoWidget::~VideoWidget()
 
 void VideoWidget::flush()
 {
+    uint i;
+
+    // keep the pixmaps of the layers that haven't changed (same image data), e.g. an overlay
+    // that's only rendered now and then
+    for (i=0; i<m_layers.size() && i<m_renderedLayers.size(); i++)
+    {
+        if (m_layers[i].m_img.cacheKey()==m_renderedLayers[i].m_img.cacheKey())
+            m_layers[i].m_pixmap = m_renderedLayers[i].m_pixmap;
+    }
     m_renderedLayers.clear();
     m_renderedLayers = m_layers;
     m_layers.clear();
+    m_cacheValid = false;
     updateDialog();
     repaint();
 }
@@ -108,6 +119,7 @@ void VideoWidget::clear()
     m_layers.clear();
     m_renderedLayers.clear();
     m_layerEnable.clear();
+    m_cacheValid = false;
     QImage img(m_width, m_height, QImage::Format_RGB32);
     img.fill(0xff000000);
 
@@ -126,24 +138,21 @@ int  VideoWidget::activeHeight()
 
 void VideoWidget::paintEvent(QPaintEvent *event)
 {
-    unsigned int i;
     m_width = this->width();
     m_height = this->height();
     float war;
     float pmar;
-    QPainter p(this); // we could render to a QImage instead of to a widget.  This might take longer, but
-    // it would allow us to save off the blended image, e.g. to a file.
-    QPixmap bgPixmap;
+    QPainter p(this);
+    QImage *bg;
 
     if (m_renderedLayers.size()==0)
         return;
 
-    // background pixmap
-    bgPixmap = QPixmap::fromImage(m_renderedLayers[0].m_img);
+    bg = &m_renderedLayers[0].m_img;
 
     // calc aspect ratios
     war = (float)m_width/(float)m_height; // widget aspect ratio
-    pmar = (float)bgPixmap.width()/(float)bgPixmap.height();
+    pmar = (float)bg->width()/(float)bg->height();
 
     if (pmar!=m_aspectRatio)
     {
@@ -151,9 +160,6 @@ void VideoWidget::paintEvent(QPaintEvent *event)
         updateGeometry();
     }
 
-    // set blending mode
-    p.setCompositionMode(QPainter::CompositionMode_SourceOver);
-
     // figure out if we need to offset our rendering rectangle
     if (war>pmar)
     {   // width is greater than video
@@ -169,26 +175,16 @@ void VideoWidget::paintEvent(QPaintEvent *event)
     }
 
     // figure out scale between background resolution and active width of widget
-    m_scale = (float)m_width/bgPixmap.width();
+    m_scale = (float)m_width/bg->width();
 
     if (m_layerEnable.size()!=m_renderedLayers.size())
         setupDialog(NULL);
 
-    // draw black background
-    QPixmap bgBlk(bgPixmap.width(), bgPixmap.height());
-    bgBlk.fill(0xff000000);
-    p.drawPixmap(QRect(m_xOffset, m_yOffset, m_width, m_height), bgBlk);
-
-    // draw background
-    if (m_layerEnable[0])
-        p.drawPixmap(QRect(m_xOffset, m_yOffset, m_width, m_height), bgPixmap);
-
-    // draw/blend foreground images
-    for (i=1; i<m_renderedLayers.size(); i++)
-    {
-        if (m_layerEnable[i])
-            p.drawPixmap(QRect(m_xOffset, m_yOffset, m_width, m_height), QPixmap::fromImage(m_renderedLayers[i].m_img));
-    }
+    // Redraw the layers only if they've changed, or if the widget's size has.  Otherwise (e.g.
+    // dragging a selection), just copy the cache.
+    if (!m_cacheValid)
+        renderCache();
+    p.drawPixmap(m_xOffset, m_yOffset, m_cache);
 
     // draw selection rectangle
     if (m_selection)
@@ -201,6 +197,39 @@ void VideoWidget::paintEvent(QPaintEvent *event)
     QWidget::paintEvent(event);
 }
 
+// Composite the enabled layers, scaled to the active video area, into the cache.  Each layer is
+// converted to a pixmap once, the first time it's drawn.
+void VideoWidget::renderCache()
+{
+    unsigned int i;
+    int dpr = devicePixelRatio(); // draw at the screen's resolution
+    QPainter p;
+
+    if (m_cache.width()!=m_width*dpr || m_cache.height()!=m_height*dpr)
+    {
+        m_cache = QPixmap(m_width*dpr, m_height*dpr);
+        m_cache.setDevicePixelRatio(dpr);
+    }
+    m_cache.fill(Qt::black);
+    m_cacheValid = true;
+
+    if (!p.begin(&m_cache))
+        return;
+    // set blending mode
+    p.setCompositionMode(QPainter::CompositionMode_SourceOver);
+
+    // background, then blend foreground images
+    for (i=0; i<m_renderedLayers.size(); i++)
+    {
+        if (!m_layerEnable[i])
+            continue;
+        if (m_renderedLayers[i].m_pixmap.isNull())
+            m_renderedLayers[i].m_pixmap = QPixmap::fromImage(m_renderedLayers[i].m_img);
+        p.drawPixmap(QRect(0, 0, m_width, m_height), m_renderedLayers[i].m_pixmap);
+    }
+    p.end();
+}
+
 int VideoWidget::heightForWidth(int w) const
 {
     return w/m_aspectRatio;
@@ -308,6 +337,7 @@ void VideoWidget::mouseReleaseEvent(QMouseEvent *event)
 void VideoWidget::resizeEvent(QResizeEvent *event)
 {
     m_selection = false;
+    m_cacheValid = false;
     QWidget::resizeEvent(event);
 }
 
@@ -374,6 +404,7 @@ void VideoWidget::updateDialog()
 
     m_dialogWidgets = m_renderedLayers.size();
 	m_layerEnable.clear();
+    m_cacheValid = false;
     for (i=0; i<m_dialogWidgets; i++)
     {
         label = new QLabel(QString("Layer ") + QString::number(i));
@@ -409,6 +440,7 @@ void VideoWidget::setupDialog(QTabWidget *tabs)
         // layer flags are not permanent, for now they are only applicable when config dialog is up
         // when the dialog goes away, we restore defaults.
         m_layerEnable.clear();
+        m_cacheValid = false;
 
         for (i=0; i<m_renderedLayers.size(); i++)
             m_layerEnable.push_back(m_renderedLayers[i].m_enable);
@@ -427,6 +459,7 @@ void VideoWidget::handleCheckBox()
         if (i==index)
             m_layerEnable[i] = checked;
     }
+    m_cacheValid = false;
     repaint();
 }
 
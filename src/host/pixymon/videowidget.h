@@ -18,6 +18,7 @@
 
 #include <QWidget>
 #include <QImage>
+#include <QPixmap>
 #include <QTimer>
 
 #define VW_ASPECT_RATIO   ((float)316/(float)208)
@@ -37,6 +38,7 @@ struct Layer
     }
 
     QImage m_img;
+    QPixmap m_pixmap; // m_img converted, made when it's first drawn
     bool m_enable;
     QString m_desc;
 };
@@ -88,6 +90,7 @@ private slots:
 
 private:
     void updateDialog();
+    void renderCache();
 
     MainWindow *m_main;
 
@@ -113,6 +116,10 @@ private:
     float m_aspectRatio;
     QTimer m_timer;
 
+    // the enabled layers, scaled and composited, redrawn only when they change or the widget is resized
+    QPixmap m_cache;
+    bool m_cacheValid;
+
     QGridLayout *m_dialogLayout;
     QTabWidget *m_dialogTabs;
     uint m_dialogWidgets;